@@ -0,0 +1,459 @@
+/* End-to-End Benchmark
+
+   Runs the firmware in-process, as host_main.c does, and measures it from
+   a client's side of the stream server. For each frequency, every capture
+   channel is driven with a square wave at that frequency; once the stream
+   has settled it is read for a fixed time and one line is printed:
+
+   - edges/s raised by the generator and samples/s the client received
+   - samples lost on the way (gaps in the edge counts, counter format only)
+   - edge ring overruns, blocks dropped by the pool and blocks skipped for
+     the client
+   - latency percentiles: from when a sample's edge was due to when the
+     client had the whole frame carrying it
+
+   Edge counts are mapped back to edge times through the generator, so the
+   latency covers the generator running late, the drain wait, the block
+   filling, the hand-off to NetworkTask, encoding and the socket. Summary
+   blocks are counted but have no per-edge latency.
+
+   With -l the host shim loses packets (see host.h), so the TCP and UDP
+   streams can be compared under loss: TCP loses no samples but stalls for
+   a retransmission, so its latency tail grows until blocks are skipped;
+   UDP loses the samples of each lost datagram and nothing else.
+
+   Usage:
+
+     fg_bench [-a | -u] [-l percent] [-d seconds] [frequency ...]
+
+     -a   read the Ascii85 stream (channel 0 only) rather than binary
+     -u   read the UDP stream (see udp_stream.h) rather than TCP
+     -l   lose this percentage of TCP segments and UDP datagrams
+     -d   measuring time per frequency (default 2 s)
+
+   Frequencies default to 1 kHz to 500 kHz.
+*/
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "capture.h"
+#include "sample_pool.h"
+#include "wire_format.h"
+#include "delta_codec.h"
+#include "lz4_block.h"
+#include "edge_record.h"
+#include "edge_stats.h"
+#include "stats.h"
+#include "udp_stream.h"
+#include "host.h"
+
+#define SETTLE_US 500000
+#define CONNECT_TIMEOUT_US 5000000
+#define UDP_RENEW_US 1000000
+
+void app_main(void);
+
+typedef struct
+{
+    double *values;
+    size_t count;
+    size_t capacity;
+} latencies_t;
+
+// Results for one frequency.
+typedef struct
+{
+    uint64_t samples;
+    uint64_t lost;
+    uint64_t summaries;
+    latencies_t latency;
+} window_t;
+
+static const uint32_t defaultFrequencies[] = { 1000, 10000, 50000, 100000, 200000, 500000 };
+
+static int64_t nextCount[CAPTURE_CHANNELS];     // Next edge count expected, or -1.
+static bool measuring = false;
+static window_t window;
+static int64_t subscribed = 0;                  // UDP subscription last renewed.
+
+static void add_latency(latencies_t *latencies, double value)
+{
+    if (latencies->count == latencies->capacity)
+    {
+        latencies->capacity = latencies->capacity ? latencies->capacity * 2 : 65536;
+        latencies->values = realloc(latencies->values, latencies->capacity * sizeof(double));
+    }
+    latencies->values[latencies->count++] = value;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    
+    return (x > y) - (x < y);
+}
+
+static double percentile(const latencies_t *latencies, double fraction)
+{
+    size_t index = (size_t) (fraction * (latencies->count - 1) + 0.5);
+    
+    return latencies->count ? latencies->values[index] : 0;
+}
+
+// An edge count sample from 'channel', received at 'now'.
+static void count_sample(int channel, int32_t count, int64_t now)
+{
+    if (nextCount[channel] >= 0 && count > nextCount[channel] && measuring)
+    {
+        window.lost += count - nextCount[channel];
+    }
+    nextCount[channel] = (int64_t) count + 1;
+    if (!measuring)
+    {
+        return;
+    }
+    window.samples++;
+    double due = host_gpio_edge_time(capture_channels[channel].gpio, (uint32_t) count);
+    if (due >= 0)
+    {
+        add_latency(&window.latency, now - due);
+    }
+}
+
+// A timed edge, received at 'now'.
+static void edge_sample(const edge_time_t *edge, int64_t now)
+{
+    if (measuring)
+    {
+        window.samples++;
+        add_latency(&window.latency, now - (double) edge->cycles / CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
+    }
+}
+
+static int connect_local(int type, int port)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    int64_t deadline = esp_timer_get_time() + CONNECT_TIMEOUT_US;
+    
+    while (esp_timer_get_time() < deadline)
+    {
+        int sock = socket(AF_INET, type, 0);
+        if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) == 0)
+        {
+            return sock;
+        }
+        close(sock);
+        usleep(50000);
+    }
+    return -1;
+}
+
+// Reads exactly 'len' bytes, riding out receive timeouts. Returns 0 if the
+// connection closed.
+static int read_full(int sock, void *buf, size_t len)
+{
+    size_t got = 0;
+    
+    while (got < len)
+    {
+        ssize_t n = recv(sock, (char *) buf + got, len - got, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            return 0;
+        }
+        if (n > 0)
+        {
+            got += n;
+        }
+    }
+    return 1;
+}
+
+// A binary frame, from the TCP stream or a datagram, received at 'now'.
+static void binary_frame(const wire_header_t *header, const uint8_t *payload, int64_t now)
+{
+    static int32_t samples[SAMPLE_BLOCK_SIZE];
+    static edge_time_t edges[SAMPLE_BLOCK_SIZE];
+    static uint8_t decompressed[DELTA_VARINT_MAX_SIZE(SAMPLE_BLOCK_SIZE)];
+    size_t payloadSize = header->payload_size;
+    
+    if (header->flags & (WIRE_FLAG_STATS | WIRE_FLAG_TRACE) || header->channel >= CAPTURE_CHANNELS ||
+        header->count > SAMPLE_BLOCK_SIZE)
+    {
+        return;
+    }
+    if (header->flags & WIRE_FLAG_LZ4)
+    {
+        payloadSize = lz4_block_decompress(payload, payloadSize, decompressed, sizeof(decompressed));
+        payload = decompressed;
+    }
+    if (header->encoding == WIRE_ENCODING_DELTA_VARINT)
+    {
+        delta_varint_decode(payload, payloadSize, samples, header->count);
+    }
+    else
+    {
+        memcpy(samples, payload, header->count * sizeof(int32_t));
+    }
+    
+    if (header->flags & WIRE_FLAG_SUMMARY)
+    {
+        window.summaries += measuring ? header->count / EDGE_SUMMARY_WORDS : 0;
+    }
+    else if (header->flags & WIRE_FLAG_EDGE_TIME)
+    {
+        size_t count = edge_record_decode(samples, header->count, header->timestamp, edges);
+        for (size_t i = 0; i < count; i++)
+        {
+            edge_sample(&edges[i], now);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < header->count; i++)
+        {
+            count_sample(header->channel, samples[i], now);
+        }
+    }
+}
+
+static int read_binary_frame(int sock)
+{
+    static uint8_t payload[SAMPLE_BLOCK_SIZE * 5 + 64];
+    wire_header_t header;
+    
+    if (!read_full(sock, &header, sizeof(header)) || !wire_header_valid(&header) ||
+        header.payload_size > sizeof(payload) || !read_full(sock, payload, header.payload_size))
+    {
+        return 0;
+    }
+    binary_frame(&header, payload, esp_timer_get_time());
+    return 1;
+}
+
+// Reads one datagram, or times out, renewing the subscription when due.
+// Lost datagrams show up as gaps in the edge counts.
+static int read_datagram(int sock)
+{
+    static uint8_t datagram[UDP_STREAM_DATAGRAM_SIZE];
+    wire_header_t header;
+    
+    if (esp_timer_get_time() - subscribed >= UDP_RENEW_US)
+    {
+        send(sock, &(char) { WIRE_HANDSHAKE_BINARY }, 1, 0);
+        subscribed = esp_timer_get_time();
+    }
+    ssize_t n = recv(sock, datagram, sizeof(datagram), 0);
+    if (n < 0)
+    {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR || errno == ECONNREFUSED;
+    }
+    memcpy(&header, datagram, sizeof(header));
+    if (n >= (ssize_t) sizeof(header) && wire_header_valid(&header) &&
+        sizeof(header) + header.payload_size == (size_t) n &&
+        wire_crc32(0, datagram + sizeof(header), header.payload_size) == header.crc32)
+    {
+        binary_frame(&header, datagram + sizeof(header), esp_timer_get_time());
+    }
+    return 1;
+}
+
+static int read_ascii85(int sock)
+{
+    static unsigned char text[8192];
+    static size_t held = 0;
+    
+    ssize_t n = recv(sock, text + held, sizeof(text) - held, 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+    {
+        return 0;
+    }
+    held += n > 0 ? n : 0;
+    int64_t now = esp_timer_get_time();
+    size_t used = 0;
+    for (; used + 5 <= held; used += 5)
+    {
+        // Least significant digit first.
+        uint32_t value = 0;
+        for (int j = 4; j >= 0; j--)
+        {
+            value = value * 85 + (uint32_t) (text[used + j] - 33);
+        }
+        count_sample(0, (int32_t) value, now);
+    }
+    memmove(text, text + used, held - used);
+    held -= used;
+    return 1;
+}
+
+static uint64_t total_edges(void)
+{
+    uint64_t edges = 0;
+    
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        edges += host_gpio_edges(capture_channels[channel].gpio);
+    }
+    return edges;
+}
+
+static uint32_t total_overruns(void)
+{
+    uint32_t overruns = 0;
+    
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        overruns += capture_backend.overruns(channel);
+    }
+    return overruns;
+}
+
+static uint32_t total_skipped(void)
+{
+    uint32_t skipped = 0;
+    
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        skipped += __atomic_load_n(&stats_cores[core].counters[STATS_BLOCKS_SKIPPED], __ATOMIC_RELAXED);
+    }
+    return skipped;
+}
+
+static int run_frequency(int sock, int (*read_some)(int), uint32_t frequency, double seconds)
+{
+    
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        host_gpio_generate(capture_channels[channel].gpio, frequency);
+        nextCount[channel] = -1;
+    }
+    
+    // Let the pipeline fill and the last frequency's samples drain through.
+    int64_t end = esp_timer_get_time() + SETTLE_US;
+    measuring = false;
+    while (esp_timer_get_time() < end)
+    {
+        if (!read_some(sock))
+        {
+            return 0;
+        }
+    }
+    
+    window.samples = window.lost = window.summaries = 0;
+    window.latency.count = 0;
+    uint64_t edges = total_edges();
+    uint32_t overruns = total_overruns();
+    uint32_t dropped = sample_pool_dropped();
+    uint32_t skipped = total_skipped();
+    int64_t start = esp_timer_get_time();
+    end = start + (int64_t) (seconds * 1000000);
+    measuring = true;
+    while (esp_timer_get_time() < end)
+    {
+        if (!read_some(sock))
+        {
+            return 0;
+        }
+    }
+    double elapsed = (esp_timer_get_time() - start) / 1e6;
+    
+    latencies_t *latency = &window.latency;
+    qsort(latency->values, latency->count, sizeof(double), compare_doubles);
+    printf("%9u %10.0f %10.0f %8llu %8u %7u %7u %9.0f %9.0f %9.0f %9.0f",
+           frequency, (total_edges() - edges) / elapsed, window.samples / elapsed,
+           (unsigned long long) window.lost, total_overruns() - overruns,
+           sample_pool_dropped() - dropped, total_skipped() - skipped,
+           percentile(latency, 0.5), percentile(latency, 0.9), percentile(latency, 0.99),
+           percentile(latency, 1.0));
+    if (window.summaries > 0)
+    {
+        printf("  (%llu summaries)", (unsigned long long) window.summaries);
+    }
+    printf("\n");
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    bool ascii85 = false;
+    bool udp = false;
+    double loss = 0;
+    double seconds = 2;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "aul:d:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'a': ascii85 = true; break;
+            case 'u': udp = true; break;
+            case 'l': loss = atof(optarg); break;
+            case 'd': seconds = atof(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-a | -u] [-l percent] [-d seconds] [frequency ...]\n", argv[0]);
+                return 2;
+        }
+    }
+    
+    esp_log_level_set("*", ESP_LOG_ERROR);
+    signal(SIGPIPE, SIG_IGN);
+    wire_crc32(0, NULL, 0);
+    host_set_loss(loss);
+    app_main();
+    
+    int sock = udp ? connect_local(SOCK_DGRAM, CONFIG_STREAM_UDP_PORT)
+                   : connect_local(SOCK_STREAM, CONFIG_STREAM_PORT);
+    // Subscriptions are only taken from an address with a TCP session; this
+    // one is sent nothing.
+    int session = udp ? connect_local(SOCK_STREAM, CONFIG_STREAM_PORT) : -1;
+    if (sock < 0 || (udp && session < 0))
+    {
+        fprintf(stderr, "Unable to connect to the stream server\n");
+        return 1;
+    }
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 100000 };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (udp)
+    {
+        send(session, &(char) { WIRE_HANDSHAKE_UDP }, 1, 0);
+    }
+    else
+    {
+        char protocol = ascii85 ? WIRE_HANDSHAKE_ASCII85 : WIRE_HANDSHAKE_BINARY;
+        send(sock, &protocol, 1, 0);
+    }
+    int (*read_some)(int) = udp ? read_datagram : ascii85 ? read_ascii85 : read_binary_frame;
+    
+    printf("%d channels, %s client, %d samples/block, %.1f s per frequency, %.1f%% loss\n",
+           CAPTURE_CHANNELS, udp ? "UDP" : ascii85 ? "Ascii85" : "binary", SAMPLE_BLOCK_SIZE,
+           seconds, loss);
+    printf("%9s %10s %10s %8s %8s %7s %7s %9s %9s %9s %9s\n", "Hz", "edges/s", "samples/s",
+           "lost", "overruns", "dropped", "skipped", "p50 us", "p90 us", "p99 us", "max us");
+    
+    int frequencies = argc - optind;
+    int count = frequencies > 0 ? frequencies : (int) (sizeof(defaultFrequencies) / sizeof(defaultFrequencies[0]));
+    for (int i = 0; i < count; i++)
+    {
+        uint32_t frequency = frequencies > 0 ? (uint32_t) strtoul(argv[optind + i], NULL, 10)
+                                             : defaultFrequencies[i];
+        if (!run_frequency(sock, read_some, frequency, seconds))
+        {
+            fprintf(stderr, "Connection closed\n");
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,378 @@
+/* Kernel Benchmark
+
+   Times the per-block work of the stream path on the host CPU, one block
+   of SAMPLE_BLOCK_SIZE samples at a time, and prints Msamples/s and
+   ns/sample for each:
+
+   - the three Ascii85 encoders (see base85.h)
+   - delta varint encoding and decoding of edge counts and of edge records
+   - the frame CRC
+   - edge record decoding and windowed edge statistics
+
+   Edge counts rise by one per sample; edge records are 25 kHz periods with
+   a little jitter, both as the firmware would produce them. Absolute
+   numbers are for the host, not the ESP32, but the ratios between kernels
+   and the effect of a change to one are what this is for.
+
+   Then LZ4 compression (see lz4_block.h) of four streams, each raw and
+   after delta varint coding, as CONFIG_STREAM_BINARY_LZ4 would send them:
+   counts rising by one per sample, counts of a 37 kHz signal read at
+   10 kHz (3 or 4 per sample), edge records with 64 cycles of jitter as
+   from an external signal, and with 4 cycles as from the board's own
+   generator. For each it prints the compressed size as a percentage,
+   and compression and decompression time per input byte, with cycles of
+   the host's time stamp counter where it has one. The board's stats
+   record gives the same ratio and cycles/byte measured on the ESP32.
+
+   Last, zlib deflate of the same four streams as Ascii85 text, as a telnet
+   COMPRESS2 client is sent them (see stream_server.h): a continuous
+   stream, flushed once per send() of one TCP segment's worth, at several
+   compression levels, window sizes and memory levels. For each it prints
+   the compressed size, time and cycles per input byte, and the memory
+   zlib allocated.
+
+   Usage:
+
+     fg_kernels [seconds per kernel]     (default 0.5)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "sample_pool.h"
+#include "base85.h"
+#include "delta_codec.h"
+#include "lz4_block.h"
+#include "edge_record.h"
+#include "edge_stats.h"
+#include "wire_format.h"
+
+#define CLOCK_MHZ 160
+#define PERIOD_CYCLES (CLOCK_MHZ * 40)
+#define DEFLATE_SAMPLES (SAMPLE_BLOCK_SIZE * 4)     // More text than the largest window.
+#define DEFLATE_CHUNK (CONFIG_LWIP_TCP_MSS / 5 * 5) // Text per send(), as the stream server.
+
+typedef size_t (*kernel_t)(void);
+
+static int32_t counts[SAMPLE_BLOCK_SIZE];
+static int32_t records[SAMPLE_BLOCK_SIZE];
+static int32_t decoded[SAMPLE_BLOCK_SIZE];
+static edge_time_t edges[SAMPLE_BLOCK_SIZE];
+static uint8_t countsVarint[DELTA_VARINT_MAX_SIZE(SAMPLE_BLOCK_SIZE)];
+static uint8_t recordsVarint[DELTA_VARINT_MAX_SIZE(SAMPLE_BLOCK_SIZE)];
+static size_t countsVarintSize;
+static size_t recordsVarintSize;
+static char text[SAMPLE_BLOCK_SIZE * 5];
+static edge_stats_t edgeStats;
+static int32_t rateCounts[SAMPLE_BLOCK_SIZE];
+static int32_t steadyRecords[SAMPLE_BLOCK_SIZE];
+static uint8_t varint[DELTA_VARINT_MAX_SIZE(SAMPLE_BLOCK_SIZE)];
+static uint8_t compressed[LZ4_BLOCK_MAX_SIZE(DELTA_VARINT_MAX_SIZE(SAMPLE_BLOCK_SIZE))];
+static uint8_t decompressed[DELTA_VARINT_MAX_SIZE(SAMPLE_BLOCK_SIZE)];
+static lz4_block_arena_t arena;
+static int32_t deflateSamples[DEFLATE_SAMPLES];
+static char deflateText[DEFLATE_SAMPLES * 5];
+static uint8_t deflateOut[2 * DEFLATE_CHUNK];
+static size_t zlibBytes;
+
+static size_t run_base85_reference(void)
+{
+    return base85_encode_block_reference(counts, SAMPLE_BLOCK_SIZE, text);
+}
+
+static size_t run_base85_mulshift(void)
+{
+    return base85_encode_block_mulshift(counts, SAMPLE_BLOCK_SIZE, text);
+}
+
+static size_t run_base85_lut2(void)
+{
+    return base85_encode_block_lut2(counts, SAMPLE_BLOCK_SIZE, text);
+}
+
+static size_t run_varint_encode_counts(void)
+{
+    return delta_varint_encode(counts, SAMPLE_BLOCK_SIZE, countsVarint, sizeof(countsVarint));
+}
+
+static size_t run_varint_decode_counts(void)
+{
+    return delta_varint_decode(countsVarint, countsVarintSize, decoded, SAMPLE_BLOCK_SIZE);
+}
+
+static size_t run_varint_encode_records(void)
+{
+    return delta_varint_encode(records, SAMPLE_BLOCK_SIZE, recordsVarint, sizeof(recordsVarint));
+}
+
+static size_t run_varint_decode_records(void)
+{
+    return delta_varint_decode(recordsVarint, recordsVarintSize, decoded, SAMPLE_BLOCK_SIZE);
+}
+
+static size_t run_crc32(void)
+{
+    return wire_crc32(0, counts, sizeof(counts));
+}
+
+static size_t run_edge_record_decode(void)
+{
+    return edge_record_decode(records, SAMPLE_BLOCK_SIZE, 0, edges);
+}
+
+static size_t run_edge_stats(void)
+{
+    static uint64_t base = 0;
+    edge_summary_t summary;
+    size_t summaries = 0;
+    
+    // Rising edges only, as capture does. Time keeps moving forward from
+    // one block to the next.
+    for (size_t i = 0; i < SAMPLE_BLOCK_SIZE; i++)
+    {
+        if (edges[i].level)
+        {
+            summaries += edge_stats_add(&edgeStats, base + edges[i].cycles, &summary);
+        }
+    }
+    base += edges[SAMPLE_BLOCK_SIZE - 1].cycles;
+    return summaries;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Host cycles, or 0 where there is no cycle counter to read.
+static uint64_t cycles_now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static void time_kernel(const char *name, kernel_t kernel, double seconds)
+{
+    volatile size_t sink = 0;
+    uint64_t blocks = 0;
+    
+    // Warm the caches and any lazily built tables first.
+    sink += kernel();
+    double start = now_seconds();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            sink += kernel();
+        }
+        blocks += 16;
+        elapsed = now_seconds() - start;
+    } while (elapsed < seconds);
+    
+    double samples = (double) blocks * SAMPLE_BLOCK_SIZE;
+    printf("%-24s %10.1f %10.2f\n", name, samples / elapsed / 1e6, elapsed * 1e9 / samples);
+    (void) sink;
+}
+
+/*
+  Times compressing 'len' bytes, then decompressing the result, and prints
+  the ratio and time per input byte of each.
+ */
+static void time_lz4(const char *name, const void *in, size_t len, double seconds)
+{
+    size_t size = lz4_block_compress(in, len, compressed, sizeof(compressed), &arena);
+    double ns[2];
+    double cycles[2];
+    
+    if (size == 0 || lz4_block_decompress(compressed, size, decompressed, sizeof(decompressed)) != len ||
+        memcmp(in, decompressed, len) != 0)
+    {
+        printf("%-24s round trip failed\n", name);
+        return;
+    }
+    for (int pass = 0; pass < 2; pass++)
+    {
+        volatile size_t sink = 0;
+        uint64_t blocks = 0;
+        uint64_t startCycles = cycles_now();
+        double start = now_seconds();
+        double elapsed;
+        do
+        {
+            for (int i = 0; i < 16; i++)
+            {
+                sink += pass == 0 ? lz4_block_compress(in, len, compressed, sizeof(compressed), &arena)
+                                  : lz4_block_decompress(compressed, size, decompressed, sizeof(decompressed));
+            }
+            blocks += 16;
+            elapsed = now_seconds() - start;
+        } while (elapsed < seconds);
+        ns[pass] = elapsed * 1e9 / (blocks * len);
+        cycles[pass] = (double) (cycles_now() - startCycles) / (blocks * len);
+        (void) sink;
+    }
+    printf("%-24s %8.1f %10.2f %10.2f %10.2f %10.2f\n", name, 100.0 * size / len,
+           ns[0], cycles[0], ns[1], cycles[1]);
+}
+
+// Counts what zlib allocates.
+static void *count_alloc(void *opaque, unsigned int items, unsigned int size)
+{
+    zlibBytes += (size_t) items * size;
+    return calloc(items, size);
+}
+
+static void count_free(void *opaque, void *address)
+{
+    free(address);
+}
+
+// Fills deflateSamples with one of the four streams, continuing for
+// DEFLATE_SAMPLES, and deflateText with its Ascii85 text.
+static void deflate_stream(int stream)
+{
+    srand(1);
+    for (size_t i = 0; i < DEFLATE_SAMPLES; i++)
+    {
+        switch (stream)
+        {
+            case 0: deflateSamples[i] = (int32_t) (1000000 + i); break;
+            case 1: deflateSamples[i] = (int32_t) (1000000 + i * 37 / 10); break;
+            case 2: deflateSamples[i] = edge_record_pack(PERIOD_CYCLES / 2 + rand() % 64 - 32, i & 1); break;
+            default: deflateSamples[i] = edge_record_pack(PERIOD_CYCLES / 2 + rand() % 4 - 2, i & 1); break;
+        }
+    }
+    base85_encode_block_mulshift(deflateSamples, DEFLATE_SAMPLES, deflateText);
+}
+
+/*
+  Times deflating the text a chunk at a time, with a sync flush after each
+  as libtelnet does, and prints the ratio, time and memory.
+ */
+static void time_deflate(const char *name, int level, int windowBits, int memLevel, double seconds)
+{
+    z_stream z = { .zalloc = count_alloc, .zfree = count_free };
+    uint64_t in = 0;
+    uint64_t out = 0;
+    size_t pos = 0;
+    
+    zlibBytes = sizeof(z);
+    if (deflateInit2(&z, level, Z_DEFLATED, windowBits, memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        printf("%-24s deflateInit2 failed\n", name);
+        return;
+    }
+    uint64_t startCycles = cycles_now();
+    double start = now_seconds();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            size_t chunk = sizeof(deflateText) - pos < DEFLATE_CHUNK ? sizeof(deflateText) - pos : DEFLATE_CHUNK;
+            z.next_in = (Bytef *) deflateText + pos;
+            z.avail_in = chunk;
+            do
+            {
+                z.next_out = deflateOut;
+                z.avail_out = sizeof(deflateOut);
+                deflate(&z, Z_SYNC_FLUSH);
+                out += sizeof(deflateOut) - z.avail_out;
+            } while (z.avail_in > 0 || z.avail_out == 0);
+            in += chunk;
+            pos = (pos + chunk) % sizeof(deflateText);
+        }
+        elapsed = now_seconds() - start;
+    } while (elapsed < seconds);
+    double cycles = (double) (cycles_now() - startCycles) / in;
+    deflateEnd(&z);
+    
+    char settings[16];
+    snprintf(settings, sizeof(settings), "%d/%d/%d", level, windowBits, memLevel);
+    printf("%-24s %-8s %8.1f %10.2f %10.2f %8.1f\n", name, settings, 100.0 * out / in,
+           elapsed * 1e9 / in, cycles, zlibBytes / 1024.0);
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    
+    srand(1);
+    for (size_t i = 0; i < SAMPLE_BLOCK_SIZE; i++)
+    {
+        counts[i] = (int32_t) (1000000 + i);
+        records[i] = edge_record_pack(PERIOD_CYCLES / 2 + rand() % 64 - 32, i & 1);
+        rateCounts[i] = (int32_t) (1000000 + i * 37 / 10);
+        steadyRecords[i] = edge_record_pack(PERIOD_CYCLES / 2 + rand() % 4 - 2, i & 1);
+    }
+    countsVarintSize = run_varint_encode_counts();
+    recordsVarintSize = run_varint_encode_records();
+    run_edge_record_decode();
+    edge_stats_init(&edgeStats, 0, (uint64_t) CLOCK_MHZ * 1000000 / 10, 0);
+    base85_init();
+    
+    printf("%d samples/block; varint %.2f bytes/count, %.2f bytes/edge record\n", SAMPLE_BLOCK_SIZE,
+           (double) countsVarintSize / SAMPLE_BLOCK_SIZE, (double) recordsVarintSize / SAMPLE_BLOCK_SIZE);
+    printf("%-24s %10s %10s\n", "kernel", "Msamples/s", "ns/sample");
+    time_kernel("base85 reference", run_base85_reference, seconds);
+    time_kernel("base85 mulshift", run_base85_mulshift, seconds);
+    time_kernel("base85 lut2", run_base85_lut2, seconds);
+    time_kernel("varint encode counts", run_varint_encode_counts, seconds);
+    time_kernel("varint decode counts", run_varint_decode_counts, seconds);
+    time_kernel("varint encode records", run_varint_encode_records, seconds);
+    time_kernel("varint decode records", run_varint_decode_records, seconds);
+    time_kernel("crc32", run_crc32, seconds);
+    time_kernel("edge record decode", run_edge_record_decode, seconds);
+    time_kernel("edge stats", run_edge_stats, seconds);
+    
+    const struct
+    {
+        const char *name;
+        const int32_t *samples;
+    } streams[] = {
+        { "counts +1", counts },
+        { "counts 3.7", rateCounts },
+        { "records 64 jitter", records },
+        { "records 4 jitter", steadyRecords },
+    };
+    char name[32];
+    printf("\n%-24s %8s %10s %10s %10s %10s\n", "LZ4 input", "size %", "ns/byte", "cycles/B",
+           "decode ns", "cycles/B");
+    for (size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); i++)
+    {
+        snprintf(name, sizeof(name), "%s raw", streams[i].name);
+        time_lz4(name, streams[i].samples, SAMPLE_BLOCK_SIZE * sizeof(int32_t), seconds);
+        size_t size = delta_varint_encode(streams[i].samples, SAMPLE_BLOCK_SIZE, varint, sizeof(varint));
+        snprintf(name, sizeof(name), "%s varint", streams[i].name);
+        time_lz4(name, varint, size, seconds);
+    }
+    
+    // Level, window bits and memory level: the telnet stream's defaults,
+    // around them, and zlib's own defaults.
+    static const int settings[][3] = {
+        { 1, 9, 1 }, { 1, 10, 3 }, { 1, 12, 4 }, { 6, 10, 3 }, { 6, 15, 8 },
+    };
+    printf("\n%-24s %-8s %8s %10s %10s %8s\n", "Deflate Ascii85", "l/w/m", "size %", "ns/byte",
+           "cycles/B", "KB");
+    for (size_t i = 0; i < sizeof(streams) / sizeof(streams[0]); i++)
+    {
+        deflate_stream(i);
+        for (size_t j = 0; j < sizeof(settings) / sizeof(settings[0]); j++)
+        {
+            time_deflate(streams[i].name, settings[j][0], settings[j][1], settings[j][2], seconds);
+        }
+    }
+    return 0;
+}
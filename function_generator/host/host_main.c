@@ -0,0 +1,84 @@
+/* Host Firmware
+
+   Runs the firmware on Linux: app_main() and its tasks as they are built
+   for the ESP32, against the shims in include/ and shim/. The stream
+   server listens on CONFIG_STREAM_PORT of every local address, and each
+   capture channel can be driven with a synthetic square wave, so
+   tools/stream_decode can be pointed at it as at a board.
+
+   Usage:
+
+     function_generator [-f frequency] [-s] [-w] [-l percent] [-q]
+
+     -f   square wave on every capture channel, in Hz (default 1000; 0 for none)
+     -s   write the square waves into the capture rings with the software
+          signal source (see signal_gen.h) rather than through the pins;
+          the first SIGNAL_OUTPUTS channels only
+     -w   short writes: sends take a random part of their data or none (see
+          host.h), to exercise the stream server's partial sends
+     -l   lose this percentage of TCP segments and UDP stream datagrams
+          (see host.h)
+     -q   log warnings and errors only
+*/
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "esp_log.h"
+#include "capture.h"
+#include "signal_gen.h"
+#include "wire_format.h"
+#include "host.h"
+
+void app_main(void);
+
+int main(int argc, char **argv)
+{
+    uint32_t frequency = 1000;
+    bool soft = false;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "f:swl:q")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': frequency = (uint32_t) strtoul(optarg, NULL, 10); break;
+            case 's': soft = true; break;
+            case 'w': host_set_short_writes(true); break;
+            case 'l': host_set_loss(atof(optarg)); break;
+            case 'q': esp_log_level_set("*", ESP_LOG_WARN); break;
+            default:
+                fprintf(stderr, "Usage: %s [-f frequency] [-s] [-w] [-l percent] [-q]\n", argv[0]);
+                return 2;
+        }
+    }
+    
+    // lwIP reports a connection closed under a send as an error, not a signal.
+    signal(SIGPIPE, SIG_IGN);
+    // Builds the CRC table before the tasks can race to.
+    wire_crc32(0, NULL, 0);
+    
+    app_main();
+    for (int channel = 0; channel < CAPTURE_CHANNELS && frequency > 0; channel++)
+    {
+        signal_config_t config = {
+            .source = SIGNAL_SOURCE_SOFT,
+            .target = channel,
+            .frequency = frequency,
+            .dutyPercent = 50,
+        };
+        if (!soft)
+        {
+            host_gpio_generate(capture_channels[channel].gpio, frequency);
+        }
+        else if (channel < SIGNAL_OUTPUTS)
+        {
+            signal_gen_start(channel, &config);
+        }
+    }
+    for (;;)
+    {
+        pause();
+    }
+}
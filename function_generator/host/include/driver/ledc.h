@@ -0,0 +1,67 @@
+/* LEDC Driver (host shim)
+
+   There is no LEDC peripheral on the host: configuring it fails with
+   ESP_ERR_NOT_SUPPORTED. Use the software signal source instead.
+*/
+#ifndef DRIVER_LEDC_H
+#define DRIVER_LEDC_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef enum { LEDC_HIGH_SPEED_MODE, LEDC_LOW_SPEED_MODE } ledc_mode_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1, LEDC_TIMER_2, LEDC_TIMER_3 } ledc_timer_t;
+typedef enum { LEDC_CHANNEL_0, LEDC_CHANNEL_1, LEDC_CHANNEL_2, LEDC_CHANNEL_3 } ledc_channel_t;
+typedef enum { LEDC_INTR_DISABLE, LEDC_INTR_FADE_END } ledc_intr_type_t;
+typedef enum { LEDC_AUTO_CLK, LEDC_USE_REF_TICK, LEDC_USE_APB_CLK } ledc_clk_cfg_t;
+typedef int ledc_timer_bit_t;
+
+typedef struct
+{
+    ledc_mode_t speed_mode;
+    ledc_timer_bit_t duty_resolution;
+    ledc_timer_t timer_num;
+    uint32_t freq_hz;
+    ledc_clk_cfg_t clk_cfg;
+} ledc_timer_config_t;
+
+typedef struct
+{
+    int gpio_num;
+    ledc_mode_t speed_mode;
+    ledc_channel_t channel;
+    ledc_intr_type_t intr_type;
+    ledc_timer_t timer_sel;
+    uint32_t duty;
+    int hpoint;
+} ledc_channel_config_t;
+
+static inline esp_err_t ledc_timer_config(const ledc_timer_config_t *config)
+{
+    (void) config;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t ledc_channel_config(const ledc_channel_config_t *config)
+{
+    (void) config;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t ledc_set_freq(ledc_mode_t mode, ledc_timer_t timer, uint32_t frequency)
+{
+    (void) mode;
+    (void) timer;
+    (void) frequency;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t ledc_stop(ledc_mode_t mode, ledc_channel_t channel, uint32_t idleLevel)
+{
+    (void) mode;
+    (void) channel;
+    (void) idleLevel;
+    return ESP_OK;
+}
+
+#endif // DRIVER_LEDC_H
@@ -0,0 +1,97 @@
+/* RMT Driver (host shim)
+
+   There is no RMT peripheral on the host: configuring it fails with
+   ESP_ERR_NOT_SUPPORTED. Use the software signal source instead.
+*/
+#ifndef DRIVER_RMT_H
+#define DRIVER_RMT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef enum { RMT_CHANNEL_0, RMT_CHANNEL_1, RMT_CHANNEL_2, RMT_CHANNEL_3 } rmt_channel_t;
+typedef enum { RMT_MODE_TX, RMT_MODE_RX } rmt_mode_t;
+typedef enum { RMT_IDLE_LEVEL_LOW, RMT_IDLE_LEVEL_HIGH } rmt_idle_level_t;
+
+typedef struct
+{
+    uint32_t duration0 : 15;
+    uint32_t level0 : 1;
+    uint32_t duration1 : 15;
+    uint32_t level1 : 1;
+} rmt_item32_t;
+
+typedef struct
+{
+    bool loop_en;
+    bool idle_output_en;
+    rmt_idle_level_t idle_level;
+} rmt_tx_config_t;
+
+typedef struct
+{
+    rmt_mode_t rmt_mode;
+    rmt_channel_t channel;
+    int gpio_num;
+    uint8_t clk_div;
+    uint8_t mem_block_num;
+    rmt_tx_config_t tx_config;
+} rmt_config_t;
+
+static inline esp_err_t rmt_config(const rmt_config_t *config)
+{
+    (void) config;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t rmt_driver_install(rmt_channel_t channel, size_t rxBufferSize, int flags)
+{
+    (void) channel;
+    (void) rxBufferSize;
+    (void) flags;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t rmt_fill_tx_items(rmt_channel_t channel, const rmt_item32_t *items,
+                                          uint16_t count, uint16_t offset)
+{
+    (void) channel;
+    (void) items;
+    (void) count;
+    (void) offset;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t rmt_write_items(rmt_channel_t channel, const rmt_item32_t *items,
+                                        int count, bool wait)
+{
+    (void) channel;
+    (void) items;
+    (void) count;
+    (void) wait;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t rmt_tx_start(rmt_channel_t channel, bool reset)
+{
+    (void) channel;
+    (void) reset;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t rmt_tx_stop(rmt_channel_t channel)
+{
+    (void) channel;
+    return ESP_OK;
+}
+
+static inline esp_err_t rmt_wait_tx_done(rmt_channel_t channel, TickType_t wait)
+{
+    (void) channel;
+    (void) wait;
+    return ESP_OK;
+}
+
+#endif // DRIVER_RMT_H
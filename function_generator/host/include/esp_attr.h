@@ -0,0 +1,14 @@
+/* ESP-IDF Attributes (host shim)
+
+   Memory placement means nothing on the host.
+*/
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define WORD_ALIGNED_ATTR __attribute__((aligned(4)))
+#define __NOINIT_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif // ESP_ATTR_H
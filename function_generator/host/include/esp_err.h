@@ -0,0 +1,44 @@
+/* ESP-IDF Error Codes (host shim)
+*/
+#ifndef ESP_ERR_H
+#define ESP_ERR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_NVS_NO_FREE_PAGES 0x110d
+#define ESP_ERR_NVS_NEW_VERSION_FOUND 0x1110
+
+static inline const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code)
+    {
+        case ESP_OK: return "ESP_OK";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        default: return "ESP_FAIL";
+    }
+}
+
+#define ESP_ERROR_CHECK(x) do                                                  \
+    {                                                                           \
+        esp_err_t err_rc_ = (x);                                                \
+        if (err_rc_ != ESP_OK)                                                  \
+        {                                                                       \
+            fprintf(stderr, "ESP_ERROR_CHECK failed: 0x%x at %s:%d (%s)\n",   \
+                    err_rc_, __FILE__, __LINE__, #x);                           \
+            abort();                                                            \
+        }                                                                       \
+    } while (0)
+
+#endif // ESP_ERR_H
@@ -0,0 +1,27 @@
+/* ESP-IDF Event Loop (host shim)
+
+   Handlers are called from the function posting the event, one event at
+   a time and in the order they were posted, as the default event loop
+   task would call them. An event posted while another is being handled,
+   by a handler or by another thread, is queued and handled after it by
+   the poster already handling events, so posting can return before the
+   handlers have run.
+*/
+#ifndef ESP_EVENT_H
+#define ESP_EVENT_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *arg, esp_event_base_t base, int32_t id, void *data);
+
+#define ESP_EVENT_ANY_ID -1
+
+esp_err_t esp_event_loop_create_default(void);
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id,
+                                     esp_event_handler_t handler, void *arg);
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, void *data, size_t size,
+                         uint32_t ticks);
+
+#endif // ESP_EVENT_H
@@ -0,0 +1,8 @@
+/* esp_http_server.h (host shim)
+
+   Included by the firmware but not used by it.
+*/
+#ifndef ESP_HTTP_SERVER_H
+#define ESP_HTTP_SERVER_H
+
+#endif // ESP_HTTP_SERVER_H
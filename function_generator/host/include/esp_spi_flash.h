@@ -0,0 +1,8 @@
+/* esp_spi_flash.h (host shim)
+
+   Included by the firmware but not used by it.
+*/
+#ifndef ESP_SPI_FLASH_H
+#define ESP_SPI_FLASH_H
+
+#endif // ESP_SPI_FLASH_H
@@ -0,0 +1,52 @@
+/* ESP-IDF High Resolution Timer (host shim)
+
+   Only the clock. Timers cannot be created on the host; the signal
+   generator uses them only for its LEDC and RMT sources, which the host
+   does not have either.
+*/
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+} esp_timer_create_args_t;
+
+// Microseconds since the program started.
+int64_t esp_timer_get_time(void);
+
+static inline esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *timer)
+{
+    (void) args;
+    *timer = NULL;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period)
+{
+    (void) timer;
+    (void) period;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    (void) timer;
+    return ESP_ERR_INVALID_STATE;
+}
+
+static inline esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    (void) timer;
+    return ESP_ERR_INVALID_STATE;
+}
+
+#endif // ESP_TIMER_H
@@ -0,0 +1,66 @@
+/* WiFi (host shim)
+
+   Starting the station "connects" at once: WIFI_EVENT_STA_START is
+   posted, and the esp_wifi_connect() that answers it posts
+   IP_EVENT_STA_GOT_IP with the loopback address. While the access point
+   is away (see host_wifi_set_up() in host.h) esp_wifi_connect() posts
+   WIFI_EVENT_STA_DISCONNECTED instead.
+*/
+#ifndef ESP_WIFI_H
+#define ESP_WIFI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#include "tcpip_adapter.h"
+
+extern esp_event_base_t WIFI_EVENT;
+
+typedef enum
+{
+    WIFI_EVENT_STA_START,
+    WIFI_EVENT_STA_STOP,
+    WIFI_EVENT_STA_CONNECTED,
+    WIFI_EVENT_STA_DISCONNECTED,
+} wifi_event_t;
+
+typedef enum
+{
+    WIFI_MODE_NULL,
+    WIFI_MODE_STA,
+    WIFI_MODE_AP,
+    WIFI_MODE_APSTA,
+} wifi_mode_t;
+
+typedef enum
+{
+    ESP_IF_WIFI_STA,
+    ESP_IF_WIFI_AP,
+} esp_interface_t;
+
+typedef struct
+{
+    int unused;
+} wifi_init_config_t;
+
+#define WIFI_INIT_CONFIG_DEFAULT() { 0 }
+
+typedef struct
+{
+    uint8_t ssid[32];
+    uint8_t password[64];
+} wifi_sta_config_t;
+
+typedef union
+{
+    wifi_sta_config_t sta;
+} wifi_config_t;
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config);
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode);
+esp_err_t esp_wifi_set_config(esp_interface_t interface, wifi_config_t *config);
+esp_err_t esp_wifi_start(void);
+esp_err_t esp_wifi_connect(void);
+
+#endif // ESP_WIFI_H
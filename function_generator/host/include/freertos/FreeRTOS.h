@@ -0,0 +1,44 @@
+/* FreeRTOS (host shim)
+
+   The parts of the FreeRTOS API the firmware uses, for the host build.
+   Tasks are POSIX threads; see shim/freertos.c.
+*/
+#ifndef INC_FREERTOS_H
+#define INC_FREERTOS_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+#include "esp_attr.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+
+#define portMAX_DELAY ((TickType_t) 0xFFFFFFFFu)
+#define portTICK_PERIOD_MS (1000 / CONFIG_FREERTOS_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t) ((uint64_t) (ms) * CONFIG_FREERTOS_HZ / 1000))
+
+#if CONFIG_FREERTOS_UNICORE
+#define portNUM_PROCESSORS 1
+#else
+#define portNUM_PROCESSORS 2
+#endif
+
+// Interrupt handlers run on ordinary threads; see shim/gpio.c.
+#define portYIELD_FROM_ISR() ((void) 0)
+
+#define configASSERT(x) assert(x)
+
+// The core the calling task was pinned to.
+int xPortGetCoreID(void);
+
+#endif // INC_FREERTOS_H
@@ -0,0 +1,41 @@
+/* FreeRTOS Tasks (host shim)
+
+   Each task is a thread. Priorities are ignored and stacks are the
+   thread library's own; the core a task is pinned to is what
+   xPortGetCoreID() reports and, when the host has that many CPUs, the CPU
+   the thread runs on.
+*/
+#ifndef INC_TASK_H
+#define INC_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth,
+                                   void *parameters, UBaseType_t priority,
+                                   TaskHandle_t *created, BaseType_t core);
+
+#define xTaskCreate(code, name, stackDepth, parameters, priority, created) \
+    xTaskCreatePinnedToCore(code, name, stackDepth, parameters, priority, created, tskNO_AFFINITY)
+
+// NULL deletes the calling task.
+void vTaskDelete(TaskHandle_t task);
+
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t period);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+
+// Stack use is not measured; this is the whole stack asked for.
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+char *pcTaskGetTaskName(TaskHandle_t task);
+
+#endif // INC_TASK_H
@@ -0,0 +1,82 @@
+/* Host Hooks
+
+   Host-only functions beside the shimmed ESP-IDF API, for host_main.c and
+   the benchmarks.
+
+   The signal generator drives capture pins with square waves from a
+   thread of its own. Each edge toggles the pin's bit in GPIO.in and, when
+   the pin interrupts on that edge, calls its handler with CCOUNT reading
+   the cycle the edge was due at, so edge times are exact while the
+   generator keeps up. A generator that falls behind emits its late edges
+   in a burst rather than dropping them, stamped no earlier than any
+   CCOUNT value already read, as time never runs backwards.
+
+   With short writes on, accepted sockets get lwIP's send buffer size
+   (CONFIG_LWIP_TCP_SND_BUF_DEFAULT) rather than the host's much larger
+   one, so slow clients back up as they would on the board. On top of
+   that the firmware's send() calls take a random part of what they are
+   given, and non-blocking ones are sometimes refused with EAGAIN, however
+   much room the socket has.
+
+   With packet loss set, each TCP segment's worth of a non-blocking send()
+   and each stream datagram is lost with that probability. A lost datagram
+   is simply not sent. A lost segment is modelled by what it costs TCP: it
+   and everything after it wait for a retransmission timeout (500 ms, the
+   lwIP TCP timer tick) before the socket takes them.
+
+   The WiFi access point can be taken away and brought back. Taking it
+   away disconnects the station, and esp_wifi_connect() then fails until
+   it is back; reconnecting is left to the firmware's own retries.
+
+   The pulse counter units count only the edges they are given with
+   host_pcnt_count(). The overflow interrupt a wrap raises can be left
+   pending, to land later or in the middle of a counter read, so the
+   firmware's extension of the 16 bit count can be tested at each point
+   an interrupt may arrive.
+*/
+#ifndef HOST_H
+#define HOST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Makes xPortGetCoreID() report 'core' on the calling thread.
+void host_set_core(int core);
+
+// Nanoseconds since the program started; esp_timer time in finer units.
+uint64_t host_time_ns(void);
+
+// Starts, changes or (with 0) stops a square wave of 'frequency' Hz on the
+// pin. Edges continue from the pin's current level.
+void host_gpio_generate(int gpio, uint32_t frequency);
+
+// Edges so far that raised the pin's interrupt.
+uint64_t host_gpio_edges(int gpio);
+
+// esp_timer time in microseconds the pin's n-th interrupting edge (from 0)
+// was due at, or -1 if it has not been generated.
+double host_gpio_edge_time(int gpio, uint64_t edge);
+
+// Turns lwIP-sized send buffers, random short writes and refused sends on
+// or off.
+void host_set_short_writes(bool on);
+
+// Sets the packet loss, in percent; 0 for none.
+void host_set_loss(double percent);
+
+// Takes the WiFi access point away (false) or brings it back (true).
+void host_wifi_set_up(bool up);
+
+// Counts 'edges' on the pulse counter unit. Each wrap at the high limit
+// raises the overflow interrupt, which runs at once or, with 'defer', is
+// left pending.
+void host_pcnt_count(int unit, uint32_t edges, bool defer);
+
+// Runs the unit's pending overflow interrupts.
+void host_pcnt_interrupt(int unit);
+
+// Runs the unit's pending overflow interrupts during its next
+// pcnt_get_counter_value(), after the count has been read.
+void host_pcnt_interrupt_in_read(int unit);
+
+#endif // HOST_H
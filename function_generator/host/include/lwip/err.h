@@ -0,0 +1,8 @@
+/* lwIP err.h (host shim)
+
+   Included by the firmware but not used by it.
+*/
+#ifndef LWIP_ERR_H
+#define LWIP_ERR_H
+
+#endif // LWIP_ERR_H
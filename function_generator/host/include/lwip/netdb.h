@@ -0,0 +1,8 @@
+/* lwIP Name Resolution (host shim)
+*/
+#ifndef LWIP_NETDB_H
+#define LWIP_NETDB_H
+
+#include <netdb.h>
+
+#endif // LWIP_NETDB_H
@@ -0,0 +1,30 @@
+/* lwIP Sockets (host shim)
+
+   The lwIP socket API is the BSD one, so the host's sockets stand in.
+   accept(), send() and sendto() go through host_accept(), host_send() and
+   host_sendto(), which can be made to give sockets lwIP's small send
+   buffer, to take short writes and refuse sends the way a full lwIP
+   socket does, and to lose packets. See host.h.
+*/
+#ifndef LWIP_SOCKETS_H
+#define LWIP_SOCKETS_H
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+int host_accept(int sock, struct sockaddr *address, socklen_t *length);
+ssize_t host_send(int sock, const void *data, size_t length, int flags);
+ssize_t host_sendto(int sock, const void *data, size_t length, int flags,
+                    const struct sockaddr *address, socklen_t addressLength);
+
+#define accept(sock, address, length) host_accept(sock, address, length)
+#define send(sock, data, length, flags) host_send(sock, data, length, flags)
+#define sendto(sock, data, length, flags, address, addressLength) \
+    host_sendto(sock, data, length, flags, address, addressLength)
+
+#endif // LWIP_SOCKETS_H
@@ -0,0 +1,8 @@
+/* lwIP sys.h (host shim)
+
+   Included by the firmware but not used by it.
+*/
+#ifndef LWIP_SYS_H
+#define LWIP_SYS_H
+
+#endif // LWIP_SYS_H
@@ -0,0 +1,13 @@
+/* NVS Flash (host shim)
+
+   There is no flash to initialise; both calls succeed.
+*/
+#ifndef NVS_FLASH_H
+#define NVS_FLASH_H
+
+#include "esp_err.h"
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif // NVS_FLASH_H
@@ -0,0 +1,80 @@
+/* Host Configuration
+
+   Stands in for the sdkconfig.h menuconfig generates, for the host build.
+   Values are the Kconfig defaults except where noted; edit them here as
+   you would in menuconfig. Options for a choice are defined for the
+   selected entry only.
+*/
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+// Example Configuration
+#define CONFIG_ESP_WIFI_SSID "host"
+#define CONFIG_ESP_WIFI_PASSWORD ""
+#define CONFIG_ESP_MAX_STA_CONN 4
+#define CONFIG_WIFI_RECONNECT_INTERVAL_MS 5000
+
+// Signal Capture
+#define CONFIG_CAPTURE_BACKEND_GPIO_ISR 1       // The only backend with a host shim.
+#define CONFIG_CAPTURE_CHANNELS 2
+#define CONFIG_CAPTURE_CHANNEL_0_GPIO 4
+#define CONFIG_CAPTURE_CHANNEL_0_ANYEDGE 1
+#define CONFIG_CAPTURE_CHANNEL_1_GPIO 5
+#define CONFIG_CAPTURE_CHANNEL_2_GPIO 21
+#define CONFIG_CAPTURE_CHANNEL_3_GPIO 22
+#ifndef CONFIG_CAPTURE_FORMAT_EDGE_TIME     // Defined by the edge record test.
+#define CONFIG_CAPTURE_FORMAT_COUNTER 1
+#endif
+#define CONFIG_CAPTURE_PCNT_SAMPLE_PERIOD_MS 10
+#define CONFIG_EDGE_RING_SIZE 1024
+#define CONFIG_CAPTURE_DRAIN_THRESHOLD 64
+#define CONFIG_CAPTURE_DRAIN_TIMEOUT_MS 10
+#define CONFIG_CAPTURE_TASK_CORE 1
+#define CONFIG_NETWORK_TASK_CORE 0
+
+// Signal Generator
+#define CONFIG_SIGNAL_GEN_FREQUENCY_HZ 10000     // Used with CONFIG_SIGNAL_GEN_ENABLE.
+#define CONFIG_SIGNAL_GEN_DUTY_PERCENT 50
+
+// Sample Stream
+#define CONFIG_STREAM_PORT 2323                 // Port 23 needs root on Linux.
+#define CONFIG_SAMPLE_BLOCK_SIZE 5000
+#define CONFIG_SAMPLE_POOL_BLOCKS 4
+#define CONFIG_STREAM_DEFAULT_ASCII85 1
+#define CONFIG_BASE85_KERNEL_MULSHIFT 1
+#define CONFIG_STREAM_BINARY_RAW 1
+#define CONFIG_STREAM_TELNET_MCCP2 1            // Links the host's zlib.
+#define CONFIG_STREAM_MCCP2_CLIENTS 1
+#define CONFIG_STREAM_MCCP2_LEVEL 1
+#define CONFIG_STREAM_MCCP2_WINDOW_BITS 10
+#define CONFIG_STREAM_MCCP2_MEM_LEVEL 3
+#define CONFIG_STREAM_CONTENT_SAMPLES 1
+#define CONFIG_STREAM_SUMMARY_WINDOW_MS 1000
+#define CONFIG_STREAM_HANDSHAKE_TIMEOUT_MS 500
+#define CONFIG_STREAM_THROUGHPUT_LOG 1
+#define CONFIG_STREAM_STATS_INTERVAL_S 10
+#define CONFIG_STREAM_MAX_CLIENTS 4
+#define CONFIG_STREAM_CLIENT_QUEUE 2
+#define CONFIG_STREAM_REPLAY_BLOCKS 2
+#define CONFIG_STREAM_KEEPALIVE_IDLE_S 5
+#define CONFIG_STREAM_KEEPALIVE_INTERVAL_S 2
+#define CONFIG_STREAM_KEEPALIVE_COUNT 3
+#define CONFIG_STREAM_UDP_ENABLE 1
+#define CONFIG_STREAM_UDP_PORT 2323
+#define CONFIG_STREAM_UDP_DATAGRAM_SIZE 1472
+#define CONFIG_STREAM_UDP_MAX_SUBSCRIBERS 4
+#define CONFIG_STREAM_UDP_SUBSCRIPTION_S 10
+#define CONFIG_STREAM_UDP_MULTICAST_GROUP ""
+#define CONFIG_STREAM_PROFILE_IDF_DEFAULTS 1
+
+// Tracing
+#define CONFIG_TRACE_EVENTS 2048                // Used with CONFIG_TRACE_ENABLE.
+
+// ESP-IDF
+#define CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ 160
+#define CONFIG_FREERTOS_HZ 100
+#define CONFIG_LWIP_TCP_MSS 1440
+#define CONFIG_LWIP_TCP_SND_BUF_DEFAULT 5744
+#define CONFIG_LWIP_TCP_WND_DEFAULT 5744
+
+#endif // SDKCONFIG_H
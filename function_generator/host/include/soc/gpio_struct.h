@@ -0,0 +1,26 @@
+/* GPIO Registers (host shim)
+
+   The input level registers, kept up to date by the signal generator.
+*/
+#ifndef SOC_GPIO_STRUCT_H
+#define SOC_GPIO_STRUCT_H
+
+#include <stdint.h>
+
+typedef volatile struct
+{
+    uint32_t in;                // GPIO 0-31
+    union
+    {
+        struct
+        {
+            uint32_t data : 8;  // GPIO 32-39
+            uint32_t reserved8 : 24;
+        };
+        uint32_t val;
+    } in1;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
+
+#endif // SOC_GPIO_STRUCT_H
@@ -0,0 +1,43 @@
+/* TCP/IP Adapter (host shim)
+
+   The host's own network stack is used; the station is given the loopback
+   address.
+*/
+#ifndef TCPIP_ADAPTER_H
+#define TCPIP_ADAPTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_event.h"
+
+extern esp_event_base_t IP_EVENT;
+
+typedef enum
+{
+    IP_EVENT_STA_GOT_IP,
+    IP_EVENT_STA_LOST_IP,
+} ip_event_t;
+
+typedef struct
+{
+    uint32_t addr;              // Network byte order.
+} ip4_addr_t;
+
+typedef struct
+{
+    ip4_addr_t ip;
+    ip4_addr_t netmask;
+    ip4_addr_t gw;
+} tcpip_adapter_ip_info_t;
+
+typedef struct
+{
+    int if_index;
+    tcpip_adapter_ip_info_t ip_info;
+    bool ip_changed;
+} ip_event_got_ip_t;
+
+void tcpip_adapter_init(void);
+char *ip4addr_ntoa(const ip4_addr_t *addr);
+
+#endif // TCPIP_ADAPTER_H
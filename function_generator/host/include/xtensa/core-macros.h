@@ -0,0 +1,16 @@
+/* Xtensa Core Macros (host shim)
+
+   CCOUNT counts CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ cycles per microsecond of
+   esp_timer time, the same on every thread. While the signal generator
+   runs an interrupt handler it reads as the cycle the edge was due at.
+*/
+#ifndef XTENSA_CORE_MACROS_H
+#define XTENSA_CORE_MACROS_H
+
+#include <stdint.h>
+
+uint32_t host_ccount(void);
+
+#define XTHAL_GET_CCOUNT() host_ccount()
+
+#endif // XTENSA_CORE_MACROS_H
@@ -0,0 +1,252 @@
+/* ESP-IDF (host shim)
+
+   Timer, logging, system, NVS, event loop and WiFi stand-ins. See the
+   headers in include/.
+*/
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "nvs_flash.h"
+#include "tcpip_adapter.h"
+#include "host.h"
+
+#define MAX_HANDLERS 8
+#define MAX_EVENTS 16
+#define MAX_EVENT_DATA 64
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    esp_event_handler_t handler;
+    void *arg;
+} handler_t;
+
+typedef struct
+{
+    esp_event_base_t base;
+    int32_t id;
+    size_t size;
+    uint8_t data[MAX_EVENT_DATA];
+} event_t;
+
+_Static_assert(sizeof(ip_event_got_ip_t) <= MAX_EVENT_DATA, "Event data does not fit");
+
+esp_event_base_t WIFI_EVENT = "WIFI_EVENT";
+esp_event_base_t IP_EVENT = "IP_EVENT";
+
+static bool accessPointUp = true;
+static esp_log_level_t logLevel = ESP_LOG_INFO;
+static pthread_mutex_t logLock = PTHREAD_MUTEX_INITIALIZER;
+
+static handler_t handlers[MAX_HANDLERS];
+static int handlerCount = 0;
+
+// Events posted and not yet handled, and whether a poster is handling them.
+static event_t events[MAX_EVENTS];
+static int eventHead = 0;
+static int eventCount = 0;
+static bool dispatching = false;
+static pthread_mutex_t eventLock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct timespec start;
+
+// "Boot" is when the program starts.
+__attribute__((constructor)) static void start_timer(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+uint64_t host_time_ns(void)
+{
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) (now.tv_sec - start.tv_sec) * 1000000000ull + (now.tv_nsec - start.tv_nsec);
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return (int64_t) (host_time_ns() / 1000);
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    (void) tag;
+    logLevel = level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return (uint32_t) (esp_timer_get_time() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    va_list args;
+    
+    (void) tag;
+    if (level > logLevel)
+    {
+        return;
+    }
+    va_start(args, format);
+    pthread_mutex_lock(&logLock);
+    vprintf(format, args);
+    fflush(stdout);
+    pthread_mutex_unlock(&logLock);
+    va_end(args);
+}
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_event_loop_create_default(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_event_handler_register(esp_event_base_t base, int32_t id,
+                                     esp_event_handler_t handler, void *arg)
+{
+    if (handlerCount == MAX_HANDLERS)
+    {
+        return ESP_FAIL;
+    }
+    handlers[handlerCount++] = (handler_t) { base, id, handler, arg };
+    return ESP_OK;
+}
+
+static void dispatch(const event_t *event)
+{
+    for (int i = 0; i < handlerCount; i++)
+    {
+        if (handlers[i].base == event->base &&
+            (handlers[i].id == ESP_EVENT_ANY_ID || handlers[i].id == event->id))
+        {
+            handlers[i].handler(handlers[i].arg, event->base, event->id,
+                                event->size > 0 ? (void *) event->data : NULL);
+        }
+    }
+}
+
+esp_err_t esp_event_post(esp_event_base_t base, int32_t id, void *data, size_t size,
+                         uint32_t ticks)
+{
+    (void) ticks;
+    if (size > MAX_EVENT_DATA)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&eventLock);
+    if (eventCount == MAX_EVENTS)
+    {
+        pthread_mutex_unlock(&eventLock);
+        return ESP_FAIL;
+    }
+    event_t *event = &events[(eventHead + eventCount++) % MAX_EVENTS];
+    event->base = base;
+    event->id = id;
+    event->size = size;
+    if (size > 0)
+    {
+        memcpy(event->data, data, size);
+    }
+    
+    // Whoever is handling events will get to this one.
+    if (dispatching)
+    {
+        pthread_mutex_unlock(&eventLock);
+        return ESP_OK;
+    }
+    dispatching = true;
+    while (eventCount > 0)
+    {
+        event_t next = events[eventHead];
+        eventHead = (eventHead + 1) % MAX_EVENTS;
+        eventCount--;
+        pthread_mutex_unlock(&eventLock);
+        dispatch(&next);
+        pthread_mutex_lock(&eventLock);
+    }
+    dispatching = false;
+    pthread_mutex_unlock(&eventLock);
+    return ESP_OK;
+}
+
+void tcpip_adapter_init(void)
+{
+}
+
+char *ip4addr_ntoa(const ip4_addr_t *addr)
+{
+    static char text[INET_ADDRSTRLEN];
+    
+    return (char *) inet_ntop(AF_INET, &addr->addr, text, sizeof(text));
+}
+
+esp_err_t esp_wifi_init(const wifi_init_config_t *config)
+{
+    (void) config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_mode(wifi_mode_t mode)
+{
+    (void) mode;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(esp_interface_t interface, wifi_config_t *config)
+{
+    (void) interface;
+    (void) config;
+    return ESP_OK;
+}
+
+esp_err_t esp_wifi_start(void)
+{
+    return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_START, NULL, 0, 0);
+}
+
+esp_err_t esp_wifi_connect(void)
+{
+    ip_event_got_ip_t event = { 0 };
+    
+    if (!__atomic_load_n(&accessPointUp, __ATOMIC_RELAXED))
+    {
+        return esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, NULL, 0, 0);
+    }
+    event.ip_info.ip.addr = htonl(INADDR_LOOPBACK);
+    return esp_event_post(IP_EVENT, IP_EVENT_STA_GOT_IP, &event, sizeof(event), 0);
+}
+
+void host_wifi_set_up(bool up)
+{
+    __atomic_store_n(&accessPointUp, up, __ATOMIC_RELAXED);
+    if (!up)
+    {
+        esp_event_post(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED, NULL, 0, 0);
+    }
+}
@@ -0,0 +1,348 @@
+/* FreeRTOS (host shim)
+
+   See include/freertos/task.h.
+*/
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "host.h"
+
+struct host_task
+{
+    pthread_t thread;
+    char name[16];
+    uint32_t stackDepth;
+    int core;
+    TaskFunction_t code;
+    void *parameters;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notifications;
+};
+
+struct host_queue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t *items;
+};
+
+struct host_event_group
+{
+    pthread_mutex_t lock;
+    EventBits_t bits;
+};
+
+static __thread struct host_task *currentTask = NULL;
+static __thread int currentCore = 0;
+
+void host_set_core(int core)
+{
+    currentCore = core;
+}
+
+int xPortGetCoreID(void)
+{
+    return currentCore;
+}
+
+// CLOCK_REALTIME deadline for pthread_cond_timedwait(), 'ticks' from now.
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec deadline;
+    uint64_t ns = (uint64_t) ticks * 1000000000ull / CONFIG_FREERTOS_HZ;
+    
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ns / 1000000000ull;
+    deadline.tv_nsec += ns % 1000000000ull;
+    if (deadline.tv_nsec >= 1000000000)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+/*
+  Waits on 'cond' for at most 'ticks' (forever for portMAX_DELAY). Returns
+  false once the time is up.
+ */
+static bool wait_for(pthread_cond_t *cond, pthread_mutex_t *lock, TickType_t ticks,
+                     const struct timespec *deadline)
+{
+    if (ticks == 0)
+    {
+        return false;
+    }
+    if (ticks == portMAX_DELAY)
+    {
+        pthread_cond_wait(cond, lock);
+        return true;
+    }
+    return pthread_cond_timedwait(cond, lock, deadline) != ETIMEDOUT;
+}
+
+static void *task_start(void *arg)
+{
+    struct host_task *task = arg;
+    
+    currentTask = task;
+    if (task->core != tskNO_AFFINITY)
+    {
+        currentCore = task->core;
+        // Give each core a CPU of its own where the host has enough.
+        if (task->core < sysconf(_SC_NPROCESSORS_ONLN))
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(task->core, &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+    }
+    task->code(task->parameters);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth,
+                                   void *parameters, UBaseType_t priority,
+                                   TaskHandle_t *created, BaseType_t core)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+    
+    (void) priority;
+    if (task == NULL)
+    {
+        return pdFAIL;
+    }
+    strncpy(task->name, name, sizeof(task->name) - 1);
+    task->stackDepth = stackDepth;
+    task->core = core;
+    task->code = code;
+    task->parameters = parameters;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->notified, NULL);
+    if (created != NULL)
+    {
+        *created = task;
+    }
+    if (pthread_create(&task->thread, NULL, task_start, task) != 0)
+    {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Handles stay valid; other tasks may still hold them.
+    if (task == NULL || task == currentTask)
+    {
+        pthread_exit(NULL);
+    }
+    pthread_cancel(task->thread);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    if (ticks == 0)
+    {
+        sched_yield();
+        return;
+    }
+    uint64_t ns = (uint64_t) ticks * 1000000000ull / CONFIG_FREERTOS_HZ;
+    struct timespec delay = { .tv_sec = ns / 1000000000ull, .tv_nsec = ns % 1000000000ull };
+    while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+    {
+    }
+}
+
+void vTaskDelayUntil(TickType_t *previousWake, TickType_t period)
+{
+    TickType_t now = xTaskGetTickCount();
+    
+    *previousWake += period;
+    if ((int32_t) (*previousWake - now) > 0)
+    {
+        vTaskDelay(*previousWake - now);
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t) (esp_timer_get_time() * CONFIG_FREERTOS_HZ / 1000000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return currentTask;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+    struct host_task *task = currentTask;
+    struct timespec deadline = deadline_after(ticks);
+    uint32_t value;
+    
+    pthread_mutex_lock(&task->lock);
+    while (task->notifications == 0 && wait_for(&task->notified, &task->lock, ticks, &deadline))
+    {
+    }
+    value = task->notifications;
+    if (value > 0)
+    {
+        task->notifications = clearOnExit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return value;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notifications++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    if (higherPriorityTaskWoken != NULL)
+    {
+        *higherPriorityTaskWoken = pdFALSE;
+    }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    vTaskNotifyGiveFromISR(task, NULL);
+    // The tasks notified are of higher priority and would run straight away.
+    sched_yield();
+    return pdPASS;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return task != NULL ? task->stackDepth : 0;
+}
+
+char *pcTaskGetTaskName(TaskHandle_t task)
+{
+    if (task == NULL)
+    {
+        task = currentTask;
+    }
+    return task != NULL ? task->name : "main";
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    
+    if (queue == NULL || (queue->items = malloc(length * itemSize)) == NULL)
+    {
+        free(queue);
+        return NULL;
+    }
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    struct timespec deadline = deadline_after(ticks);
+    BaseType_t sent = pdFALSE;
+    
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length && wait_for(&queue->changed, &queue->lock, ticks, &deadline))
+    {
+    }
+    if (queue->count < queue->length)
+    {
+        UBaseType_t slot = (queue->head + queue->count) % queue->length;
+        memcpy(queue->items + slot * queue->itemSize, item, queue->itemSize);
+        queue->count++;
+        pthread_cond_broadcast(&queue->changed);
+        sent = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return sent;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    struct timespec deadline = deadline_after(ticks);
+    BaseType_t received = pdFALSE;
+    
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0 && wait_for(&queue->changed, &queue->lock, ticks, &deadline))
+    {
+    }
+    if (queue->count > 0)
+    {
+        memcpy(item, queue->items + queue->head * queue->itemSize, queue->itemSize);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+        received = pdTRUE;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return received;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    UBaseType_t count;
+    
+    pthread_mutex_lock(&queue->lock);
+    count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+    return count;
+}
+
+EventGroupHandle_t xEventGroupCreate(void)
+{
+    struct host_event_group *group = calloc(1, sizeof(*group));
+    
+    if (group != NULL)
+    {
+        pthread_mutex_init(&group->lock, NULL);
+    }
+    return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t result;
+    
+    pthread_mutex_lock(&group->lock);
+    result = (group->bits |= bits);
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    EventBits_t result;
+    
+    pthread_mutex_lock(&group->lock);
+    result = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
@@ -0,0 +1,316 @@
+/* GPIO and Signal Generator (host shim)
+
+   See include/driver/gpio.h and include/host.h.
+*/
+#include <pthread.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/gpio.h"
+#include "soc/gpio_struct.h"
+#include "xtensa/core-macros.h"
+#include "host.h"
+
+#define CPU_MHZ CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ
+#define MAX_SEGMENTS 64         // Frequency changes remembered per pin for edge times.
+#define MAX_BATCH 4096          // Edges emitted before the lock is let go.
+#define MAX_SLEEP_NS 10000000
+
+// Interrupting edges from 'firstEdge' on are due every 'intervalNs' from
+// 'firstNs'.
+typedef struct
+{
+    uint64_t firstEdge;
+    double firstNs;
+    double intervalNs;
+} segment_t;
+
+typedef struct
+{
+    gpio_int_type_t intrType;
+    gpio_isr_t handler;
+    void *arg;
+    uint32_t frequency;         // 0 when not generating.
+    uint64_t startNs;           // When toggle 0 of the current wave was due.
+    uint64_t toggles;           // Toggles of the current wave so far.
+    uint64_t edges;             // Interrupting edges so far.
+    segment_t segments[MAX_SEGMENTS];
+    int segmentCount;
+} pin_t;
+
+gpio_dev_t GPIO;
+
+static pin_t pins[GPIO_NUM_MAX];
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t changed;
+static bool serviceInstalled = false;
+static int isrCore = 0;
+
+static uint64_t latestNs = 0;           // Latest time CCOUNT has been read at.
+static __thread bool inHandler = false;
+static __thread uint32_t handlerCcount;
+
+uint32_t host_ccount(void)
+{
+    if (inHandler)
+    {
+        return handlerCcount;
+    }
+    uint64_t now = host_time_ns();
+    uint64_t latest = __atomic_load_n(&latestNs, __ATOMIC_RELAXED);
+    while (now > latest &&
+           !__atomic_compare_exchange_n(&latestNs, &latest, now, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+    return (uint32_t) (now * CPU_MHZ / 1000);
+}
+
+static bool get_level(int gpio)
+{
+    return gpio < 32 ? (GPIO.in >> gpio) & 1 : (GPIO.in1.data >> (gpio - 32)) & 1;
+}
+
+static void set_level(int gpio, bool level)
+{
+    volatile uint32_t *reg = gpio < 32 ? &GPIO.in : &GPIO.in1.val;
+    uint32_t bit = 1u << (gpio % 32);
+    
+    *reg = level ? (*reg | bit) : (*reg & ~bit);
+}
+
+static bool interrupts(gpio_int_type_t type, bool level)
+{
+    return type == GPIO_INTR_ANYEDGE || (type == GPIO_INTR_POSEDGE && level) ||
+           (type == GPIO_INTR_NEGEDGE && !level);
+}
+
+static uint64_t toggle_time(const pin_t *pin, uint64_t toggle)
+{
+    return pin->startNs + toggle * 500000000ull / pin->frequency;
+}
+
+// Records when the pin's interrupting edges are due from toggle 'toggle' of
+// the current wave on.
+static void start_segment(int gpio, uint64_t toggle)
+{
+    pin_t *pin = &pins[gpio];
+    double halfNs = 500000000.0 / pin->frequency;
+    bool level = get_level(gpio);
+    
+    if (pin->segmentCount == MAX_SEGMENTS || pin->handler == NULL || pin->intrType == GPIO_INTR_DISABLE)
+    {
+        return;
+    }
+    segment_t *segment = &pin->segments[pin->segmentCount++];
+    segment->firstEdge = pin->edges;
+    segment->firstNs = pin->startNs + toggle * halfNs;
+    segment->intervalNs = halfNs;
+    if (pin->intrType != GPIO_INTR_ANYEDGE)
+    {
+        // The first toggle to the wanted level, then every other one.
+        if (!interrupts(pin->intrType, !level))
+        {
+            segment->firstNs += halfNs;
+        }
+        segment->intervalNs = 2 * halfNs;
+    }
+}
+
+static void toggle_pin(int gpio, uint64_t dueNs)
+{
+    pin_t *pin = &pins[gpio];
+    bool level = !get_level(gpio);
+    
+    set_level(gpio, level);
+    pin->toggles++;
+    if (pin->handler != NULL && interrupts(pin->intrType, level))
+    {
+        uint64_t latest = __atomic_load_n(&latestNs, __ATOMIC_RELAXED);
+        handlerCcount = (uint32_t) ((dueNs > latest ? dueNs : latest) * CPU_MHZ / 1000);
+        inHandler = true;
+        pin->handler(pin->arg);
+        inHandler = false;
+        pin->edges++;
+    }
+}
+
+static void *generator(void *arg)
+{
+    (void) arg;
+    host_set_core(isrCore);
+    
+    pthread_mutex_lock(&lock);
+    for (;;)
+    {
+        uint64_t now = host_time_ns();
+        uint64_t next = UINT64_MAX;
+    
+        // Every edge now due, across pins in time order.
+        for (int emitted = 0; emitted < MAX_BATCH; emitted++)
+        {
+            int due = -1;
+            next = UINT64_MAX;
+            for (int gpio = 0; gpio < GPIO_NUM_MAX; gpio++)
+            {
+                if (pins[gpio].frequency > 0 && toggle_time(&pins[gpio], pins[gpio].toggles) < next)
+                {
+                    due = gpio;
+                    next = toggle_time(&pins[gpio], pins[gpio].toggles);
+                }
+            }
+            if (due < 0 || next > now)
+            {
+                break;
+            }
+            toggle_pin(due, next);
+        }
+    
+        if (next == UINT64_MAX)
+        {
+            pthread_cond_wait(&changed, &lock);
+            continue;
+        }
+        uint64_t sleepNs = next > now ? next - now : 0;
+        if (sleepNs > MAX_SLEEP_NS)
+        {
+            sleepNs = MAX_SLEEP_NS;
+        }
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += (deadline.tv_nsec + sleepNs) / 1000000000ull;
+        deadline.tv_nsec = (deadline.tv_nsec + sleepNs) % 1000000000ull;
+        pthread_cond_timedwait(&changed, &lock, &deadline);
+    }
+    return NULL;
+}
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    pthread_mutex_lock(&lock);
+    for (int gpio = 0; gpio < GPIO_NUM_MAX; gpio++)
+    {
+        if (config->pin_bit_mask & (1ULL << gpio))
+        {
+            pins[gpio].intrType = config->intr_type;
+            // Inputs idle high with a pull-up.
+            set_level(gpio, config->mode == GPIO_MODE_INPUT && config->pull_up_en);
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level)
+{
+    (void) gpio;
+    (void) level;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_intr_type(gpio_num_t gpio, gpio_int_type_t type)
+{
+    pthread_mutex_lock(&lock);
+    pins[gpio].intrType = type;
+    if (pins[gpio].frequency > 0)
+    {
+        start_segment(gpio, pins[gpio].toggles);
+    }
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int flags)
+{
+    pthread_t thread;
+    pthread_condattr_t attr;
+    
+    (void) flags;
+    if (serviceInstalled)
+    {
+        return ESP_FAIL;
+    }
+    // "Interrupts" are serviced on the core the service was installed from.
+    isrCore = xPortGetCoreID();
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&changed, &attr);
+    if (pthread_create(&thread, NULL, generator, NULL) != 0)
+    {
+        return ESP_FAIL;
+    }
+    pthread_detach(thread);
+    serviceInstalled = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t gpio, gpio_isr_t handler, void *arg)
+{
+    pthread_mutex_lock(&lock);
+    pins[gpio].handler = handler;
+    pins[gpio].arg = arg;
+    if (pins[gpio].frequency > 0)
+    {
+        start_segment(gpio, pins[gpio].toggles);
+    }
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t gpio)
+{
+    pthread_mutex_lock(&lock);
+    pins[gpio].handler = NULL;
+    pthread_mutex_unlock(&lock);
+    return ESP_OK;
+}
+
+void host_gpio_generate(int gpio, uint32_t frequency)
+{
+    pthread_mutex_lock(&lock);
+    pin_t *pin = &pins[gpio];
+    pin->frequency = frequency;
+    if (frequency > 0)
+    {
+        pin->startNs = host_time_ns();
+        pin->toggles = 0;
+        start_segment(gpio, 0);
+    }
+    if (serviceInstalled)
+    {
+        pthread_cond_signal(&changed);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+uint64_t host_gpio_edges(int gpio)
+{
+    uint64_t edges;
+    
+    pthread_mutex_lock(&lock);
+    edges = pins[gpio].edges;
+    pthread_mutex_unlock(&lock);
+    return edges;
+}
+
+double host_gpio_edge_time(int gpio, uint64_t edge)
+{
+    double time = -1;
+    
+    pthread_mutex_lock(&lock);
+    const pin_t *pin = &pins[gpio];
+    if (edge < pin->edges)
+    {
+        for (int i = pin->segmentCount - 1; i >= 0; i--)
+        {
+            const segment_t *segment = &pin->segments[i];
+            if (edge >= segment->firstEdge)
+            {
+                time = (segment->firstNs + (edge - segment->firstEdge) * segment->intervalNs) / 1000;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&lock);
+    return time;
+}
@@ -0,0 +1,124 @@
+/* lwIP Sockets (host shim)
+
+   accept(), send() and sendto() with optional lwIP-sized send buffers,
+   short writes and packet loss. See host.h.
+*/
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "sdkconfig.h"
+#include "wire_format.h"
+#include "host.h"
+
+#define LOSS_RTO_US 500000      // lwIP's TCP timer tick: no retransmission comes sooner.
+#define MAX_SOCKETS 1024
+
+static bool shortWrites = false;
+static uint32_t lossThreshold = 0;  // Loss probability times 2^32.
+static uint64_t stalledUntil[MAX_SOCKETS];  // us; a TCP socket waiting to resend.
+static _Thread_local uint32_t seed = 2463534242u;
+
+// xorshift32; only the spread matters.
+static uint32_t next_random(void)
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+// True with the loss probability.
+static bool lost(void)
+{
+    uint32_t threshold = __atomic_load_n(&lossThreshold, __ATOMIC_RELAXED);
+    
+    return threshold > 0 && next_random() < threshold;
+}
+
+void host_set_short_writes(bool on)
+{
+    __atomic_store_n(&shortWrites, on, __ATOMIC_RELAXED);
+}
+
+void host_set_loss(double percent)
+{
+    __atomic_store_n(&lossThreshold, (uint32_t) (percent / 100 * 4294967295.0), __ATOMIC_RELAXED);
+}
+
+int host_accept(int sock, struct sockaddr *address, socklen_t *length)
+{
+    int client = accept(sock, address, length);
+    if (client >= 0 && __atomic_load_n(&shortWrites, __ATOMIC_RELAXED))
+    {
+        int size = CONFIG_LWIP_TCP_SND_BUF_DEFAULT;
+        setsockopt(client, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    }
+    return client;
+}
+
+ssize_t host_send(int sock, const void *data, size_t length, int flags)
+{
+    if (__atomic_load_n(&shortWrites, __ATOMIC_RELAXED) && length > 0)
+    {
+        uint32_t r = next_random();
+        if ((flags & MSG_DONTWAIT) && r % 4 == 0)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+        if (r % 4 != 1)
+        {
+            length = 1 + (r >> 8) % length;
+        }
+    }
+    if ((flags & MSG_DONTWAIT) && __atomic_load_n(&lossThreshold, __ATOMIC_RELAXED) > 0 &&
+        sock >= 0 && sock < MAX_SOCKETS)
+    {
+        uint64_t now = host_time_ns() / 1000;
+        if (now < stalledUntil[sock])
+        {
+            // select() still says writable; keep the caller from spinning flat out.
+            usleep(100);
+            errno = EAGAIN;
+            return -1;
+        }
+        // The segments before a lost one go through; it and everything
+        // after wait for the retransmission.
+        for (size_t offset = 0; offset < length; offset += CONFIG_LWIP_TCP_MSS)
+        {
+            if (lost())
+            {
+                stalledUntil[sock] = now + LOSS_RTO_US;
+                if (offset == 0)
+                {
+                    errno = EAGAIN;
+                    return -1;
+                }
+                length = offset;
+                break;
+            }
+        }
+    }
+    return send(sock, data, length, flags);
+}
+
+ssize_t host_sendto(int sock, const void *data, size_t length, int flags,
+                    const struct sockaddr *address, socklen_t addressLength)
+{
+    uint32_t magic = 0;
+    
+    // Only stream datagrams are lost, not the firmware's loopback wake-ups.
+    if (length >= sizeof(magic))
+    {
+        memcpy(&magic, data, sizeof(magic));
+    }
+    if (magic == WIRE_MAGIC && lost())
+    {
+        return length;
+    }
+    return sendto(sock, data, length, flags, address, addressLength);
+}
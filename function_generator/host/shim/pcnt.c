@@ -0,0 +1,190 @@
+/* Pulse Counter (host shim)
+
+   See include/driver/pcnt.h and include/host.h.
+*/
+#include <stdbool.h>
+
+#include "driver/pcnt.h"
+#include "host.h"
+
+typedef struct
+{
+    bool configured;
+    bool running;
+    bool intrEnabled;
+    bool hLimEnabled;
+    int16_t hLim;
+    int16_t count;
+    void (*handler)(void *);
+    void *arg;
+    uint32_t pending;           // Overflow interrupts raised but not yet run.
+    bool interruptInRead;       // Run them during the next counter read.
+} unit_t;
+
+static unit_t units[PCNT_UNIT_MAX];
+static bool serviceInstalled = false;
+
+static bool valid(pcnt_unit_t unit)
+{
+    return unit >= 0 && unit < PCNT_UNIT_MAX && units[unit].configured;
+}
+
+esp_err_t pcnt_unit_config(const pcnt_config_t *config)
+{
+    if (config->unit < 0 || config->unit >= PCNT_UNIT_MAX || config->counter_h_lim <= 0)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    unit_t *unit = &units[config->unit];
+    
+    unit->configured = true;
+    unit->running = true;
+    unit->hLim = config->counter_h_lim;
+    unit->count = 0;
+    unit->pending = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_get_counter_value(pcnt_unit_t unit, int16_t *count)
+{
+    if (!valid(unit))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *count = units[unit].count;
+    if (units[unit].interruptInRead)
+    {
+        // The interrupt lands after the caller's look at the overflow
+        // count but before it can look again.
+        units[unit].interruptInRead = false;
+        host_pcnt_interrupt(unit);
+    }
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_pause(pcnt_unit_t unit)
+{
+    if (!valid(unit))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    units[unit].running = false;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_resume(pcnt_unit_t unit)
+{
+    if (!valid(unit))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    units[unit].running = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_counter_clear(pcnt_unit_t unit)
+{
+    if (!valid(unit))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    units[unit].count = 0;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_intr_enable(pcnt_unit_t unit)
+{
+    if (!valid(unit))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    units[unit].intrEnabled = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_event_enable(pcnt_unit_t unit, pcnt_evt_type_t event)
+{
+    if (!valid(unit))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (event == PCNT_EVT_H_LIM)
+    {
+        units[unit].hLimEnabled = true;
+    }
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_service_install(int intr_alloc_flags)
+{
+    (void) intr_alloc_flags;
+    if (serviceInstalled)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    serviceInstalled = true;
+    return ESP_OK;
+}
+
+esp_err_t pcnt_isr_handler_add(pcnt_unit_t unit, void (*isr_handler)(void *), void *args)
+{
+    if (!serviceInstalled)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!valid(unit))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    units[unit].handler = isr_handler;
+    units[unit].arg = args;
+    return ESP_OK;
+}
+
+void host_pcnt_count(int unit, uint32_t edges, bool defer)
+{
+    unit_t *u = &units[unit];
+    
+    if (!u->running)
+    {
+        return;
+    }
+    while (edges > 0)
+    {
+        uint32_t room = u->hLim - u->count;
+        if (edges < room)
+        {
+            u->count += edges;
+            return;
+        }
+        edges -= room;
+        u->count = 0;
+        if (u->hLimEnabled)
+        {
+            u->pending++;
+            if (!defer)
+            {
+                host_pcnt_interrupt(unit);
+            }
+        }
+    }
+}
+
+void host_pcnt_interrupt(int unit)
+{
+    unit_t *u = &units[unit];
+    
+    if (!u->intrEnabled || !serviceInstalled || u->handler == NULL)
+    {
+        return;
+    }
+    for (; u->pending > 0; u->pending--)
+    {
+        u->handler(u->arg);
+    }
+}
+
+void host_pcnt_interrupt_in_read(int unit)
+{
+    units[unit].interruptInRead = true;
+}
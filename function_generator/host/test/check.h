@@ -0,0 +1,63 @@
+/* Test Checks
+
+   The few assertions the host tests need. A failed check prints what it
+   compared and where, and the test carries on, so one run shows every
+   failure; check_exit() turns the count into the exit status ctest reads.
+
+   check_random() is a fixed-seed xorshift, so a failing randomised test
+   fails the same way every run.
+*/
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+static int checkFailures = 0;
+static uint32_t checkSeed = 2463534242u;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            checkFailures++; \
+        } \
+    } while (0)
+
+// As CHECK(a == b), printing both values.
+#define CHECK_EQ(a, b) \
+    do \
+    { \
+        long long checkA = (long long) (a); \
+        long long checkB = (long long) (b); \
+        if (checkA != checkB) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s == %s (%lld, %lld)\n", \
+                    __FILE__, __LINE__, #a, #b, checkA, checkB); \
+            checkFailures++; \
+        } \
+    } while (0)
+
+static inline uint32_t check_random(void)
+{
+    checkSeed ^= checkSeed << 13;
+    checkSeed ^= checkSeed >> 17;
+    checkSeed ^= checkSeed << 5;
+    return checkSeed;
+}
+
+// The exit status for main(): 0 if every check passed.
+static inline int check_exit(const char *name)
+{
+    if (checkFailures > 0)
+    {
+        fprintf(stderr, "%s: %d checks failed\n", name, checkFailures);
+        return 1;
+    }
+    printf("%s: passed\n", name);
+    return 0;
+}
+
+#endif // CHECK_H
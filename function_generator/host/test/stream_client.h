@@ -0,0 +1,189 @@
+/* Stream Client
+
+   For the tests that run the whole firmware in-process, as fg_bench.c
+   does, and read its stream over loopback: start-up, connecting, and
+   reading binary frames with their header, CRC and payload checked.
+
+   The host configuration captures in the counter format, so every sample
+   is its channel's running edge count and a stream with nothing missing
+   counts up by one.
+*/
+#ifndef STREAM_CLIENT_H
+#define STREAM_CLIENT_H
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sample_pool.h"
+#include "wire_format.h"
+#include "delta_codec.h"
+#include "lz4_block.h"
+
+#define STREAM_READ_TIMEOUT_US 5000000
+
+void app_main(void);
+
+static inline void stream_start_firmware(void)
+{
+    esp_log_level_set("*", ESP_LOG_WARN);
+    // lwIP reports a connection closed under a send as an error, not a signal.
+    signal(SIGPIPE, SIG_IGN);
+    // Builds the CRC table before the tasks can race to.
+    wire_crc32(0, NULL, 0);
+    app_main();
+}
+
+// One attempt to connect to the stream server: the socket, or -1. A
+// 'receiveBuffer' other than 0 sets the socket's receive buffer, so a client
+// that reads slowly falls behind the server rather than its own kernel.
+static inline int stream_connect_once(int receiveBuffer)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_STREAM_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 100000 };
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    
+    if (receiveBuffer > 0)
+    {
+        setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    }
+    if (connect(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0)
+    {
+        close(sock);
+        return -1;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return sock;
+}
+
+// Connects with stream_connect_once(), retrying for up to 'timeoutUs', and
+// sends 'handshake' unless it is 0. The socket, or -1.
+static inline int stream_connect(char handshake, int receiveBuffer, int64_t timeoutUs)
+{
+    int64_t deadline = esp_timer_get_time() + timeoutUs;
+    int sock;
+    
+    while ((sock = stream_connect_once(receiveBuffer)) < 0 && esp_timer_get_time() < deadline)
+    {
+        usleep(50000);
+    }
+    if (sock >= 0 && handshake != 0)
+    {
+        send(sock, &handshake, 1, 0);
+    }
+    return sock;
+}
+
+// Drops the connection at once, with a reset rather than a FIN, as a
+// client that crashed or lost its link would.
+static inline void stream_abort(int sock)
+{
+    struct linger linger = { .l_onoff = 1, .l_linger = 0 };
+    
+    setsockopt(sock, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    close(sock);
+}
+
+// Reads exactly 'len' bytes. False if the connection closed or nothing
+// came for STREAM_READ_TIMEOUT_US.
+static inline bool stream_read_full(int sock, void *buf, size_t len)
+{
+    int64_t deadline = esp_timer_get_time() + STREAM_READ_TIMEOUT_US;
+    size_t got = 0;
+    
+    while (got < len)
+    {
+        ssize_t n = recv(sock, (char *) buf + got, len - got, 0);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            return false;
+        }
+        if (n > 0)
+        {
+            got += n;
+            deadline = esp_timer_get_time() + STREAM_READ_TIMEOUT_US;
+        }
+        else if (esp_timer_get_time() > deadline)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Reads one frame into 'header' and, for a block of counts, its samples.
+// False if the connection closed or the frame is corrupt; a CRC failure
+// or a bad header also sets '*corrupt'. Clients on different threads may
+// read at once.
+static inline bool stream_read_frame(int sock, wire_header_t *header, int32_t *samples, bool *corrupt)
+{
+    static _Thread_local uint8_t payload[LZ4_BLOCK_MAX_SIZE(DELTA_VARINT_MAX_SIZE(SAMPLE_BLOCK_SIZE)) + 1024];
+    static _Thread_local uint8_t decompressed[DELTA_VARINT_MAX_SIZE(SAMPLE_BLOCK_SIZE)];
+    
+    *corrupt = false;
+    if (!stream_read_full(sock, header, sizeof(*header)))
+    {
+        return false;
+    }
+    if (!wire_header_valid(header) || header->payload_size > sizeof(payload))
+    {
+        *corrupt = true;
+        return false;
+    }
+    if (!stream_read_full(sock, payload, header->payload_size))
+    {
+        return false;
+    }
+    if (wire_crc32(0, payload, header->payload_size) != header->crc32)
+    {
+        *corrupt = true;
+        return false;
+    }
+    if (header->flags & (WIRE_FLAG_STATS | WIRE_FLAG_TRACE | WIRE_FLAG_EDGE_TIME | WIRE_FLAG_SUMMARY))
+    {
+        return true;
+    }
+    
+    const uint8_t *data = payload;
+    size_t size = header->payload_size;
+    if (header->flags & WIRE_FLAG_LZ4)
+    {
+        size = lz4_block_decompress(payload, size, decompressed, sizeof(decompressed));
+        data = decompressed;
+    }
+    if (header->count > SAMPLE_BLOCK_SIZE)
+    {
+        *corrupt = true;
+        return false;
+    }
+    if (header->encoding == WIRE_ENCODING_DELTA_VARINT)
+    {
+        if (delta_varint_decode(data, size, samples, header->count) == 0)
+        {
+            *corrupt = true;
+            return false;
+        }
+    }
+    else if (size == header->count * sizeof(int32_t))
+    {
+        memcpy(samples, data, size);
+    }
+    else
+    {
+        *corrupt = true;
+        return false;
+    }
+    return true;
+}
+
+#endif // STREAM_CLIENT_H
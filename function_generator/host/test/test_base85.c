@@ -0,0 +1,243 @@
+/* Base-85 Encoder Test
+
+   Checks the mulshift and lut2 kernels byte for byte against the
+   reference loop: over a dense range around zero, a stride through all
+   of int32, both sides of every power of 85 and multiple of 85^2 that
+   the multiply-shift divisions could get wrong, the extremes, and random
+   samples, and then over every 32 bit word. Also checks that zero is five '!' (there is no 'z'
+   shorthand) and that every block size writes exactly five characters a
+   sample and nothing beyond them.
+*/
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "base85.h"
+#include "check.h"
+
+#define BLOCK 1024
+#define GUARD 0x7F
+#define KERNELS 3
+#define MAX_SWEEPS 64
+
+typedef size_t (*encoder_t)(const int32_t *samples, size_t count, char *out);
+
+static const encoder_t kernels[KERNELS] =
+{
+    base85_encode_block_reference,
+    base85_encode_block_mulshift,
+    base85_encode_block_lut2,
+};
+static const char *const kernelNames[KERNELS] = {"reference", "mulshift", "lut2"};
+
+static char out[KERNELS][BLOCK * BASE85_CHARS_PER_SAMPLE + 8];
+
+// Encodes 'samples' with every kernel and compares each with the
+// reference.
+static void check_block(const int32_t *samples, size_t count)
+{
+    size_t size = count * BASE85_CHARS_PER_SAMPLE;
+    
+    for (int k = 0; k < KERNELS; k++)
+    {
+        memset(out[k], GUARD, sizeof(out[k]));
+        CHECK_EQ(kernels[k](samples, count, out[k]), size);
+        for (size_t i = size; i < sizeof(out[k]); i++)
+        {
+            CHECK_EQ(out[k][i], GUARD);
+        }
+    }
+    for (int k = 1; k < KERNELS; k++)
+    {
+        if (memcmp(out[k], out[0], size) != 0)
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                if (out[k][i] != out[0][i])
+                {
+                    fprintf(stderr, "%s differs for sample %d\n", kernelNames[k],
+                            samples[i / BASE85_CHARS_PER_SAMPLE]);
+                    break;
+                }
+            }
+            checkFailures++;
+        }
+    }
+}
+
+static void test_known(void)
+{
+    static const int32_t samples[] = {0, 1, 84, 85, -1, -85};
+    
+    check_block(samples, 6);
+    CHECK(memcmp(out[2], "!!!!!" "\"!!!!" "u!!!!" "!\"!!!" " !!!!" "! !!!", 30) == 0);
+    // The extremes, as the reference loop gives them. INT32_MIN, like any
+    // negative sample, leaves the printable range.
+    check_block((const int32_t[]) {INT32_MAX, INT32_MIN}, 2);
+    CHECK(memcmp(out[2], "KQf,J", 5) == 0);
+    CHECK(memcmp(out[2] + 5, "\xf6\xf1\xdc\x16\xf8", 5) == 0);
+}
+
+static void test_counts(void)
+{
+    int32_t samples[64];
+    
+    for (size_t i = 0; i < 64; i++)
+    {
+        samples[i] = (int32_t) check_random();
+    }
+    // Zero, odd and short counts, and every count up to a few lines.
+    for (size_t count = 0; count <= 64; count++)
+    {
+        check_block(samples, count);
+    }
+    memset(samples, 0, sizeof(samples));
+    check_block(samples, 7);
+    for (size_t i = 0; i < 7 * BASE85_CHARS_PER_SAMPLE; i++)
+    {
+        CHECK_EQ(out[2][i], '!');
+    }
+    CHECK(memchr(out[2], 'z', sizeof(out[2])) == NULL);
+}
+
+static void test_boundaries(void)
+{
+    int32_t samples[BLOCK];
+    size_t count = 0;
+    
+    // Either side of each power of 85 and of multiples of 85^2, where a
+    // digit rolls over, in both signs.
+    for (int64_t power = 85; power <= INT32_MAX; power *= 85)
+    {
+        for (int64_t multiple = power; multiple <= INT32_MAX && multiple < 85 * power; multiple += power)
+        {
+            for (int delta = -1; delta <= 1; delta++)
+            {
+                samples[count++] = (int32_t) (multiple + delta);
+                samples[count++] = (int32_t) -(multiple + delta);
+                if (count == BLOCK)
+                {
+                    check_block(samples, count);
+                    count = 0;
+                }
+            }
+        }
+    }
+    static const int32_t extremes[] = {INT32_MIN, INT32_MIN + 1, INT32_MAX, INT32_MAX - 1, -1, 0, 1};
+    memcpy(samples + count, extremes, sizeof(extremes));
+    count += sizeof(extremes) / sizeof(extremes[0]);
+    check_block(samples, count);
+}
+
+static void test_ranges(void)
+{
+    int32_t samples[BLOCK];
+    
+    // Every value within 2^20 of zero.
+    for (int32_t first = -(1 << 20); first < (1 << 20); first += BLOCK)
+    {
+        for (int i = 0; i < BLOCK; i++)
+        {
+            samples[i] = first + i;
+        }
+        check_block(samples, BLOCK);
+    }
+    
+    // A stride through the whole range, landing on a different remainder
+    // of 85 and 85^2 each time.
+    uint32_t value = 0;
+    for (int round = 0; round < 1024; round++)
+    {
+        for (int i = 0; i < BLOCK; i++)
+        {
+            samples[i] = (int32_t) value;
+            value += 4093;
+        }
+        check_block(samples, BLOCK);
+    }
+    
+    for (int round = 0; round < 1024; round++)
+    {
+        for (int i = 0; i < BLOCK; i++)
+        {
+            samples[i] = (int32_t) check_random();
+        }
+        check_block(samples, BLOCK);
+    }
+}
+
+// Compares the kernels on every 32 bit word in [first, end), a block at a
+// time. Returns the number of samples that differ.
+static void *sweep(void *arg)
+{
+    const uint64_t *range = arg;
+    static _Thread_local char sweepOut[KERNELS][BLOCK * BASE85_CHARS_PER_SAMPLE];
+    int32_t samples[BLOCK];
+    uintptr_t mismatches = 0;
+    
+    for (uint64_t first = range[0]; first < range[1]; first += BLOCK)
+    {
+        for (int i = 0; i < BLOCK; i++)
+        {
+            samples[i] = (int32_t) (uint32_t) (first + i);
+        }
+        for (int k = 0; k < KERNELS; k++)
+        {
+            kernels[k](samples, BLOCK, sweepOut[k]);
+        }
+        for (int k = 1; k < KERNELS; k++)
+        {
+            if (memcmp(sweepOut[k], sweepOut[0], sizeof(sweepOut[0])) == 0)
+            {
+                continue;
+            }
+            for (int i = 0; i < BLOCK; i++)
+            {
+                size_t at = i * BASE85_CHARS_PER_SAMPLE;
+                if (memcmp(sweepOut[k] + at, sweepOut[0] + at, BASE85_CHARS_PER_SAMPLE) != 0 &&
+                    mismatches++ < 10)
+                {
+                    fprintf(stderr, "%s differs for sample %d\n", kernelNames[k], samples[i]);
+                }
+            }
+        }
+    }
+    return (void *) mismatches;
+}
+
+// Every 32 bit word, shared out between a thread per CPU.
+static void test_exhaustive(void)
+{
+    pthread_t threads[MAX_SWEEPS];
+    uint64_t ranges[MAX_SWEEPS][2];
+    long sweeps = sysconf(_SC_NPROCESSORS_ONLN);
+    
+    if (sweeps < 1 || sweeps > MAX_SWEEPS)
+    {
+        sweeps = sweeps < 1 ? 1 : MAX_SWEEPS;
+    }
+    for (long t = 0; t < sweeps; t++)
+    {
+        // Whole blocks per thread; 2^32 is a multiple of BLOCK.
+        ranges[t][0] = (0x100000000ull / BLOCK) * t / sweeps * BLOCK;
+        ranges[t][1] = (0x100000000ull / BLOCK) * (t + 1) / sweeps * BLOCK;
+        pthread_create(&threads[t], NULL, sweep, ranges[t]);
+    }
+    for (long t = 0; t < sweeps; t++)
+    {
+        void *mismatches;
+        pthread_join(threads[t], &mismatches);
+        CHECK_EQ((uintptr_t) mismatches, 0);
+    }
+}
+
+int main(void)
+{
+    base85_init();
+    test_known();
+    test_counts();
+    test_boundaries();
+    test_ranges();
+    test_exhaustive();
+    return check_exit("base85");
+}
@@ -0,0 +1,163 @@
+/* PCNT Capture Test
+
+   Drives the pulse counter shim through wraps of its 16 bit count and
+   checks that the backend's 64 bit totals stay exact whichever way the
+   overflow interrupt lands: at once, only after the read that sees the
+   wrapped count (the drop-then-add-H_LIM path), or between the read of
+   the overflow count and the counter (the retry-until-stable loop).
+   edges() must agree with read() while an interrupt is pending, and the
+   samples must carry on past 2^31 and 2^32 edges as the low 32 bits of the
+   total.
+*/
+#include <stdbool.h>
+
+#include "capture.h"
+#include "host.h"
+#include "check.h"
+
+#define H_LIM 32767
+
+static uint64_t expected[CAPTURE_CHANNELS];
+
+static void count(int unit, uint32_t edges, bool defer)
+{
+    host_pcnt_count(unit, edges, defer);
+    expected[unit] += edges;
+}
+
+static void check_read(int unit)
+{
+    int32_t sample = -1;
+    
+    CHECK_EQ(capture_pcnt_backend.read(unit, &sample, 1), 1);
+    CHECK_EQ(sample, (int32_t) expected[unit]);
+}
+
+static void test_immediate(void)
+{
+    check_read(0);
+    count(0, 1000, false);
+    check_read(0);
+    // Several wraps between reads are fine while each one is serviced.
+    count(0, 5 * H_LIM + 123, false);
+    check_read(0);
+    CHECK_EQ(capture_pcnt_backend.edges(0), (uint32_t) expected[0]);
+    // Reading nothing leaves the state alone.
+    CHECK_EQ(capture_pcnt_backend.read(0, NULL, 0), 0);
+    check_read(0);
+}
+
+static void test_late_interrupt(void)
+{
+    // Bring the counter near its limit, then wrap it with the interrupt
+    // still pending, so the read sees the count fall.
+    count(0, H_LIM - 100 - expected[0] % H_LIM, false);
+    check_read(0);
+    count(0, 300, true);
+    CHECK_EQ(capture_pcnt_backend.edges(0), (uint32_t) expected[0]);
+    check_read(0);
+    check_read(0);
+    CHECK_EQ(capture_pcnt_backend.edges(0), (uint32_t) expected[0]);
+    // Servicing it must not count the wrap twice.
+    host_pcnt_interrupt(0);
+    check_read(0);
+    count(0, 50, false);
+    check_read(0);
+}
+
+static void test_interrupt_in_read(void)
+{
+    // Wrap to a count above the last one read, which only the retry can
+    // tell from no wrap at all.
+    count(0, 10 - expected[0] % H_LIM + H_LIM, false);
+    check_read(0);
+    count(0, H_LIM + 50, true);
+    host_pcnt_interrupt_in_read(0);
+    check_read(0);
+    check_read(0);
+}
+
+static void test_units_independent(void)
+{
+    count(1, 3 * H_LIM + 7, false);
+    check_read(1);
+    check_read(0);
+    count(0, 99, true);
+    check_read(1);
+    check_read(0);
+    host_pcnt_interrupt(0);
+    check_read(0);
+}
+
+static void test_32_bit_wrap(void)
+{
+    int32_t last;
+    uint64_t lastExpected = expected[1];
+    
+    CHECK_EQ(capture_pcnt_backend.read(1, &last, 1), 1);
+    // Past 2^31, where samples go negative, and on past 2^32. Each step
+    // counts several serviced wraps, then one left pending for the read,
+    // to a count below the last one read.
+    while (expected[1] < (1ull << 32) + 10 * H_LIM && checkFailures == 0)
+    {
+        int32_t sample;
+        count(1, 4 * H_LIM + check_random() % H_LIM, false);
+        check_read(1);
+        count(1, H_LIM - 1, true);
+        CHECK_EQ(capture_pcnt_backend.edges(1), (uint32_t) expected[1]);
+        CHECK_EQ(capture_pcnt_backend.read(1, &sample, 1), 1);
+        CHECK_EQ(sample, (int32_t) (uint32_t) expected[1]);
+        // What a client takes from two samples.
+        CHECK_EQ((uint32_t) sample - (uint32_t) last, expected[1] - lastExpected);
+        last = sample;
+        lastExpected = expected[1];
+        host_pcnt_interrupt(1);
+    }
+    check_read(1);
+    printf("32 bit wrap: %llu edges counted\n", (unsigned long long) expected[1]);
+}
+
+static void test_random(void)
+{
+    // Anything goes while each wrap is serviced before the next and fewer
+    // than H_LIM edges pass between reads.
+    for (int i = 0; i < 100000; i++)
+    {
+        uint32_t edges = check_random() % H_LIM;
+        switch (check_random() % 3)
+        {
+            case 0:
+                count(0, edges, false);
+                check_read(0);
+                break;
+            case 1:
+                count(0, edges, true);
+                check_read(0);
+                host_pcnt_interrupt(0);
+                break;
+            case 2:
+                count(0, edges, true);
+                host_pcnt_interrupt_in_read(0);
+                check_read(0);
+                break;
+        }
+        if (checkFailures > 0)
+        {
+            break;
+        }
+    }
+    check_read(0);
+    printf("Random: %llu edges counted\n", (unsigned long long) expected[0]);
+}
+
+int main(void)
+{
+    capture_pcnt_backend.init();
+    test_immediate();
+    test_late_interrupt();
+    test_interrupt_in_read();
+    test_units_independent();
+    test_32_bit_wrap();
+    test_random();
+    return check_exit("capture pcnt");
+}
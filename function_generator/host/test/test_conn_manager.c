@@ -0,0 +1,115 @@
+/* Connection Manager Test
+
+   Runs the firmware in-process and takes its WiFi access point away and
+   brings it back (host_wifi_set_up()) while a client streams over
+   loopback. Each time, the client must be disconnected, the listener
+   closed and the manager left waiting for WiFi; once the access point is
+   back its retries must reopen the listener, a client that reconnects
+   must be streamed to again, and the time with nobody receiving must
+   cover the outage.
+*/
+#include "conn_manager.h"
+#include "capture.h"
+#include "host.h"
+#include "stream_client.h"
+#include "check.h"
+
+#define CYCLES 2
+#define OUTAGE_US 500000
+
+static int32_t samples[SAMPLE_BLOCK_SIZE];
+
+static bool wait_state(conn_state_t state, int64_t timeoutUs)
+{
+    int64_t deadline = esp_timer_get_time() + timeoutUs;
+    
+    while (conn_manager_state() != state)
+    {
+        if (esp_timer_get_time() > deadline)
+        {
+            return false;
+        }
+        usleep(10000);
+    }
+    return true;
+}
+
+// Connects and reads a block, leaving the manager streaming.
+static int stream(void)
+{
+    wire_header_t header;
+    bool corrupt;
+    int sock = stream_connect(WIRE_HANDSHAKE_BINARY, 0, 1000000);
+    
+    CHECK(sock >= 0);
+    if (sock < 0)
+    {
+        return -1;
+    }
+    CHECK(stream_read_frame(sock, &header, samples, &corrupt));
+    CHECK(!corrupt);
+    CHECK(wait_state(CONN_STREAMING, 1000000));
+    return sock;
+}
+
+static void test_outage(void)
+{
+    int sock = stream();
+    if (sock < 0)
+    {
+        return;
+    }
+    int64_t unreceived = conn_manager_unreceived_time();
+    int64_t down = esp_timer_get_time();
+    
+    host_wifi_set_up(false);
+    CHECK(wait_state(CONN_WAIT_WIFI, 1000000));
+    
+    // The client is closed rather than left hanging, after at most what
+    // was already on its way.
+    wire_header_t header;
+    bool corrupt;
+    while (stream_read_frame(sock, &header, samples, &corrupt))
+    {
+    }
+    CHECK(!corrupt);
+    CHECK(esp_timer_get_time() - down < STREAM_READ_TIMEOUT_US);
+    close(sock);
+    
+    // Nothing listens until WiFi is back, and the firmware's retries
+    // bring it back by themselves.
+    usleep(OUTAGE_US);
+    CHECK(conn_manager_state() == CONN_WAIT_WIFI);
+    sock = stream_connect_once(0);
+    CHECK(sock < 0);
+    if (sock >= 0)
+    {
+        close(sock);
+    }
+    host_wifi_set_up(true);
+    CHECK(wait_state(CONN_LISTENING, CONFIG_WIFI_RECONNECT_INTERVAL_MS * 1000LL + 1000000));
+    
+    sock = stream();
+    int64_t outage = esp_timer_get_time() - down;
+    CHECK(conn_manager_unreceived_time() - unreceived >= OUTAGE_US);
+    CHECK(conn_manager_unreceived_time() - unreceived <= outage);
+    printf("Outage: streaming again after %lld ms\n", (long long) outage / 1000);
+    if (sock >= 0)
+    {
+        close(sock);
+    }
+    CHECK(wait_state(CONN_LISTENING, 1000000));
+}
+
+int main(void)
+{
+    stream_start_firmware();
+    // Two blocks a second on channel 0, which counts both edges.
+    host_gpio_generate(capture_channels[0].gpio, SAMPLE_BLOCK_SIZE);
+    CHECK(wait_state(CONN_LISTENING, 2000000));
+    for (int i = 0; i < CYCLES && checkFailures == 0; i++)
+    {
+        test_outage();
+    }
+    return check_exit("conn manager");
+}
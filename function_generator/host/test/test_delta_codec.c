@@ -0,0 +1,219 @@
+/* Delta Codec Test
+
+   Round trips hand-picked and random sample blocks through the zigzag
+   delta varint coding, including the int32 extremes and deltas that
+   alternate in sign, checks a few encodings byte for byte, and holds the
+   encoder to its capacity and the decoder to truncated, malformed and
+   random input.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "delta_codec.h"
+#include "check.h"
+
+#define MAX_COUNT 512
+#define GUARD 0xA5
+
+static uint8_t encoded[DELTA_VARINT_MAX_SIZE(MAX_COUNT) + 16];
+static int32_t decoded[MAX_COUNT + 1];
+
+// Encodes and decodes 'samples', returning the encoded size.
+static size_t round_trip(const int32_t *samples, size_t count)
+{
+    memset(encoded, GUARD, sizeof(encoded));
+    size_t size = delta_varint_encode(samples, count, encoded, DELTA_VARINT_MAX_SIZE(count));
+    CHECK(count == 0 || size > 0);
+    CHECK(size <= DELTA_VARINT_MAX_SIZE(count));
+    CHECK_EQ(encoded[size], GUARD);
+    
+    decoded[count] = 0x5EED;
+    CHECK_EQ(delta_varint_decode(encoded, size, decoded, count), size);
+    CHECK(memcmp(decoded, samples, count * sizeof(int32_t)) == 0);
+    CHECK_EQ(decoded[count], 0x5EED);
+    return size;
+}
+
+static void check_encoding(const int32_t *samples, size_t count, const uint8_t *expected, size_t size)
+{
+    CHECK_EQ(round_trip(samples, count), size);
+    CHECK(memcmp(encoded, expected, size) == 0);
+}
+
+static void test_encodings(void)
+{
+    check_encoding((const int32_t[]) {0, 1, 2, 3}, 4, (const uint8_t[]) {0x00, 0x02, 0x02, 0x02}, 4);
+    check_encoding((const int32_t[]) {-1, -2, 0}, 3, (const uint8_t[]) {0x01, 0x01, 0x04}, 3);
+    check_encoding((const int32_t[]) {63, 64}, 2, (const uint8_t[]) {0x7E, 0x02}, 2);
+    check_encoding((const int32_t[]) {64}, 1, (const uint8_t[]) {0x80, 0x01}, 2);
+    check_encoding((const int32_t[]) {-64, -129}, 2, (const uint8_t[]) {0x7F, 0x81, 0x01}, 3);
+    check_encoding((const int32_t[]) {INT32_MAX}, 1, (const uint8_t[]) {0xFE, 0xFF, 0xFF, 0xFF, 0x0F}, 5);
+    check_encoding((const int32_t[]) {INT32_MIN}, 1, (const uint8_t[]) {0xFF, 0xFF, 0xFF, 0xFF, 0x0F}, 5);
+    // The difference wraps: INT32_MIN follows INT32_MAX in one step.
+    check_encoding((const int32_t[]) {INT32_MAX, INT32_MIN}, 2,
+                   (const uint8_t[]) {0xFE, 0xFF, 0xFF, 0xFF, 0x0F, 0x02}, 6);
+    CHECK_EQ(delta_varint_encode(NULL, 0, encoded, 0), 0);
+    CHECK_EQ(delta_varint_decode(encoded, 0, decoded, 0), 0);
+}
+
+static void test_extremes(void)
+{
+    static const int32_t values[] = {0, 1, -1, INT32_MAX, INT32_MIN, INT32_MAX - 1, INT32_MIN + 1,
+                                     63, 64, -64, -65, 8191, 8192, -8192, -8193};
+    const size_t n = sizeof(values) / sizeof(values[0]);
+    int32_t samples[MAX_COUNT];
+    
+    // Every ordered pair, so every delta between extremes is taken both
+    // ways.
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        for (size_t j = 0; j < n; j++)
+        {
+            samples[count++] = values[i];
+            samples[count++] = values[j];
+        }
+    }
+    round_trip(samples, count);
+    
+    // Alternating signs: the largest deltas there are, every sample.
+    for (size_t i = 0; i < MAX_COUNT; i++)
+    {
+        samples[i] = i & 1 ? INT32_MIN : INT32_MAX;
+    }
+    round_trip(samples, MAX_COUNT);
+    for (size_t i = 0; i < MAX_COUNT; i++)
+    {
+        samples[i] = i & 1 ? INT32_MIN : 0;
+    }
+    CHECK_EQ(round_trip(samples, MAX_COUNT), 1 + DELTA_VARINT_MAX_SIZE(MAX_COUNT - 1));
+    for (size_t i = 0; i < MAX_COUNT; i++)
+    {
+        samples[i] = (int32_t) (i & 1 ? -(int32_t) i : (int32_t) i);
+    }
+    round_trip(samples, MAX_COUNT);
+    
+    // A counter codes to one byte a sample.
+    for (size_t i = 0; i < MAX_COUNT; i++)
+    {
+        samples[i] = 1000000 + (int32_t) i;
+    }
+    CHECK_EQ(round_trip(samples, MAX_COUNT), 3 + MAX_COUNT - 1);
+}
+
+static void random_block(int32_t *samples, size_t count)
+{
+    int32_t value = (int32_t) check_random();
+    uint32_t kind = check_random() % 4;
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        switch (kind)
+        {
+            case 0:
+                value = (int32_t) check_random();
+                break;
+            case 1:
+                value += (int32_t) (check_random() % 5) - 2;
+                break;
+            case 2:
+                value = (int32_t) ((uint32_t) value + (check_random() >> (check_random() % 32)));
+                break;
+            default:
+                value = i & 1 ? (int32_t) (check_random() | 0x80000000u) : (int32_t) (check_random() >> 1);
+                break;
+        }
+        samples[i] = value;
+    }
+}
+
+static void test_capacity(void)
+{
+    int32_t samples[64];
+    uint8_t out[DELTA_VARINT_MAX_SIZE(64) + 1];
+    
+    for (int round = 0; round < 200; round++)
+    {
+        size_t count = 1 + check_random() % 64;
+        random_block(samples, count);
+        size_t size = round_trip(samples, count);
+    
+        // Any less room fails, and nothing is written beyond it.
+        for (size_t capacity = 0; capacity < size; capacity++)
+        {
+            memset(out, GUARD, sizeof(out));
+            CHECK_EQ(delta_varint_encode(samples, count, out, capacity), 0);
+            CHECK_EQ(out[capacity], GUARD);
+        }
+        CHECK_EQ(delta_varint_encode(samples, count, out, size), size);
+        CHECK(memcmp(out, encoded, size) == 0);
+    
+        // So does any truncation of the input; extra input is left alone.
+        for (size_t len = 0; len < size; len++)
+        {
+            CHECK_EQ(delta_varint_decode(encoded, len, decoded, count), 0);
+        }
+        CHECK_EQ(delta_varint_decode(encoded, size + 7, decoded, count), size);
+    }
+}
+
+static void test_malformed(void)
+{
+    // Six bytes of varint cannot be a 32 bit value.
+    static const uint8_t overlong[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x00};
+    // Nor can a fifth byte with more than its low 4 bits set.
+    static const uint8_t wide[][5] = {
+        {0xFF, 0xFF, 0xFF, 0xFF, 0x1F},
+        {0x80, 0x80, 0x80, 0x80, 0x70},
+        {0x81, 0x80, 0x80, 0x80, 0x40},
+    };
+    static const uint8_t widest[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x0F};
+    // The final byte of a varint never has its top bit set.
+    static const uint8_t unterminated[] = {0x02, 0x80, 0x81};
+    
+    CHECK_EQ(delta_varint_decode(overlong, sizeof(overlong), decoded, 1), 0);
+    CHECK_EQ(delta_varint_decode(overlong + 1, 5, decoded, 1), 5);
+    for (size_t i = 0; i < sizeof(wide) / sizeof(wide[0]); i++)
+    {
+        CHECK_EQ(delta_varint_decode(wide[i], sizeof(wide[i]), decoded, 1), 0);
+    }
+    CHECK_EQ(delta_varint_decode(widest, sizeof(widest), decoded, 1), 5);
+    CHECK_EQ(decoded[0], INT32_MIN);
+    CHECK_EQ(delta_varint_decode(unterminated, sizeof(unterminated), decoded, 2), 0);
+    CHECK_EQ(delta_varint_decode(unterminated, sizeof(unterminated), decoded, 1), 1);
+}
+
+static void test_fuzz(void)
+{
+    int32_t samples[MAX_COUNT];
+    
+    for (int round = 0; round < 20000; round++)
+    {
+        size_t count = check_random() % (MAX_COUNT + 1);
+        random_block(samples, count);
+        round_trip(samples, count);
+    }
+    
+    // Random input decodes or not, but never reads past its end.
+    for (int round = 0; round < 20000; round++)
+    {
+        size_t len = check_random() % 64;
+        uint8_t *in = malloc(len + 1);
+        for (size_t i = 0; i < len; i++)
+        {
+            in[i] = (uint8_t) check_random();
+        }
+        CHECK(delta_varint_decode(in, len, decoded, 1 + check_random() % 16) <= len);
+        free(in);
+    }
+}
+
+int main(void)
+{
+    test_encodings();
+    test_extremes();
+    test_capacity();
+    test_malformed();
+    test_fuzz();
+    return check_exit("delta codec");
+}
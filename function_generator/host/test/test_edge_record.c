@@ -0,0 +1,210 @@
+/* Edge Record Test
+
+   Builds the GPIO backend in the edge-time format, detaches a channel and
+   feeds it synthetic edge trains through capture_gpio_inject(), as the
+   software signal source does:
+
+   - dense bursts, a few cycles to a few microseconds apart
+   - edges 2^30 to 2^32 cycles apart, so CCOUNT wraps between most of them
+     and the ones over 2^31 cycles need gap records
+   - quiet spells of several times 2^32 cycles, carried by
+     capture_gpio_inject_until() and reads of the empty ring
+
+   The records are read as SignalReceiverTask reads them, into blocks
+   anchored at time_base() before each block's first record, but with a
+   random and mostly tiny room per read so the gap records of one interval
+   are split between reads and between blocks. Each block is framed as the
+   stream server frames it and decoded as stream_decode decodes it, and
+   every edge must come back with its level and its exact 64 bit time.
+*/
+#include <string.h>
+
+#include "capture.h"
+#include "delta_codec.h"
+#include "edge_record.h"
+#include "wire_format.h"
+#include "xtensa/core-macros.h"
+#include "check.h"
+
+#define CHANNEL 0
+#define MAX_EDGES 4096
+#define BLOCK_RECORDS 48
+#define BATCH 100           // Edges injected between drains; well inside the ring.
+#define CLOCK_MHZ CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ
+
+static uint64_t times[MAX_EDGES];   // Each edge's time after the first, in cycles.
+static uint8_t levels[MAX_EDGES];
+static int injected = 0;
+static uint32_t firstCcount;
+static uint64_t clockCycles;        // How far the channel's clock has been told to go.
+static uint64_t expectedGaps = 0;
+
+static int32_t block[BLOCK_RECORDS];
+static size_t blockCount = 0;
+static uint64_t blockAnchor;
+static uint32_t blocks = 0;
+static uint64_t gapRecords = 0;
+
+static edge_time_t decoded[MAX_EDGES];
+static size_t decodedCount = 0;
+
+// Frames the block with a delta-varint payload, parses the frame back and
+// decodes its records.
+static void finish_block(void)
+{
+    static uint8_t payload[DELTA_VARINT_MAX_SIZE(BLOCK_RECORDS)];
+    int32_t records[BLOCK_RECORDS];
+    wire_header_t header;
+    
+    if (blockCount == 0)
+    {
+        return;
+    }
+    size_t size = delta_varint_encode(block, blockCount, payload, sizeof(payload));
+    CHECK(size > 0);
+    wire_header_init(&header, WIRE_ENCODING_DELTA_VARINT, WIRE_FLAG_EDGE_TIME, CLOCK_MHZ,
+                     blocks++, blockCount, CHANNEL, blockAnchor, payload, size);
+    
+    CHECK(wire_header_valid(&header));
+    CHECK_EQ(wire_crc32(0, payload, header.payload_size), header.crc32);
+    CHECK_EQ(delta_varint_decode(payload, header.payload_size, records, header.count), size);
+    CHECK(decodedCount + header.count <= MAX_EDGES);
+    if (decodedCount + header.count <= MAX_EDGES)
+    {
+        decodedCount += edge_record_decode(records, header.count, header.timestamp,
+                                           &decoded[decodedCount]);
+    }
+    for (size_t i = 0; i < blockCount; i++)
+    {
+        gapRecords += (block[i] == EDGE_RECORD_GAP);
+    }
+    blockCount = 0;
+}
+
+// Reads the channel until a read gives nothing, a few records at a time.
+static void drain(void)
+{
+    size_t read;
+    
+    do
+    {
+        if (blockCount == BLOCK_RECORDS)
+        {
+            finish_block();
+        }
+        if (blockCount == 0)
+        {
+            blockAnchor = capture_gpio_backend.time_base(CHANNEL);
+        }
+        size_t room = BLOCK_RECORDS - blockCount;
+        size_t max = 1 + check_random() % (check_random() % 4 == 0 ? room : 3);
+        read = capture_gpio_backend.read(CHANNEL, &block[blockCount], max < room ? max : room);
+        CHECK(read <= max);
+        blockCount += read;
+    } while (read > 0);
+}
+
+static void inject(uint64_t after, unsigned level)
+{
+    uint64_t time = injected == 0 ? 0 : times[injected - 1] + after;
+    uint32_t ccount = firstCcount + (uint32_t) time;
+    
+    if (injected > 0)
+    {
+        expectedGaps += after / EDGE_RECORD_DELTA_MAX;
+    }
+    CHECK(injected < MAX_EDGES);
+    CHECK(capture_gpio_inject(CHANNEL, ccount, level));
+    capture_gpio_inject_until(CHANNEL, ccount);
+    times[injected] = time;
+    levels[injected] = level;
+    injected++;
+    clockCycles = time;
+    if (injected % BATCH == 0)
+    {
+        drain();
+    }
+}
+
+static void burst(int edges, uint32_t maxDelta)
+{
+    for (int i = 0; i < edges; i++)
+    {
+        inject(1 + check_random() % maxDelta, injected & 1);
+    }
+}
+
+static void wraps(int edges)
+{
+    // Steps either side of 2^31, where gap records start, and up to just
+    // under 2^32, the most one CCOUNT difference can hold.
+    for (int i = 0; i < edges; i++)
+    {
+        uint64_t after = (1ull << 30) + (uint64_t) check_random() % (3ull << 30);
+        if (i % 8 == 0)
+        {
+            after = EDGE_RECORD_DELTA_MAX - 1 + i % 3;
+        }
+        inject(after, injected & 1);
+        drain();
+    }
+}
+
+// Moves the channel's clock on by 'after' with the ring empty, in steps the
+// reader can follow, and then adds an edge there.
+static void quiet(uint64_t after)
+{
+    uint64_t target = times[injected - 1] + after;
+    
+    drain();
+    while (target - clockCycles > EDGE_RECORD_DELTA_MAX)
+    {
+        clockCycles += EDGE_RECORD_DELTA_MAX - 1 - check_random() % 1000;
+        capture_gpio_inject_until(CHANNEL, firstCcount + (uint32_t) clockCycles);
+        drain();
+    }
+    inject(after, injected & 1);
+    drain();
+}
+
+static void check_edges(void)
+{
+    CHECK_EQ(decodedCount, injected);
+    for (size_t i = 0; i < decodedCount && i < (size_t) injected; i++)
+    {
+        if (decoded[i].cycles - decoded[0].cycles != times[i] || decoded[i].level != levels[i])
+        {
+            fprintf(stderr, "Edge %zu: %llu cycles after the first, level %u; expected %llu, %u\n", i,
+                    (unsigned long long) (decoded[i].cycles - decoded[0].cycles), decoded[i].level,
+                    (unsigned long long) times[i], levels[i]);
+            checkFailures++;
+            break;
+        }
+    }
+    CHECK_EQ(gapRecords, expectedGaps);
+    printf("Edge records: %d edges over %.1f s of cycles, %llu gap records, %u blocks\n", injected,
+           (double) times[injected - 1] / (CLOCK_MHZ * 1e6), (unsigned long long) gapRecords, blocks);
+}
+
+int main(void)
+{
+    capture_gpio_backend.init();
+    CHECK(capture_gpio_detach(CHANNEL));
+    // The first edge is after the reader's clock, as an injected edge must be.
+    firstCcount = XTHAL_GET_CCOUNT() + 1000;
+    
+    burst(500, 50);
+    wraps(40);
+    burst(300, 2000);
+    quiet(5 * (1ull << 32) + 12345);
+    burst(100, 10);
+    wraps(40);
+    quiet(3 * (uint64_t) EDGE_RECORD_DELTA_MAX);
+    quiet(EDGE_RECORD_DELTA_MAX);
+    burst(500, 500);
+    drain();
+    finish_block();
+    
+    check_edges();
+    return check_exit("edge record");
+}
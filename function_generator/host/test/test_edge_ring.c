@@ -0,0 +1,142 @@
+/* Edge Ring Test
+
+   Fills the ring to overrun, reads it across the wrap point and across
+   the 32 bit wrap of its indices, then runs a producer and a consumer
+   thread against each other and checks that every edge arrives once, in
+   order, with every refused push counted as an overrun.
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "edge_ring.h"
+#include "check.h"
+
+#define STRESS_EDGES 5000000u
+
+static edge_ring_t ring;
+static uint32_t refused = 0;
+static volatile bool stop = false;   // The consumer gave up.
+
+// Pops up to 'max' events, checking they continue from 'next'.
+static size_t pop_in_order(uint32_t *next, size_t max)
+{
+    const edge_event_t *span;
+    size_t count = edge_ring_span(&ring, &span);
+    
+    if (count > max)
+    {
+        count = max;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        CHECK_EQ(span[i].ccount, *next);
+        CHECK_EQ(span[i].gpio, *next % 40);
+        CHECK_EQ(span[i].level, *next & 1);
+        (*next)++;
+    }
+    edge_ring_release(&ring, count);
+    return count;
+}
+
+static void test_overrun(void)
+{
+    uint32_t next = 0;
+    
+    memset(&ring, 0, sizeof(ring));
+    for (uint32_t i = 0; i < EDGE_RING_SIZE; i++)
+    {
+        CHECK(edge_ring_push(&ring, i % 40, i & 1, i));
+    }
+    CHECK_EQ(edge_ring_count(&ring), EDGE_RING_SIZE);
+    CHECK(!edge_ring_push(&ring, 0, 0, 0xDEAD));
+    CHECK(!edge_ring_push(&ring, 0, 0, 0xDEAD));
+    CHECK_EQ(ring.overruns, 2);
+    
+    // The refused edges overwrote nothing.
+    CHECK_EQ(pop_in_order(&next, EDGE_RING_SIZE), EDGE_RING_SIZE);
+    CHECK_EQ(edge_ring_count(&ring), 0);
+}
+
+static void test_wrap(uint32_t start)
+{
+    uint32_t next = start;
+    uint32_t pushed = start;
+    
+    memset(&ring, 0, sizeof(ring));
+    ring.head = start;
+    ring.tail = start;
+    
+    // Push and pop in uneven steps so the span meets the wrap point at
+    // every offset.
+    for (int round = 0; round < 4 * EDGE_RING_SIZE; round++)
+    {
+        uint32_t burst = 1 + check_random() % (EDGE_RING_SIZE / 3);
+        for (uint32_t i = 0; i < burst && edge_ring_count(&ring) < EDGE_RING_SIZE; i++)
+        {
+            CHECK(edge_ring_push(&ring, pushed % 40, pushed & 1, pushed));
+            pushed++;
+        }
+        const edge_event_t *span;
+        size_t count = edge_ring_span(&ring, &span);
+        size_t index = ring.tail & (EDGE_RING_SIZE - 1);
+        CHECK(count <= EDGE_RING_SIZE - index);
+        CHECK(count == edge_ring_count(&ring) || index + count == EDGE_RING_SIZE);
+        pop_in_order(&next, 1 + check_random() % EDGE_RING_SIZE);
+    }
+    while (pop_in_order(&next, EDGE_RING_SIZE) > 0)
+    {
+    }
+    CHECK_EQ(next, pushed);
+    CHECK_EQ(ring.overruns, 0);
+}
+
+static void *producer(void *arg)
+{
+    (void) arg;
+    for (uint32_t i = 0; i < STRESS_EDGES && !stop; )
+    {
+        if (edge_ring_push(&ring, i % 40, i & 1, i))
+        {
+            i++;
+        }
+        else
+        {
+            // Let the consumer run, as the ISR would return to the task.
+            refused++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void test_spsc(void)
+{
+    pthread_t thread;
+    uint32_t next = 0;
+    
+    memset(&ring, 0, sizeof(ring));
+    pthread_create(&thread, NULL, producer, NULL);
+    while (next < STRESS_EDGES && checkFailures == 0)
+    {
+        if (pop_in_order(&next, EDGE_RING_SIZE) == 0)
+        {
+            sched_yield();
+        }
+    }
+    stop = true;
+    pthread_join(thread, NULL);
+    CHECK_EQ(next, STRESS_EDGES);
+    CHECK_EQ(ring.overruns, refused);
+    printf("SPSC: %u edges in order, %u overruns\n", next, ring.overruns);
+}
+
+int main(void)
+{
+    test_overrun();
+    test_wrap(0);
+    test_wrap(UINT32_MAX - EDGE_RING_SIZE / 2);
+    test_spsc();
+    return check_exit("edge ring");
+}
@@ -0,0 +1,241 @@
+/* Edge Statistics Test
+
+   Feeds synthetic rising edges through the windowed statistics: a steady
+   signal, one with dropped pulses, one that goes quiet for several
+   windows and comes back, one whose period is longer than a window, with the windows closed both by the edges
+   themselves and by edge_stats_close() polling, and jittered signals
+   whose mean and variance are checked against a two-pass computation.
+*/
+#include <math.h>
+#include <string.h>
+
+#include "edge_stats.h"
+#include "check.h"
+
+#define WINDOW 100000u
+#define PERIOD 1000u
+#define POLL 10000u
+#define MAX_SUMMARIES 64
+
+static edge_stats_t stats;
+static edge_summary_t summaries[MAX_SUMMARIES];
+static int summaryCount;
+static uint64_t lastPoll;
+
+static void start(uint64_t windowStart)
+{
+    edge_stats_init(&stats, 3, WINDOW, windowStart);
+    summaryCount = 0;
+    lastPoll = windowStart;
+}
+
+static void collect(bool produced, const edge_summary_t *summary)
+{
+    if (produced && summaryCount < MAX_SUMMARIES)
+    {
+        summaries[summaryCount++] = *summary;
+    }
+}
+
+// Adds an edge, and with 'poll' first closes any windows ended by the
+// polls since the last edge, as the capture task does.
+static void edge(uint64_t cycles, bool poll)
+{
+    edge_summary_t summary;
+    
+    if (poll)
+    {
+        for (; lastPoll + POLL <= cycles; lastPoll += POLL)
+        {
+            collect(edge_stats_close(&stats, lastPoll + POLL, &summary), &summary);
+        }
+    }
+    collect(edge_stats_add(&stats, cycles, &summary), &summary);
+}
+
+static void check_summary(int index, uint64_t windowStart, uint32_t periods, uint32_t missing)
+{
+    CHECK(index < summaryCount);
+    if (index >= summaryCount)
+    {
+        return;
+    }
+    const edge_summary_t *summary = &summaries[index];
+    CHECK_EQ(summary->start, windowStart);
+    CHECK_EQ(summary->channel, 3);
+    CHECK_EQ(summary->periods, periods);
+    CHECK_EQ(summary->missing, missing);
+    if (periods > 0)
+    {
+        CHECK_EQ(summary->min, PERIOD);
+        CHECK_EQ(summary->max, PERIOD);
+        CHECK_EQ(summary->mean, PERIOD);
+        CHECK_EQ(summary->variance, 0);
+    }
+}
+
+static void test_steady(bool poll)
+{
+    start(0);
+    for (uint64_t t = PERIOD / 2; t < 3 * WINDOW; t += PERIOD)
+    {
+        edge(t, poll);
+    }
+    // The first edge has no period before it.
+    CHECK_EQ(summaryCount, 2);
+    check_summary(0, 0, WINDOW / PERIOD - 1, 0);
+    check_summary(1, WINDOW, WINDOW / PERIOD, 0);
+}
+
+static void test_dropped(bool poll)
+{
+    uint64_t base = 1ull << 40;
+    
+    start(base);
+    for (uint64_t t = PERIOD / 2; t < 4 * WINDOW; t += PERIOD)
+    {
+        // One pulse lost in the third window and a run of three; neither
+        // is a period.
+        uint64_t n = t / PERIOD;
+        if (n == 250 || (n >= 260 && n <= 262))
+        {
+            continue;
+        }
+        edge(base + t, poll);
+    }
+    CHECK_EQ(summaryCount, 3);
+    check_summary(0, base, WINDOW / PERIOD - 1, 0);
+    check_summary(1, base + WINDOW, WINDOW / PERIOD, 0);
+    check_summary(2, base + 2 * WINDOW, WINDOW / PERIOD - 6, 4);
+}
+
+static void test_quiet(bool poll)
+{
+    start(0);
+    // Two windows of signal, then nothing until halfway through the sixth.
+    for (uint64_t t = PERIOD / 2; t < 2 * WINDOW; t += PERIOD)
+    {
+        edge(t, poll);
+    }
+    for (uint64_t t = 5 * WINDOW + WINDOW / 2 + PERIOD / 2; t < 7 * WINDOW; t += PERIOD)
+    {
+        edge(t, poll);
+    }
+    check_summary(0, 0, WINDOW / PERIOD - 1, 0);
+    check_summary(1, WINDOW, WINDOW / PERIOD, 0);
+    int next = 2;
+    if (poll)
+    {
+        // Only the first of the empty windows is reported.
+        check_summary(next++, 2 * WINDOW, 0, 0);
+    }
+    // The gap is not a period but the 350 edges lost in it.
+    check_summary(next++, 5 * WINDOW, WINDOW / PERIOD / 2 - 1, 350);
+    CHECK_EQ(summaryCount, next);
+    
+    // A gap the edges run through without a quiet window is a run of
+    // missing edges, and the edge after it ends no period.
+    for (uint64_t t = 7 * WINDOW + 30 * PERIOD + PERIOD / 2; t < 9 * WINDOW; t += PERIOD)
+    {
+        edge(t, poll);
+    }
+    check_summary(next, 6 * WINDOW, WINDOW / PERIOD, 0);
+    check_summary(next + 1, 7 * WINDOW, WINDOW / PERIOD - 31, 30);
+}
+
+// A signal whose period is two and a half windows, so most windows have
+// one edge in them and some none, with one edge lost.
+static void test_long_period(bool poll)
+{
+    uint64_t base = 1ull << 36;
+    uint32_t periods = 0;
+    uint32_t missing = 0;
+    
+    start(base);
+    for (int n = 0; n <= 12; n++)
+    {
+        if (n != 8)
+        {
+            edge(base + WINDOW / 2 + n * (5 * WINDOW / 2), poll);
+        }
+    }
+    for (int i = 0; i < summaryCount; i++)
+    {
+        periods += summaries[i].periods;
+        missing += summaries[i].missing;
+        if (summaries[i].periods > 0)
+        {
+            CHECK_EQ(summaries[i].min, 5 * WINDOW / 2);
+            CHECK_EQ(summaries[i].max, 5 * WINDOW / 2);
+            CHECK_EQ(summaries[i].mean, 5 * WINDOW / 2);
+        }
+    }
+    // Twelve edges, the one before the last window's not yet closed, and
+    // the double period across the lost edge.
+    CHECK_EQ(periods, 9);
+    CHECK_EQ(missing, 1);
+}
+
+// Jitters a signal of 'period' cycles by up to 'jitter' either way and
+// checks each window's statistics against a two-pass computation.
+static void test_jitter(uint64_t base, uint32_t period, uint32_t jitter, uint64_t window)
+{
+    enum { MAX_PERIODS = 4096 };
+    static double periods[MAX_PERIODS];
+    edge_summary_t summary;
+    uint64_t windowStart = base;
+    uint64_t last = base + period / 2;
+    size_t count = 0;
+    
+    edge_stats_init(&stats, 0, window, base);
+    edge_stats_add(&stats, last, &summary);
+    for (int windows = 0; windows < 8; )
+    {
+        uint64_t t = last + period - jitter + check_random() % (2 * jitter + 1);
+        bool closed = edge_stats_add(&stats, t, &summary);
+        if (closed)
+        {
+            double mean = 0.0;
+            double m2 = 0.0;
+            for (size_t i = 0; i < count; i++)
+            {
+                mean += periods[i];
+            }
+            mean /= count;
+            for (size_t i = 0; i < count; i++)
+            {
+                m2 += (periods[i] - mean) * (periods[i] - mean);
+            }
+            CHECK_EQ(summary.start, windowStart);
+            CHECK_EQ(summary.periods, count);
+            CHECK_EQ(summary.missing, 0);
+            CHECK(fabs(summary.mean - mean) <= mean * 1e-6);
+            CHECK(fabs(summary.variance - m2 / count) <= m2 / count * 1e-4);
+            CHECK(summary.variance > 0);
+            windowStart += window;
+            count = 0;
+            windows++;
+        }
+        if (count < MAX_PERIODS)
+        {
+            periods[count++] = (double) (t - last);
+        }
+        last = t;
+    }
+}
+
+int main(void)
+{
+    for (int poll = 0; poll <= 1; poll++)
+    {
+        test_steady(poll);
+        test_dropped(poll);
+        test_quiet(poll);
+        test_long_period(poll);
+    }
+    test_jitter(0, 1000, 50, 1000000);
+    // Long periods at a late start: the squares of the periods are far
+    // past a float's precision, and their spread a tiny part of them.
+    test_jitter(1ull << 44, 16000000, 10, 400000000);
+    return check_exit("edge stats");
+}
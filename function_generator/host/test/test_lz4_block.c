@@ -0,0 +1,248 @@
+/* LZ4 Block Test
+
+   Round trips incompressible, all-zero, repetitive and delta-coded
+   buffers of every length up to well past MF_LIMIT through the block
+   compressor, with an arena left dirty from buffer to buffer. Each
+   result is walked sequence by sequence to hold it to the block format's
+   end-of-block rules, which other decoders rely on. Then the compressor
+   is held to its capacity and input limit, and the decompressor to
+   truncated, corrupted and random input.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include "lz4_block.h"
+#include "delta_codec.h"
+#include "check.h"
+
+#define MAX_LEN 6000
+#define GUARD 0xA5
+
+// The format's end-of-block rules (see lz4_block.c).
+#define LAST_LITERALS 5
+#define MF_LIMIT 12
+
+static lz4_block_arena_t arena;
+static uint8_t input[LZ4_BLOCK_MAX_INPUT + 1];
+static uint8_t compressed[LZ4_BLOCK_MAX_SIZE(LZ4_BLOCK_MAX_INPUT + 1) + 16];
+static uint8_t output[LZ4_BLOCK_MAX_INPUT + 16];
+
+// Reads a length continued past its token nibble.
+static size_t read_length(const uint8_t **ip, size_t length)
+{
+    if (length == 15)
+    {
+        uint8_t byte;
+        do
+        {
+            byte = *(*ip)++;
+            length += byte;
+        } while (byte == 255);
+    }
+    return length;
+}
+
+// Checks that every match of a well-formed block starts at least MF_LIMIT
+// bytes before the end of the 'len' byte buffer and leaves at least
+// LAST_LITERALS bytes of literals after it.
+static void check_format(const uint8_t *block, size_t size, size_t len)
+{
+    const uint8_t *ip = block;
+    const uint8_t *end = block + size;
+    size_t pos = 0;
+    
+    while (ip < end)
+    {
+        uint8_t token = *ip++;
+        size_t literals = read_length(&ip, token >> 4);
+        ip += literals;
+        pos += literals;
+        if (ip >= end)
+        {
+            break;
+        }
+        ip += 2;
+        size_t length = read_length(&ip, token & 0x0F) + 4;
+        CHECK(pos + MF_LIMIT <= len);
+        CHECK(pos + length + LAST_LITERALS <= len);
+        pos += length;
+    }
+    CHECK(ip == end);
+    CHECK_EQ(pos, len);
+}
+
+// Compresses and decompresses 'len' bytes of 'input', returning the
+// compressed size.
+static size_t round_trip(size_t len)
+{
+    memset(compressed, GUARD, sizeof(compressed));
+    size_t size = lz4_block_compress(input, len, compressed, LZ4_BLOCK_MAX_SIZE(len), &arena);
+    CHECK(size > 0);
+    CHECK(size <= LZ4_BLOCK_MAX_SIZE(len));
+    CHECK_EQ(compressed[size], GUARD);
+    check_format(compressed, size, len);
+    
+    memset(output, GUARD, sizeof(output));
+    CHECK_EQ(lz4_block_decompress(compressed, size, output, len), len);
+    CHECK(memcmp(output, input, len) == 0);
+    CHECK_EQ(output[len], GUARD);
+    return size;
+}
+
+static void fill_random(size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        input[i] = (uint8_t) check_random();
+    }
+}
+
+static void test_short(void)
+{
+    // Below MF_LIMIT nothing may be matched, however repetitive.
+    for (size_t len = 0; len <= 2 * MF_LIMIT; len++)
+    {
+        memset(input, 0, len);
+        size_t size = round_trip(len);
+        if (len <= MF_LIMIT)
+        {
+            CHECK_EQ(size, 1 + len);
+        }
+        fill_random(len);
+        round_trip(len);
+    }
+}
+
+static void test_kinds(void)
+{
+    int32_t samples[MAX_LEN / 4];
+    
+    for (size_t len = 0; len <= MAX_LEN; len += 1 + len / 16)
+    {
+        // Incompressible data costs at most the bound.
+        fill_random(len);
+        round_trip(len);
+    
+        // All zeros is a literal and one long match.
+        memset(input, 0, len);
+        size_t size = round_trip(len);
+        CHECK(size <= len / 255 + 16);
+    
+        // A short repeating pattern, and one with the odd byte changed.
+        for (size_t i = 0; i < len; i++)
+        {
+            input[i] = (uint8_t) (i % 7 * 31);
+        }
+        round_trip(len);
+        for (size_t i = 0; i < len / 50; i++)
+        {
+            input[check_random() % len] = (uint8_t) check_random();
+        }
+        round_trip(len);
+    
+        // Delta-coded counts, what the firmware feeds it.
+        size_t count = len / 4;
+        int32_t value = (int32_t) check_random();
+        for (size_t i = 0; i < count; i++)
+        {
+            value += 1000 + (int32_t) (check_random() % 3);
+            samples[i] = value;
+        }
+        size_t coded = delta_varint_encode(samples, count, input, sizeof(input));
+        round_trip(coded);
+    }
+}
+
+static void test_limits(void)
+{
+    // The largest buffer, one over it, and a dirty arena.
+    for (size_t i = 0; i < sizeof(arena.table) / sizeof(arena.table[0]); i++)
+    {
+        arena.table[i] = (uint16_t) check_random();
+    }
+    fill_random(LZ4_BLOCK_MAX_INPUT + 1);
+    for (size_t i = 0; i < LZ4_BLOCK_MAX_INPUT; i += 1000)
+    {
+        memset(input + i, (int) i, 100);
+    }
+    round_trip(LZ4_BLOCK_MAX_INPUT);
+    CHECK_EQ(lz4_block_compress(input, LZ4_BLOCK_MAX_INPUT + 1, compressed, sizeof(compressed), &arena), 0);
+    
+    // Too little room fails cleanly, in either direction.
+    for (int round = 0; round < 50; round++)
+    {
+        size_t len = check_random() % 2000;
+        fill_random(len);
+        if (round & 1)
+        {
+            memset(input, 'x', len / 2);
+        }
+        size_t size = round_trip(len);
+        uint8_t out[LZ4_BLOCK_MAX_SIZE(2000) + 1];
+        for (size_t capacity = 0; capacity < size; capacity++)
+        {
+            memset(out, GUARD, sizeof(out));
+            CHECK_EQ(lz4_block_compress(input, len, out, capacity, &arena), 0);
+            CHECK_EQ(out[capacity], GUARD);
+        }
+        if (len > 0)
+        {
+            memset(output, GUARD, sizeof(output));
+            CHECK_EQ(lz4_block_decompress(compressed, size, output, len - 1), 0);
+            CHECK_EQ(output[len - 1], GUARD);
+        }
+    }
+}
+
+static void test_malformed(void)
+{
+    // A match before the start of the output, and one with offset 0.
+    static const uint8_t before[] = {0x10, 'a', 0x02, 0x00, 0x00};
+    static const uint8_t zero[] = {0x10, 'a', 0x00, 0x00, 0x00};
+    static const uint8_t overlap[] = {0x10, 'a', 0x01, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f'};
+    
+    CHECK_EQ(lz4_block_decompress(before, sizeof(before), output, 100), 0);
+    CHECK_EQ(lz4_block_decompress(zero, sizeof(zero), output, 100), 0);
+    // An offset of 1 repeats the last byte, here 4 times.
+    CHECK_EQ(lz4_block_decompress(overlap, sizeof(overlap), output, 100), 10);
+    CHECK(memcmp(output, "aaaaabcdef", 10) == 0);
+    
+    // Truncations and corruptions of real blocks fail or come up short,
+    // but never write past the output.
+    for (int round = 0; round < 2000; round++)
+    {
+        size_t len = 1 + check_random() % 500;
+        fill_random(len);
+        memset(input + check_random() % len, 0, len / 2);
+        size_t size = round_trip(len);
+        size_t cut = check_random() % size;
+    
+        memset(output, GUARD, sizeof(output));
+        CHECK(lz4_block_decompress(compressed, cut, output, len) < len);
+        CHECK_EQ(output[len], GUARD);
+        compressed[cut] = (uint8_t) check_random();
+        CHECK(lz4_block_decompress(compressed, size, output, len) <= len);
+        CHECK_EQ(output[len], GUARD);
+    }
+    
+    for (int round = 0; round < 20000; round++)
+    {
+        size_t len = check_random() % 64;
+        uint8_t *in = malloc(len + 1);
+        for (size_t i = 0; i < len; i++)
+        {
+            in[i] = (uint8_t) check_random();
+        }
+        CHECK(lz4_block_decompress(in, len, output, 256) <= 256);
+        free(in);
+    }
+}
+
+int main(void)
+{
+    test_short();
+    test_kinds();
+    test_limits();
+    test_malformed();
+    return check_exit("lz4 block");
+}
@@ -0,0 +1,227 @@
+/* Sample Pool Test
+
+   Runs the pool over the host's FreeRTOS queues: first by hand, to
+   exhaust it and check that drops and shedding cost no block and keep
+   the sequence counting; then with a producer thread against a slow
+   consumer thread, once that simply falls behind and once that applies
+   back-pressure while its sockets are full. Every block either arrives
+   whole and in order or is counted as dropped or shed, and every block
+   finds its way back to the free list.
+*/
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "sample_pool.h"
+#include "check.h"
+
+#define STRESS_BLOCKS 3000
+#define HELD_BLOCKS 3           // Blocks the back-pressuring consumer's sockets hold.
+
+static sample_block_t *current;     // The producer's block.
+static uint32_t submitted = 0;      // Blocks submitted, so the next one's sequence.
+static uint32_t sequenceBase;       // Sequence of the stress run's first block.
+static volatile bool producing;
+static bool applyBackpressure;
+
+// Fills the block so the consumer can tell it was not overwritten.
+static void fill(sample_block_t *block, uint32_t tag)
+{
+    block->count = 1 + tag % SAMPLE_BLOCK_SIZE;
+    block->samples[0] = (int32_t) tag;
+    block->samples[block->count - 1] = (int32_t) tag;
+}
+
+// Submits 'n' blocks from the main thread, returning how many were
+// queued.
+static uint32_t submit(uint32_t n)
+{
+    uint32_t queued = 0;
+    
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t waiting = sample_pool_waiting();
+        fill(current, i);
+        sample_block_t *next = sample_pool_submit(current);
+        CHECK_EQ(current->sequence, submitted++);
+        CHECK_EQ(next->count, 0);
+        if (sample_pool_waiting() > waiting)
+        {
+            CHECK(next != current);
+            queued++;
+        }
+        else
+        {
+            CHECK(next == current);
+        }
+        current = next;
+    }
+    return queued;
+}
+
+// Receives and releases everything waiting, checking the sequence runs on
+// from 'first'. Returns the number received.
+static uint32_t drain(uint32_t first)
+{
+    uint32_t received = 0;
+    sample_block_t *block;
+    
+    while ((block = sample_pool_receive(0)) != NULL)
+    {
+        CHECK_EQ(block->sequence, first + received);
+        CHECK(block != current);
+        sample_pool_release(block);
+        received++;
+    }
+    return received;
+}
+
+static void test_exhaust(void)
+{
+    // The producer holds one block; the rest can all wait for the consumer.
+    uint32_t sequence = submitted;
+    CHECK_EQ(submit(SAMPLE_POOL_TOTAL - 1), SAMPLE_POOL_TOTAL - 1);
+    CHECK_EQ(sample_pool_waiting(), SAMPLE_POOL_TOTAL - 1);
+    
+    // Then the pool is out, and whole blocks are dropped, each using up a
+    // sequence number.
+    CHECK_EQ(submit(5), 0);
+    CHECK_EQ(sample_pool_dropped(), 5);
+    
+    // The consumer sees the blocks in order, then a gap where the dropped
+    // ones were.
+    CHECK_EQ(drain(sequence), SAMPLE_POOL_TOTAL - 1);
+    CHECK_EQ(submit(1), 1);
+    sample_block_t *block = sample_pool_receive(0);
+    CHECK(block != NULL);
+    CHECK_EQ(block->sequence, sequence + SAMPLE_POOL_TOTAL - 1 + 5);
+    sample_pool_release(block);
+}
+
+static void test_shed(void)
+{
+    uint32_t dropped = sample_pool_dropped();
+    
+    // Back-pressure takes nothing from the pool and queues nothing.
+    sample_pool_set_backpressure(true);
+    CHECK_EQ(submit(2 * SAMPLE_POOL_TOTAL), 0);
+    CHECK_EQ(sample_pool_shed(), 2 * SAMPLE_POOL_TOTAL);
+    CHECK_EQ(sample_pool_dropped(), dropped);
+    CHECK_EQ(sample_pool_waiting(), 0);
+    
+    // Released, the whole pool is there again.
+    sample_pool_set_backpressure(false);
+    uint32_t sequence = submitted;
+    CHECK_EQ(submit(SAMPLE_POOL_TOTAL - 1), SAMPLE_POOL_TOTAL - 1);
+    CHECK_EQ(drain(sequence), SAMPLE_POOL_TOTAL - 1);
+}
+
+static void *consumer(void *arg)
+{
+    sample_block_t *held[HELD_BLOCKS];
+    int heldCount = 0;
+    uint32_t *received = arg;
+    int32_t lastIndex = -1;
+    sample_block_t *block;
+    
+    while ((block = sample_pool_receive(pdMS_TO_TICKS(10))) != NULL || producing)
+    {
+        if (block == NULL)
+        {
+            continue;
+        }
+        // Whole, in order, and filled with what it was submitted with.
+        int32_t index = (int32_t) (block->sequence - sequenceBase);
+        CHECK(index > lastIndex);
+        CHECK(index < STRESS_BLOCKS);
+        CHECK_EQ(block->count, 1 + index % SAMPLE_BLOCK_SIZE);
+        CHECK_EQ(block->samples[0], index);
+        CHECK_EQ(block->samples[block->count - 1], index);
+        lastIndex = index;
+        (*received)++;
+    
+        if (!applyBackpressure)
+        {
+            usleep(1000);
+            sample_pool_release(block);
+            continue;
+        }
+        // The sockets hold a few blocks; while they are full the consumer
+        // can take no more, and says so.
+        held[heldCount++] = block;
+        if (heldCount == HELD_BLOCKS)
+        {
+            sample_pool_set_backpressure(true);
+            usleep(1000);
+            sample_pool_release(held[0]);
+            for (int i = 1; i < HELD_BLOCKS; i++)
+            {
+                held[i - 1] = held[i];
+            }
+            heldCount--;
+            sample_pool_set_backpressure(false);
+        }
+    }
+    for (int i = 0; i < heldCount; i++)
+    {
+        sample_pool_release(held[i]);
+    }
+    return NULL;
+}
+
+static void test_slow_consumer(bool backpressure)
+{
+    pthread_t thread;
+    uint32_t received = 0;
+    uint32_t dropped = sample_pool_dropped();
+    uint32_t shed = sample_pool_shed();
+    
+    applyBackpressure = backpressure;
+    producing = true;
+    sequenceBase = submitted;
+    pthread_create(&thread, NULL, consumer, &received);
+    for (uint32_t i = 0; i < STRESS_BLOCKS; i++)
+    {
+        fill(current, i);
+        current = sample_pool_submit(current);
+        submitted++;
+        CHECK_EQ(current->count, 0);
+        // A block every 100 us, ten times what the consumer can take.
+        usleep(100);
+    }
+    producing = false;
+    pthread_join(thread, NULL);
+    
+    dropped = sample_pool_dropped() - dropped;
+    shed = sample_pool_shed() - shed;
+    printf("%s: %u received, %u dropped, %u shed\n", backpressure ? "Back-pressure" : "Slow consumer",
+           received, dropped, shed);
+    CHECK_EQ(received + dropped + shed, STRESS_BLOCKS);
+    CHECK(received > 0);
+    if (backpressure)
+    {
+        CHECK(shed > 0);
+    }
+    else
+    {
+        CHECK(dropped > 0);
+        CHECK_EQ(shed, 0);
+    }
+    
+    // Every block is back in the pool.
+    CHECK_EQ(sample_pool_waiting(), 0);
+    uint32_t sequence = submitted;
+    CHECK_EQ(submit(SAMPLE_POOL_TOTAL - 1), SAMPLE_POOL_TOTAL - 1);
+    CHECK_EQ(drain(sequence), SAMPLE_POOL_TOTAL - 1);
+}
+
+int main(void)
+{
+    sample_pool_init();
+    current = sample_pool_first();
+    test_exhaust();
+    test_shed();
+    test_slow_consumer(false);
+    test_slow_consumer(true);
+    return check_exit("sample pool");
+}
@@ -0,0 +1,227 @@
+/* Short Writes Test
+
+   Runs the firmware in-process with the socket shim's short writes on
+   (host_set_short_writes()): lwIP-sized send buffers, and sends that take
+   a random part of what they are given or refuse it all. Three clients
+   read at once, each from a thread of its own: a binary client that keeps
+   up, a binary client that reads a block now and then, and an Ascii85
+   client.
+
+   Whatever a client is sent must pick up at the byte where the last send
+   stopped. Every binary frame must have a good header and CRC, with
+   sequence numbers rising, and every Ascii85 sample must be whole. The
+   counts in a block run on by one. A client that falls behind is to lose
+   whole blocks, so where its counts jump they jump at a block boundary,
+   by whole blocks, and the slow client must have lost some.
+*/
+#include <pthread.h>
+
+#include "base85.h"
+#include "capture.h"
+#include "host.h"
+#include "stats.h"
+#include "stream_client.h"
+#include "check.h"
+
+#define RUN_US 3000000
+#define FREQUENCY 25000         // Fifteen blocks a second between the two channels.
+#define SLOW_READ_US 400000
+#define SLOW_RECEIVE_BUFFER 8192
+
+typedef struct
+{
+    const char *name;
+    char handshake;
+    int64_t readDelayUs;
+    int receiveBuffer;
+    int32_t samples[SAMPLE_BLOCK_SIZE];
+    bool started[CAPTURE_CHANNELS];
+    int32_t next[CAPTURE_CHANNELS];     // Count the channel's next block should start at.
+    uint32_t samplesRead;
+    uint32_t blocksLost;
+} client_t;
+
+static client_t clients[] = {
+    { .name = "fast binary", .handshake = WIRE_HANDSHAKE_BINARY },
+    { .name = "slow binary", .handshake = WIRE_HANDSHAKE_BINARY, .readDelayUs = SLOW_READ_US,
+      .receiveBuffer = SLOW_RECEIVE_BUFFER },
+    { .name = "Ascii85", .handshake = WIRE_HANDSHAKE_ASCII85 },
+};
+
+#define CLIENTS (sizeof(clients) / sizeof(clients[0]))
+
+static int64_t stopTime;
+
+// Checks that a run of counts starting at 'first' follows on from the
+// channel's last, or from it plus whole blocks.
+static void follow_on(client_t *client, int channel, int32_t first)
+{
+    if (client->started[channel] && first != client->next[channel])
+    {
+        int32_t skipped = first - client->next[channel];
+        CHECK(skipped > 0);
+        CHECK_EQ(skipped % SAMPLE_BLOCK_SIZE, 0);
+        client->blocksLost += skipped / SAMPLE_BLOCK_SIZE;
+    }
+    client->started[channel] = true;
+}
+
+static void read_binary(client_t *client, int sock)
+{
+    wire_header_t header;
+    bool corrupt;
+    bool sequenced = false;
+    uint32_t lastSequence = 0;
+    
+    while (esp_timer_get_time() < stopTime && checkFailures == 0)
+    {
+        bool read = stream_read_frame(sock, &header, client->samples, &corrupt);
+        CHECK(read);
+        CHECK(!corrupt);
+        if (!read)
+        {
+            return;
+        }
+        if (header.flags & (WIRE_FLAG_STATS | WIRE_FLAG_TRACE | WIRE_FLAG_EDGE_TIME | WIRE_FLAG_SUMMARY))
+        {
+            continue;
+        }
+        CHECK(!sequenced || (int32_t) (header.sequence - lastSequence) > 0);
+        sequenced = true;
+        lastSequence = header.sequence;
+    
+        CHECK_EQ(header.count, SAMPLE_BLOCK_SIZE);
+        CHECK(header.channel < CAPTURE_CHANNELS);
+        if (header.count == 0 || header.channel >= CAPTURE_CHANNELS)
+        {
+            return;
+        }
+        for (int i = 1; i < header.count; i++)
+        {
+            CHECK_EQ(client->samples[i], client->samples[i - 1] + 1);
+        }
+        follow_on(client, header.channel, client->samples[0]);
+        client->next[header.channel] = client->samples[header.count - 1] + 1;
+        client->samplesRead += header.count;
+        if (client->readDelayUs > 0)
+        {
+            usleep(client->readDelayUs);
+        }
+    }
+}
+
+// Decodes the Ascii85 stream a sample at a time. It carries channel 0 only,
+// with nothing to mark where a block starts, so a jump in the counts must
+// land on a whole number of blocks from the first count.
+static void read_ascii85(client_t *client, int sock)
+{
+    char text[BASE85_CHARS_PER_SAMPLE * 256];
+    size_t held = 0;
+    int32_t firstCount = 0;
+    
+    while (esp_timer_get_time() < stopTime && checkFailures == 0)
+    {
+        ssize_t received = recv(sock, text + held, sizeof(text) - held, 0);
+        CHECK(received != 0);
+        if (received == 0 || (received < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            return;
+        }
+        if (received < 0)
+        {
+            continue;
+        }
+        held += received;
+    
+        size_t used = 0;
+        for (; used + BASE85_CHARS_PER_SAMPLE <= held; used += BASE85_CHARS_PER_SAMPLE)
+        {
+            uint32_t value = 0;
+            for (int digit = BASE85_CHARS_PER_SAMPLE - 1; digit >= 0; digit--)
+            {
+                CHECK(text[used + digit] >= '!' && text[used + digit] < '!' + 85);
+                value = value * 85 + (uint32_t) (text[used + digit] - '!');
+            }
+            int32_t count = (int32_t) value;
+            if (!client->started[0])
+            {
+                firstCount = count;
+            }
+            else if (count != client->next[0])
+            {
+                CHECK_EQ((count - firstCount) % SAMPLE_BLOCK_SIZE, 0);
+            }
+            follow_on(client, 0, count);
+            client->next[0] = count + 1;
+            client->samplesRead++;
+        }
+        memmove(text, text + used, held - used);
+        held -= used;
+    }
+}
+
+static void *run_client(void *arg)
+{
+    client_t *client = arg;
+    int sock = stream_connect(client->handshake, client->receiveBuffer, 2000000);
+    
+    CHECK(sock >= 0);
+    if (sock < 0)
+    {
+        return NULL;
+    }
+    if (client->handshake == WIRE_HANDSHAKE_BINARY)
+    {
+        read_binary(client, sock);
+    }
+    else
+    {
+        read_ascii85(client, sock);
+    }
+    close(sock);
+    return NULL;
+}
+
+static uint32_t total_counter(stats_counter_t counter)
+{
+    uint32_t total = 0;
+    
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        total += __atomic_load_n(&stats_cores[core].counters[counter], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+int main(void)
+{
+    pthread_t threads[CLIENTS];
+    
+    // Before start-up, so the listener's clients get the small send buffers.
+    host_set_short_writes(true);
+    stream_start_firmware();
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        host_gpio_generate(capture_channels[channel].gpio, FREQUENCY);
+    }
+    
+    stopTime = esp_timer_get_time() + RUN_US;
+    for (size_t i = 0; i < CLIENTS; i++)
+    {
+        pthread_create(&threads[i], NULL, run_client, &clients[i]);
+    }
+    for (size_t i = 0; i < CLIENTS; i++)
+    {
+        pthread_join(threads[i], NULL);
+        CHECK(clients[i].samplesRead >= SAMPLE_BLOCK_SIZE);
+        printf("%s: %u samples, %u blocks lost\n", clients[i].name, clients[i].samplesRead,
+               clients[i].blocksLost);
+    }
+    CHECK(clients[1].blocksLost > 0);
+    CHECK(total_counter(STATS_SHORT_SENDS) > 0);
+    CHECK(total_counter(STATS_SEND_STALLS) > 0);
+    printf("Short sends %u, stalls %u, blocks skipped %u, shed %u, dropped %u\n",
+           total_counter(STATS_SHORT_SENDS), total_counter(STATS_SEND_STALLS),
+           total_counter(STATS_BLOCKS_SKIPPED), sample_pool_shed(), sample_pool_dropped());
+    return check_exit("short writes");
+}
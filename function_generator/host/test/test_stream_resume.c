@@ -0,0 +1,231 @@
+/* Stream Resume Test
+
+   Runs the firmware in-process with both capture channels running, and
+   drops the client at random points in the stream: between frames, part
+   way through a header and part way through a payload, with a reset as a
+   client that crashed would. Each time it reconnects and sends
+   "R<sequence>\n" for the block after the last one it had whole, as
+   stream_decode does.
+
+   Blocks can come again after a resume, and a block published before the
+   resume is handled can come before the ones replayed for it, so every
+   block is recorded by sequence number. At the end every sequence number
+   from the first block to the last must have arrived, a block that came
+   twice must have come with the same counts both times, and each
+   channel's counts must run on from one of its blocks to the next.
+
+   A resume command too long for the server's line buffer must be ignored,
+   not run cut down to the part that fits.
+*/
+#include "capture.h"
+#include "host.h"
+#include "stream_server.h"
+#include "stream_client.h"
+#include "check.h"
+
+#define CYCLES 10
+#define FREQUENCY 10000     // Six blocks a second between the two channels.
+#define MAX_BLOCKS 512
+
+typedef struct
+{
+    bool received;
+    uint16_t channel;
+    int32_t first;
+    int32_t last;
+} record_t;
+
+static int32_t samples[SAMPLE_BLOCK_SIZE];
+static record_t records[MAX_BLOCKS];
+static uint32_t firstSequence;
+static uint32_t lastSequence;       // Newest block received whole.
+static uint32_t repeats = 0;
+
+static bool is_block(const wire_header_t *header)
+{
+    return (header->flags & (WIRE_FLAG_STATS | WIRE_FLAG_TRACE | WIRE_FLAG_EDGE_TIME |
+                             WIRE_FLAG_SUMMARY)) == 0;
+}
+
+static void record(const wire_header_t *header)
+{
+    CHECK_EQ(header->count, SAMPLE_BLOCK_SIZE);
+    CHECK(header->channel < CAPTURE_CHANNELS);
+    CHECK(header->sequence - firstSequence < MAX_BLOCKS);
+    if (header->sequence - firstSequence >= MAX_BLOCKS || header->count == 0)
+    {
+        return;
+    }
+    for (int i = 1; i < header->count; i++)
+    {
+        CHECK_EQ(samples[i], samples[i - 1] + 1);
+    }
+    
+    record_t *entry = &records[header->sequence - firstSequence];
+    if (entry->received)
+    {
+        CHECK_EQ(entry->channel, header->channel);
+        CHECK_EQ(entry->first, samples[0]);
+        CHECK_EQ(entry->last, samples[header->count - 1]);
+        repeats++;
+        return;
+    }
+    entry->received = true;
+    entry->channel = header->channel;
+    entry->first = samples[0];
+    entry->last = samples[header->count - 1];
+    if ((int32_t) (header->sequence - lastSequence) > 0)
+    {
+        lastSequence = header->sequence;
+    }
+}
+
+// Reads 'blocks' blocks whole, recording them. False on a read failure.
+static bool read_blocks(int sock, int blocks)
+{
+    wire_header_t header;
+    bool corrupt;
+    
+    while (blocks > 0)
+    {
+        bool read = stream_read_frame(sock, &header, samples, &corrupt);
+        CHECK(read);
+        CHECK(!corrupt);
+        if (!read)
+        {
+            return false;
+        }
+        if (is_block(&header))
+        {
+            record(&header);
+            blocks--;
+        }
+    }
+    return true;
+}
+
+// Reads part of the next frame and drops the connection there.
+static void abort_stream(int sock)
+{
+    uint8_t partial[sizeof(wire_header_t)];
+    wire_header_t header;
+    
+    switch (check_random() % 3)
+    {
+        case 0:
+            break;
+        case 1:
+            stream_read_full(sock, partial, 1 + check_random() % (sizeof(partial) - 1));
+            break;
+        default:
+            if (stream_read_full(sock, &header, sizeof(header)) && header.payload_size > 1)
+            {
+                static uint8_t payload[DELTA_VARINT_MAX_SIZE(SAMPLE_BLOCK_SIZE) * 2];
+                size_t length = 1 + check_random() % (header.payload_size - 1);
+                stream_read_full(sock, payload, length < sizeof(payload) ? length : sizeof(payload));
+            }
+            break;
+    }
+    stream_abort(sock);
+}
+
+static int resume(void)
+{
+    char command[16];
+    int sock = stream_connect(WIRE_HANDSHAKE_BINARY, 0, 1000000);
+    
+    CHECK(sock >= 0);
+    if (sock >= 0)
+    {
+        int length = snprintf(command, sizeof(command), "R%u\n", lastSequence + 1);
+        send(sock, command, length, 0);
+    }
+    return sock;
+}
+
+// Sends a resume whose first 15 characters, all the server has room for,
+// would replay the newest block again.
+static void test_overlong(int sock)
+{
+    char command[32];
+    uint32_t before = repeats;
+    int length = snprintf(command, sizeof(command), "R%014u5\n", lastSequence);
+    
+    send(sock, command, length, 0);
+    read_blocks(sock, 2 * STREAM_REPLAY_BLOCKS);
+    CHECK_EQ(repeats, before);
+}
+
+static void check_records(void)
+{
+    int32_t next[CAPTURE_CHANNELS];
+    bool started[CAPTURE_CHANNELS] = { false };
+    uint32_t blocks = lastSequence - firstSequence + 1;
+    
+    for (uint32_t i = 0; i < blocks; i++)
+    {
+        CHECK(records[i].received);
+        if (!records[i].received)
+        {
+            printf("Block %u never arrived\n", firstSequence + i);
+            continue;
+        }
+        int channel = records[i].channel;
+        if (started[channel])
+        {
+            CHECK_EQ(records[i].first, next[channel]);
+        }
+        started[channel] = true;
+        next[channel] = records[i].last + 1;
+    }
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        CHECK(started[channel]);
+    }
+    printf("Resume: %u blocks across %d reconnects, %u repeated\n", blocks, CYCLES, repeats);
+}
+
+int main(void)
+{
+    wire_header_t header;
+    bool corrupt;
+    
+    stream_start_firmware();
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        host_gpio_generate(capture_channels[channel].gpio, FREQUENCY);
+    }
+    
+    // The first block sets where the record starts.
+    int sock = stream_connect(WIRE_HANDSHAKE_BINARY, 0, 2000000);
+    CHECK(sock >= 0);
+    do
+    {
+        CHECK(stream_read_frame(sock, &header, samples, &corrupt));
+    } while (checkFailures == 0 && !is_block(&header));
+    firstSequence = header.sequence;
+    lastSequence = header.sequence - 1;
+    if (checkFailures == 0)
+    {
+        record(&header);
+    }
+    
+    for (int i = 0; i < CYCLES && checkFailures == 0; i++)
+    {
+        read_blocks(sock, check_random() % 3);
+        abort_stream(sock);
+        sock = resume();
+    }
+    
+    // Enough to be past every replayed block and see each channel.
+    if (checkFailures == 0)
+    {
+        read_blocks(sock, 2 * STREAM_REPLAY_BLOCKS + 2 * CAPTURE_CHANNELS);
+        test_overlong(sock);
+    }
+    close(sock);
+    check_records();
+    CHECK_EQ(sample_pool_dropped(), 0);
+    CHECK_EQ(sample_pool_shed(), 0);
+    return check_exit("stream resume");
+}
@@ -0,0 +1,229 @@
+/* Telnet COMPRESS2 Test
+
+   Drives libtelnet the way the stream server does for a COMPRESS2 client:
+   an arena from zlib_arena_take() handed over with telnet_set_zlib(),
+   then Ascii85 chunks through telnet_send(). malloc() and its relatives
+   are interposed to check that deflateInit2() takes everything from the
+   arena and nothing from the heap, including when the arena is too small
+   and compression has to be refused. What reaches the "socket" after the
+   COMPRESS2 marker is inflated, unescaped and compared with the text.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "sdkconfig.h"
+#include "libtelnet.h"
+#include "zlib_arena.h"
+#include "base85.h"
+#include "check.h"
+
+#define CHUNK_SAMPLES 287
+#define CHUNKS 400
+#define TEXT_SIZE (CHUNKS * CHUNK_SAMPLES * BASE85_CHARS_PER_SAMPLE)
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *address, size_t size);
+extern void __libc_free(void *address);
+
+static bool counting = false;
+static int heapCalls = 0;           // Allocations while counting.
+static int arenaFrees = 0;          // free() of arena memory, ever.
+static zlib_arena_t *arena;
+
+void *malloc(size_t size)
+{
+    heapCalls += counting;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    heapCalls += counting;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *address, size_t size)
+{
+    heapCalls += counting;
+    return __libc_realloc(address, size);
+}
+
+void free(void *address)
+{
+    if (arena != NULL && (uint8_t *) address >= arena->memory &&
+        (uint8_t *) address < arena->memory + sizeof(arena->memory))
+    {
+        arenaFrees++;
+        return;
+    }
+    __libc_free(address);
+}
+
+static const telnet_telopt_t options[] =
+{
+    {TELNET_TELOPT_COMPRESS2, TELNET_WILL, TELNET_DONT},
+    {-1, 0, 0},
+};
+
+// What libtelnet sends, and what it says.
+typedef struct
+{
+    uint8_t *wire;
+    size_t length;
+    bool compressing;
+    int errors;
+} session_t;
+
+static void event(telnet_t *telnet, telnet_event_t *event, void *userData)
+{
+    session_t *session = userData;
+    
+    (void) telnet;
+    switch (event->type)
+    {
+        case TELNET_EV_SEND:
+            memcpy(session->wire + session->length, event->data.buffer, event->data.size);
+            session->length += event->data.size;
+            break;
+        case TELNET_EV_COMPRESS:
+            session->compressing = event->compress.state != 0;
+            break;
+        case TELNET_EV_WARNING:
+        case TELNET_EV_ERROR:
+            session->errors++;
+            break;
+        default:
+            break;
+    }
+}
+
+static char text[TEXT_SIZE];
+
+// Ascii85 of counts, with some negative samples so there are IACs to
+// escape.
+static void make_text(void)
+{
+    int32_t samples[CHUNK_SAMPLES];
+    char *pos = text;
+    int32_t count = 0;
+    
+    base85_init();
+    for (int chunk = 0; chunk < CHUNKS; chunk++)
+    {
+        for (int i = 0; i < CHUNK_SAMPLES; i++)
+        {
+            count += 1 + (int32_t) (check_random() % 3);
+            samples[i] = (chunk % 5 == 4) ? -(int32_t) (check_random() % 100000) : count;
+        }
+        pos += base85_encode_block_lut2(samples, CHUNK_SAMPLES, pos);
+    }
+    CHECK(memchr(text, TELNET_IAC, TEXT_SIZE) != NULL);
+}
+
+// Inflates 'in' and undoes the IAC escaping, returning the text length.
+static size_t inflate_text(const uint8_t *in, size_t length, char *out, size_t capacity)
+{
+    z_stream z;
+    uint8_t *inflated = __libc_malloc(2 * capacity);
+    
+    memset(&z, 0, sizeof(z));
+    CHECK_EQ(inflateInit(&z), Z_OK);
+    z.next_in = (uint8_t *) in;
+    z.avail_in = length;
+    z.next_out = inflated;
+    z.avail_out = 2 * capacity;
+    int result = inflate(&z, Z_SYNC_FLUSH);
+    CHECK(result == Z_OK || result == Z_STREAM_END);
+    CHECK_EQ(z.avail_in, 0);
+    size_t inflatedLength = 2 * capacity - z.avail_out;
+    inflateEnd(&z);
+    
+    size_t textLength = 0;
+    for (size_t i = 0; i < inflatedLength && textLength < capacity; i++)
+    {
+        if (inflated[i] == TELNET_IAC)
+        {
+            CHECK(i + 1 < inflatedLength && inflated[i + 1] == TELNET_IAC);
+            i++;
+        }
+        out[textLength++] = (char) inflated[i];
+    }
+    __libc_free(inflated);
+    return textLength;
+}
+
+// Offers COMPRESS2 with the arena and the given zlib settings, sends the
+// text, and checks what arrives. Returns true if it was compressed.
+static bool run_session(int windowBits, int memLevel)
+{
+    static uint8_t wire[2 * TEXT_SIZE + 4096];
+    static char received[TEXT_SIZE];
+    static const uint8_t marker[] = {TELNET_IAC, TELNET_SB, TELNET_TELOPT_COMPRESS2, TELNET_IAC, TELNET_SE};
+    session_t session = {.wire = wire};
+    
+    arena = zlib_arena_take();
+    CHECK(arena != NULL);
+    telnet_t *telnet = telnet_init(options, event, 0, &session);
+    telnet_set_zlib(telnet, zlib_arena_alloc, zlib_arena_free, arena, CONFIG_STREAM_MCCP2_LEVEL,
+                    windowBits, memLevel);
+    
+    heapCalls = 0;
+    counting = true;
+    telnet_begin_compress2(telnet);
+    for (size_t offset = 0; offset < TEXT_SIZE; offset += CHUNK_SAMPLES * BASE85_CHARS_PER_SAMPLE)
+    {
+        telnet_send(telnet, text + offset, CHUNK_SAMPLES * BASE85_CHARS_PER_SAMPLE);
+    }
+    telnet_free(telnet);
+    counting = false;
+    CHECK_EQ(heapCalls, 0);
+    CHECK(arena->used <= ZLIB_ARENA_SIZE);
+    
+    bool compressed = session.compressing;
+    size_t length;
+    if (compressed)
+    {
+        CHECK_EQ(session.errors, 0);
+        CHECK(session.length >= sizeof(marker));
+        CHECK(memcmp(wire, marker, sizeof(marker)) == 0);
+        length = inflate_text(wire + sizeof(marker), session.length - sizeof(marker), received, TEXT_SIZE);
+        printf("COMPRESS2: %zu bytes for %d of text, %zu of %d arena bytes\n", session.length,
+               TEXT_SIZE, arena->used, (int) ZLIB_ARENA_SIZE);
+    }
+    else
+    {
+        // Refused, and said so; the text goes plain, escaped.
+        CHECK(session.errors > 0);
+        length = 0;
+        for (size_t i = 0; i < session.length && length < TEXT_SIZE; i++)
+        {
+            i += wire[i] == TELNET_IAC;
+            received[length++] = (char) wire[i];
+        }
+    }
+    CHECK_EQ(length, TEXT_SIZE);
+    CHECK(memcmp(received, text, TEXT_SIZE) == 0);
+    
+    zlib_arena_give(arena);
+    arena = NULL;
+    return compressed;
+}
+
+int main(void)
+{
+    make_text();
+    
+    // The configured settings fit the arena, again and again as it is
+    // given back and taken.
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(run_session(CONFIG_STREAM_MCCP2_WINDOW_BITS, CONFIG_STREAM_MCCP2_MEM_LEVEL));
+    }
+    // zlib's largest settings do not, and must not turn to the heap.
+    CHECK(!run_session(15, 9));
+    CHECK(zlib_arena_available());
+    CHECK_EQ(arenaFrees, 0);
+    return check_exit("telnet mccp2");
+}
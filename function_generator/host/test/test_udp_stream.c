@@ -0,0 +1,113 @@
+/* UDP Stream Test
+
+   Runs the firmware in-process with both capture channels running and
+   subscribes to the UDP stream over loopback, renewing the subscription
+   every 200 ms:
+
+   - with no TCP connection from its address the subscriptions are refused
+     and counted, and no datagram comes
+   - once a session is held with WIRE_HANDSHAKE_UDP, datagrams come, and
+     the session itself is sent nothing
+   - once the session closes, the datagrams stop, renewals or not
+*/
+#include "capture.h"
+#include "host.h"
+#include "stats.h"
+#include "udp_stream.h"
+#include "stream_client.h"
+#include "check.h"
+
+#define FREQUENCY 10000     // Six blocks a second between the two channels.
+#define RENEW_US 200000
+#define WAIT_US 1500000
+
+static int udpSocket;
+static int64_t renewed = 0;
+
+// Receives for 'us', renewing the subscription when due. Returns the
+// number of good datagrams.
+static int receive(int64_t us)
+{
+    static uint8_t datagram[UDP_STREAM_DATAGRAM_SIZE];
+    int64_t deadline = esp_timer_get_time() + us;
+    wire_header_t header;
+    int datagrams = 0;
+    
+    while (esp_timer_get_time() < deadline)
+    {
+        if (esp_timer_get_time() - renewed >= RENEW_US)
+        {
+            send(udpSocket, &(char) { WIRE_HANDSHAKE_BINARY }, 1, 0);
+            renewed = esp_timer_get_time();
+        }
+        ssize_t n = recv(udpSocket, datagram, sizeof(datagram), 0);
+        if (n < (ssize_t) sizeof(header))
+        {
+            continue;
+        }
+        memcpy(&header, datagram, sizeof(header));
+        CHECK(wire_header_valid(&header));
+        CHECK(header.flags & WIRE_FLAG_DATAGRAM);
+        CHECK_EQ(sizeof(header) + header.payload_size, n);
+        datagrams++;
+    }
+    return datagrams;
+}
+
+static uint32_t refused(void)
+{
+    uint32_t total = 0;
+    
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        total += __atomic_load_n(&stats_cores[core].counters[STATS_SUBSCRIPTIONS_REFUSED], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+int main(void)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CONFIG_STREAM_UDP_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 50000 };
+    char unused;
+    
+    stream_start_firmware();
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        host_gpio_generate(capture_channels[channel].gpio, FREQUENCY);
+    }
+    udpSocket = socket(AF_INET, SOCK_DGRAM, 0);
+    setsockopt(udpSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    CHECK_EQ(connect(udpSocket, (struct sockaddr *) &addr, sizeof(addr)), 0);
+    
+    // Waits for the server to take connections, then leaves it none.
+    int session = stream_connect(0, 0, 2000000);
+    CHECK(session >= 0);
+    close(session);
+    usleep(RENEW_US);
+    
+    int unheld = receive(WAIT_US);
+    CHECK_EQ(unheld, 0);
+    CHECK(refused() > 0);
+    
+    session = stream_connect(WIRE_HANDSHAKE_UDP, 0, 2000000);
+    CHECK(session >= 0);
+    int held = receive(WAIT_US);
+    CHECK(held > 0);
+    CHECK_EQ(recv(session, &unused, 1, MSG_DONTWAIT), -1);
+    
+    // Datagrams already on their way can still arrive at first.
+    close(session);
+    receive(RENEW_US * 2);
+    int closed = receive(WAIT_US);
+    CHECK_EQ(closed, 0);
+    
+    printf("UDP stream: %d datagrams without a session, %d with, %d after it closed, %u refused\n",
+           unheld, held, closed, refused());
+    close(udpSocket);
+    return check_exit("udp stream");
+}
@@ -0,0 +1,97 @@
+/* Base-85 Encoder
+
+   See base85.h.
+
+   All the fast kernels work on the magnitude of the sample. For a negative
+   sample the original loop produces 33 - digit instead of 33 + digit, which
+   is applied at the end by a sign dependent offset and multiplier.
+*/
+#include "base85.h"
+
+// u / 85 and u / 7225 for any u <= 2^31, the largest sample magnitude.
+#define DIV85(u) ((uint32_t) (((uint64_t) (u) * 0x60606061u) >> 37))
+#define DIV7225(u) ((uint32_t) (((uint64_t) (u) * 0x9121B243u) >> 44))
+
+static char pairTable[85 * 85][2];
+
+void base85_init(void)
+{
+    for (int i = 0; i < 85 * 85; i++)
+    {
+        pairTable[i][0] = (char) (i % 85 + 33);
+        pairTable[i][1] = (char) (i / 85 + 33);
+    }
+}
+
+size_t base85_encode_block_reference(const int32_t *samples, size_t count, char *out)
+{
+    char *pos = out;
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t val = samples[i];
+        for (int j = 0; j < 4; j++)
+        {
+            *pos++ = val % 85 + 33;
+            val = val / 85;
+        }
+        *pos++ = val + 33;
+    }
+    return pos - out;
+}
+
+size_t base85_encode_block_mulshift(const int32_t *samples, size_t count, char *out)
+{
+    char *pos = out;
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t val = samples[i];
+        int sign = (val < 0) ? -1 : 1;
+        uint32_t u = (val < 0) ? 0u - (uint32_t) val : (uint32_t) val;
+        
+        for (int j = 0; j < 4; j++)
+        {
+            uint32_t q = DIV85(u);
+            *pos++ = (char) (33 + sign * (int) (u - q * 85));
+            u = q;
+        }
+        *pos++ = (char) (33 + sign * (int) u);
+    }
+    return pos - out;
+}
+
+size_t base85_encode_block_lut2(const int32_t *samples, size_t count, char *out)
+{
+    char *pos = out;
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        int32_t val = samples[i];
+        uint32_t u = (val < 0) ? 0u - (uint32_t) val : (uint32_t) val;
+        uint32_t q1 = DIV7225(u);
+        uint32_t q2 = DIV7225(q1);
+        const char *low = pairTable[u - q1 * 7225];
+        const char *mid = pairTable[q1 - q2 * 7225];
+        
+        if (val >= 0)
+        {
+            pos[0] = low[0];
+            pos[1] = low[1];
+            pos[2] = mid[0];
+            pos[3] = mid[1];
+            pos[4] = (char) (33 + q2);
+        }
+        else
+        {
+            // 33 - d == 66 - (33 + d)
+            pos[0] = (char) (66 - low[0]);
+            pos[1] = (char) (66 - low[1]);
+            pos[2] = (char) (66 - mid[0]);
+            pos[3] = (char) (66 - mid[1]);
+            pos[4] = (char) (33 - (int) q2);
+        }
+        pos += 5;
+    }
+    return pos - out;
+}
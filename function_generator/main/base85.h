@@ -0,0 +1,40 @@
+/* Base-85 Encoder
+
+   Encoders for the Ascii85 text stream. Every sample becomes five
+   characters, least significant base-85 digit first, each digit offset by
+   '!' (33). This is exactly the output of the original per-sample loop
+
+       for (j = 0; j < 4; j++) { out = val % 85 + 33; val = val / 85; }
+       out = val + 33;
+
+   including its behaviour for negative samples, where C's truncating
+   division gives digits of the magnitude subtracted from 33.
+
+   Three interchangeable kernels are provided:
+   - reference: the original loop, eight divisions per sample.
+   - mulshift:  each division by 85 replaced by a multiply by its
+                reciprocal and a shift.
+   - lut2:      two divisions by 85^2, also by multiply-shift, with each
+                remainder looked up as a pair of characters in a 7225
+                entry table (14 KB, built by base85_init()).
+
+   No ESP-IDF dependencies; shared with the host-side tools.
+*/
+#ifndef BASE85_H
+#define BASE85_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BASE85_CHARS_PER_SAMPLE 5
+
+// Builds the lut2 table. Call once before using base85_encode_block_lut2().
+void base85_init(void);
+
+// Each writes count * BASE85_CHARS_PER_SAMPLE characters to 'out' and
+// returns that number.
+size_t base85_encode_block_reference(const int32_t *samples, size_t count, char *out);
+size_t base85_encode_block_mulshift(const int32_t *samples, size_t count, char *out);
+size_t base85_encode_block_lut2(const int32_t *samples, size_t count, char *out);
+
+#endif // BASE85_H
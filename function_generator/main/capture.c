@@ -0,0 +1,32 @@
+/* Signal Capture
+
+   See capture.h.
+*/
+#include "capture.h"
+
+#ifndef CONFIG_CAPTURE_CHANNEL_0_ANYEDGE
+#define CONFIG_CAPTURE_CHANNEL_0_ANYEDGE 0
+#endif
+#ifndef CONFIG_CAPTURE_CHANNEL_1_ANYEDGE
+#define CONFIG_CAPTURE_CHANNEL_1_ANYEDGE 0
+#endif
+#ifndef CONFIG_CAPTURE_CHANNEL_2_ANYEDGE
+#define CONFIG_CAPTURE_CHANNEL_2_ANYEDGE 0
+#endif
+#ifndef CONFIG_CAPTURE_CHANNEL_3_ANYEDGE
+#define CONFIG_CAPTURE_CHANNEL_3_ANYEDGE 0
+#endif
+
+const capture_channel_t capture_channels[CAPTURE_CHANNELS] =
+{
+    { CONFIG_CAPTURE_CHANNEL_0_GPIO, CONFIG_CAPTURE_CHANNEL_0_ANYEDGE },
+#if CAPTURE_CHANNELS > 1
+    { CONFIG_CAPTURE_CHANNEL_1_GPIO, CONFIG_CAPTURE_CHANNEL_1_ANYEDGE },
+#endif
+#if CAPTURE_CHANNELS > 2
+    { CONFIG_CAPTURE_CHANNEL_2_GPIO, CONFIG_CAPTURE_CHANNEL_2_ANYEDGE },
+#endif
+#if CAPTURE_CHANNELS > 3
+    { CONFIG_CAPTURE_CHANNEL_3_GPIO, CONFIG_CAPTURE_CHANNEL_3_ANYEDGE },
+#endif
+};
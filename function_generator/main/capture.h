@@ -0,0 +1,102 @@
+/* Signal Capture
+
+   A capture backend turns activity on the receiver pins into samples for
+   SignalReceiverTask. Each of the CAPTURE_CHANNELS channels has its own
+   pin (CONFIG_CAPTURE_CHANNEL_n_GPIO) and is captured independently: its
+   own edge counter and buffer, and its own sample blocks, tagged with the
+   channel number in the stream. Two backends are provided:
+
+   - capture_gpio_backend: one CPU interrupt per edge, edges passed to the
+     task through a lock-free edge ring per channel. Each sample is the
+     channel's running edge count at that edge or, with
+     CONFIG_CAPTURE_FORMAT_EDGE_TIME, an edge record giving the edge's
+     level and cycle-accurate time (see edge_record.h).
+   - capture_pcnt_backend: each pin is routed into its own ESP32 pulse
+     counter (PCNT) unit and no CPU time is spent per edge. The accumulated
+     count is sampled once per CONFIG_CAPTURE_PCNT_SAMPLE_PERIOD_MS.
+
+   A count sample is the low 32 bits of the count, so it wraps every 2^32
+   edges (and reads as negative from 2^31); the edges between two samples
+   are their difference modulo 2^32.
+
+   The backend used by the application is chosen in Kconfig; both are always
+   built so they can be swapped without touching the receiver.
+
+   init() is called from SignalReceiverTask, so the backend's interrupts are
+   serviced on the core that task is pinned to (CONFIG_CAPTURE_TASK_CORE).
+*/
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+#define CAPTURE_CHANNELS CONFIG_CAPTURE_CHANNELS
+
+typedef struct
+{
+    int gpio;
+    bool anyEdge;   // Capture falling as well as rising edges.
+} capture_channel_t;
+
+// The receiver pins, indexed by channel. See capture.c.
+extern const capture_channel_t capture_channels[CAPTURE_CHANNELS];
+
+typedef struct
+{
+    const char *name;
+    
+    // Configures the input pins and starts capturing.
+    void (*init)(void);
+    
+    // Blocks for at most 'wait' ticks until there is something to read on
+    // any channel.
+    void (*wait)(TickType_t wait);
+    
+    // Writes up to 'max' of the channel's samples to 'samples' without
+    // blocking. Returns the number of samples written.
+    size_t (*read)(int channel, int32_t *samples, size_t max);
+    
+    // Total number of the channel's edges the backend has had to discard.
+    uint32_t (*overruns)(int channel);
+    
+    // Total number of edges seen on the channel, including discarded ones.
+    // Safe to call from any task.
+    uint32_t (*edges)(int channel);
+    
+    // Edge-time format only: the absolute cycle count the channel's next
+    // record's delta will be measured from. Becomes the anchor of a block
+    // when it is read before the block's first sample. NULL for counting
+    // backends.
+    uint64_t (*time_base)(int channel);
+} capture_backend_t;
+
+extern const capture_backend_t capture_gpio_backend;
+extern const capture_backend_t capture_pcnt_backend;
+
+// GPIO interrupt backend only, for synthetic sources (see signal_gen.h).
+// Disconnects 'channel' from its pin so the caller is the only producer on
+// its edge ring. Call from the capture core. Returns false, doing nothing,
+// if capture has not started yet.
+bool capture_gpio_detach(int channel);
+
+// Adds an edge to a detached channel as its ISR would, with the CCOUNT of
+// the capture core when it happened, and wakes the reader when a batch is
+// ready. Call from the capture core, below the reader's priority. Returns
+// false if the ring was full and the edge was counted as an overrun.
+bool capture_gpio_inject(int channel, uint32_t ccount, uint32_t level);
+
+// Tells the reader that every edge of a detached channel up to 'ccount' has
+// been injected, so its clock can move on to there. Edges injected later
+// must be after 'ccount', and after the CCOUNT at detach.
+void capture_gpio_inject_until(int channel, uint32_t ccount);
+
+#if CONFIG_CAPTURE_BACKEND_PCNT
+#define capture_backend capture_pcnt_backend
+#else
+#define capture_backend capture_gpio_backend
+#endif
+
+#endif // CAPTURE_H
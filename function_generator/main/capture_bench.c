@@ -0,0 +1,90 @@
+/* Capture Benchmark
+
+   See capture_bench.h.
+*/
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "capture.h"
+#include "capture_bench.h"
+#include "signal_gen.h"
+
+#define BENCH_GPIO 18               // GPIO_OUTPUT_IO_0, wired to channel 0.
+#define BENCH_START_HZ 10000
+#define BENCH_MAX_HZ 5000000
+#define BENCH_SETTLE_MS 100
+#define BENCH_STEP_MS 1000
+#define BENCH_CHECK_MS 50           // Overruns are checked this often so a step
+                                    // the core cannot keep up with ends early.
+
+static const char* TAG = "capture bench";
+
+/*
+  Holds the signal at 'frequency' for one step. Returns true if channel 0
+  saw every edge and its ring did not overrun.
+ */
+static bool run_step(uint32_t frequency, uint32_t edgesPerPeriod)
+{
+    uint32_t overruns;
+    uint32_t startEdges;
+    int64_t start;
+    bool overrun = false;
+    
+    if (!signal_gen_set_frequency(0, frequency))
+    {
+        return false;
+    }
+    vTaskDelay(pdMS_TO_TICKS(BENCH_SETTLE_MS));
+    
+    overruns = capture_backend.overruns(0);
+    startEdges = capture_backend.edges(0);
+    start = esp_timer_get_time();
+    for (int elapsed = 0; elapsed < BENCH_STEP_MS && !overrun; elapsed += BENCH_CHECK_MS)
+    {
+        vTaskDelay(pdMS_TO_TICKS(BENCH_CHECK_MS));
+        overrun = (capture_backend.overruns(0) != overruns);
+    }
+    uint32_t edges = capture_backend.edges(0) - startEdges;
+    uint64_t expected = (uint64_t) frequency * edgesPerPeriod * (esp_timer_get_time() - start) / 1000000;
+    
+    // Allow for the edges in flight at either end of the step.
+    bool complete = !overrun && (uint64_t) edges * 1000 >= expected * 999;
+    ESP_LOGI(TAG, "%u edges/s: %u of %u edges seen, %u overruns%s",
+             frequency * edgesPerPeriod, edges, (uint32_t) expected,
+             capture_backend.overruns(0) - overruns, complete ? "" : " - lost edges");
+    return complete;
+}
+
+void capture_bench_run(int captureCore, int networkCore)
+{
+    uint32_t edgesPerPeriod = capture_channels[0].anyEdge ? 2 : 1;
+    uint32_t sustained = 0;
+    signal_config_t signal = {
+        .source = SIGNAL_SOURCE_LEDC,
+        .target = BENCH_GPIO,
+        .frequency = BENCH_START_HZ,
+        .dutyPercent = 50,
+    };
+    
+    ESP_LOGI(TAG, "Stepping GPIO %d up from %u Hz; ISR and capture on core %d, network on core %d",
+             BENCH_GPIO, BENCH_START_HZ, captureCore, networkCore);
+    if (!signal_gen_start(0, &signal))
+    {
+        return;
+    }
+    
+    for (uint32_t frequency = BENCH_START_HZ; frequency <= BENCH_MAX_HZ; frequency += frequency / 4)
+    {
+        if (!run_step(frequency, edgesPerPeriod))
+        {
+            break;
+        }
+        sustained = frequency * edgesPerPeriod;
+    }
+    signal_gen_stop(0);
+    
+    ESP_LOGI(TAG, "ISR and capture on core %d, network on core %d: %u edges/s sustained",
+             captureCore, networkCore, sustained);
+}
@@ -0,0 +1,19 @@
+/* Capture Benchmark
+
+   Finds the highest edge rate the capture path sustains with the current
+   core placement. A square wave from the LEDC peripheral on GPIO 18 (see
+   signal_gen.h), wired to capture channel 0's pin, is stepped up in
+   frequency until channel 0 misses edges or its edge ring overruns. Each step is held for a second
+   and logged; the last step captured in full is the result.
+
+   Clients may stay connected while it runs, so the result includes the
+   load of streaming. Enabled with CONFIG_CAPTURE_BENCHMARK.
+*/
+#ifndef CAPTURE_BENCH_H
+#define CAPTURE_BENCH_H
+
+// Runs the benchmark once; the core numbers are only reported. Call after
+// the capture backend has been started.
+void capture_bench_run(int captureCore, int networkCore);
+
+#endif // CAPTURE_BENCH_H
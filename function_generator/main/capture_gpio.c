@@ -0,0 +1,344 @@
+/* GPIO Interrupt Capture Backend
+
+   Each edge on the receiver pins raises a CPU interrupt. The ISR records the
+   pin, level and cycle count in its channel's edge ring; read() drains one
+   channel's ring and converts every event into an edge count sample or, in
+   the edge-time format, an edge record.
+
+   Channels share nothing on the edge path: each has its own ring, indices
+   and overrun count, written by its ISR alone, and its own count or cycle
+   state, written by the reader alone. Edges on different pins never wait
+   for each other beyond the interrupt itself.
+
+   CCOUNT is a 32 bit per-core counter that wraps every 2^32 cycles (27 s at
+   160 MHz). read() extends it to 64 bits from the differences between
+   successive events and, when the ring is empty, the current CCOUNT, so
+   the ring must be drained empty at least that often, and read() must run
+   on the core the ISR was installed from.
+
+   The reader is not woken per edge. The ISR sends a single task
+   notification when a ring fills to CONFIG_CAPTURE_DRAIN_THRESHOLD events,
+   and wait() otherwise sleeps until its timeout, so one wake up drains a
+   whole batch from every channel.
+*/
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "soc/gpio_struct.h"
+#include "xtensa/core-macros.h"
+
+#include "capture.h"
+#include "edge_ring.h"
+#include "edge_record.h"
+#include "stats.h"
+#include "trace.h"
+
+#define ESP_INTR_FLAG_DEFAULT 0
+
+#define DRAIN_THRESHOLD CONFIG_CAPTURE_DRAIN_THRESHOLD
+
+_Static_assert(DRAIN_THRESHOLD <= EDGE_RING_SIZE,
+               "CONFIG_CAPTURE_DRAIN_THRESHOLD must not exceed CONFIG_EDGE_RING_SIZE");
+
+// ISR side of a channel. Kept in DRAM so the ISR can run with the flash
+// cache disabled.
+typedef struct
+{
+    edge_ring_t ring;
+    uint32_t gpio;
+    bool detached;              // Fed by capture_gpio_inject() instead of the pin.
+    uint32_t injectedUntil;     // Detached: every edge up to this CCOUNT is in the ring.
+} isr_channel_t;
+
+// Reader side of a channel.
+typedef struct
+{
+    bool drainPending;          // The last read() left events in the ring.
+#if CONFIG_CAPTURE_FORMAT_EDGE_TIME
+    uint32_t lastCcount;        // Last CCOUNT seen, from an event or the clock.
+    uint64_t lastCycles;        // 'lastCcount' extended to 64 bits.
+    uint64_t baseCycles;        // Time the next record's delta is measured from.
+#else
+    int32_t signalCt;
+#endif
+} reader_channel_t;
+
+static DRAM_ATTR isr_channel_t isrChannels[CAPTURE_CHANNELS];
+static reader_channel_t readerChannels[CAPTURE_CHANNELS];
+
+static TaskHandle_t reader = NULL;
+static bool started = false;
+
+static void IRAM_ATTR gpio_isr_handler(void* arg)
+{
+    isr_channel_t *channel = (isr_channel_t *) arg;
+    uint32_t gpio = channel->gpio;
+    uint32_t ccount = XTHAL_GET_CCOUNT();     // Before tracing, so the edge time is not skewed.
+    // GPIO 32-39 are read from the second input register.
+    uint32_t level = gpio < 32 ? (GPIO.in >> gpio) & 1 : (GPIO.in1.data >> (gpio - 32)) & 1;
+    
+    TRACE(TRACE_ISR_ENTER, gpio);
+    if (!edge_ring_push(&channel->ring, gpio, level, ccount))
+    {
+        TRACE(TRACE_EDGE_OVERRUN, gpio);
+    }
+    else if (edge_ring_count(&channel->ring) == DRAIN_THRESHOLD && reader != NULL)
+    {
+        BaseType_t woken = pdFALSE;
+        TRACE(TRACE_NOTIFY, gpio);
+        vTaskNotifyGiveFromISR(reader, &woken);
+        if (woken)
+        {
+            portYIELD_FROM_ISR();
+        }
+    }
+    TRACE(TRACE_ISR_EXIT, gpio);
+}
+
+static void capture_gpio_init(void)
+{
+    gpio_config_t io_conf;
+    uint64_t pinMask = 0;
+    
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        pinMask |= 1ULL << capture_channels[channel].gpio;
+    }
+    //interrupt of rising edge
+    io_conf.intr_type = GPIO_PIN_INTR_POSEDGE;
+    //bit mask of the pins, one per channel
+    io_conf.pin_bit_mask = pinMask;
+    //set as input mode
+    io_conf.mode = GPIO_MODE_INPUT;
+    //disable pull-down mode
+    io_conf.pull_down_en = 0;
+    //enable pull-up mode
+    io_conf.pull_up_en = 1;
+    gpio_config(&io_conf);
+    //install gpio isr service
+    gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
+    
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        int gpio = capture_channels[channel].gpio;
+        reader_channel_t *state = &readerChannels[channel];
+    
+        isrChannels[channel].gpio = gpio;
+        if (capture_channels[channel].anyEdge)
+        {
+            gpio_set_intr_type(gpio, GPIO_INTR_ANYEDGE);
+        }
+#if CONFIG_CAPTURE_FORMAT_EDGE_TIME
+        // Start the cycle count from the esp_timer time, so anchors line up
+        // with the microsecond timestamps used elsewhere.
+        state->lastCcount = XTHAL_GET_CCOUNT();
+        state->lastCycles = (uint64_t) esp_timer_get_time() * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+        state->baseCycles = state->lastCycles;
+#else
+        state->signalCt = 0;
+#endif
+        //hook isr handler for the channel's pin
+        gpio_isr_handler_add(gpio, gpio_isr_handler, &isrChannels[channel]);
+    }
+    __atomic_store_n(&started, true, __ATOMIC_RELEASE);
+}
+
+#if CONFIG_CAPTURE_FORMAT_EDGE_TIME
+/*
+  Converts ring events to edge records. Gap records are written first when
+  an interval is too long for one record; if 'max' runs out part way, the
+  event stays in the ring for the next call.
+ */
+static size_t drain_edge_times(isr_channel_t *isrChannel, reader_channel_t *state,
+                               int32_t *samples, size_t max)
+{
+    edge_ring_t *ring = &isrChannel->ring;
+    const edge_event_t *events;
+    size_t available;
+    size_t count = 0;
+    
+    while (count < max && (available = edge_ring_span(ring, &events)) > 0)
+    {
+        size_t used = 0;
+        while (used < available && count < max)
+        {
+            const edge_event_t *event = &events[used];
+            uint64_t cycles = state->lastCycles + (uint32_t) (event->ccount - state->lastCcount);
+            uint64_t delta = cycles - state->baseCycles;
+    
+            while (delta >= EDGE_RECORD_DELTA_MAX && count < max)
+            {
+                samples[count++] = EDGE_RECORD_GAP;
+                state->baseCycles += EDGE_RECORD_DELTA_MAX;
+                delta -= EDGE_RECORD_DELTA_MAX;
+            }
+            if (count == max)
+            {
+                break;
+            }
+            samples[count++] = edge_record_pack((uint32_t) delta, event->level);
+            state->lastCcount = event->ccount;
+            state->lastCycles = cycles;
+            state->baseCycles = cycles;
+            used++;
+        }
+        edge_ring_release(ring, used);
+        if (used < available)
+        {
+            break;
+        }
+    }
+    
+    // Carry the extended count through quiet spells. CCOUNT is read before
+    // checking the ring: any edge pushed after that check is later than
+    // 'now', and any pushed before it is still in the ring. A detached
+    // channel's edges are written after they were due, so its clock only
+    // goes as far as its injector says it has written.
+    uint32_t now = __atomic_load_n(&isrChannel->detached, __ATOMIC_ACQUIRE) ?
+                   __atomic_load_n(&isrChannel->injectedUntil, __ATOMIC_ACQUIRE) : XTHAL_GET_CCOUNT();
+    if (edge_ring_count(ring) == 0 && (int32_t) (now - state->lastCcount) > 0)
+    {
+        state->lastCycles += (uint32_t) (now - state->lastCcount);
+        state->lastCcount = now;
+    }
+    return count;
+}
+#else
+static size_t drain_counts(edge_ring_t *ring, reader_channel_t *state,
+                           int32_t *samples, size_t max)
+{
+    const edge_event_t *events;
+    size_t available;
+    size_t count = 0;
+    
+    while (count < max && (available = edge_ring_span(ring, &events)) > 0)
+    {
+        if (available > max - count)
+        {
+            available = max - count;
+        }
+        int32_t first = state->signalCt;
+        int32_t *dest = &samples[count];
+        for (size_t i = 0; i < available; i++)
+        {
+            dest[i] = first + (int32_t) i;
+        }
+        state->signalCt += available;
+        count += available;
+        edge_ring_release(ring, available);
+    }
+    return count;
+}
+#endif
+
+static void capture_gpio_wait(TickType_t wait)
+{
+    if (reader == NULL)
+    {
+        reader = xTaskGetCurrentTaskHandle();
+    }
+    
+    // Unless the last pass left events behind or a batch is already waiting,
+    // sleep until the ISR reports a full batch or the timeout expires.
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        if (readerChannels[channel].drainPending ||
+            edge_ring_count(&isrChannels[channel].ring) >= DRAIN_THRESHOLD)
+        {
+            return;
+        }
+    }
+    TRACE(TRACE_WAIT_BEGIN, 0);
+    ulTaskNotifyTake(pdTRUE, wait);
+    TRACE(TRACE_WAIT_END, 0);
+}
+
+static size_t capture_gpio_read(int channel, int32_t *samples, size_t max)
+{
+    edge_ring_t *ring = &isrChannels[channel].ring;
+    reader_channel_t *state = &readerChannels[channel];
+    size_t count;
+    
+    stats_sample(STATS_RING_AT_DRAIN, edge_ring_count(ring));
+    
+    // Drain everything the ISR has pushed since the last pass.
+#if CONFIG_CAPTURE_FORMAT_EDGE_TIME
+    count = drain_edge_times(&isrChannels[channel], state, samples, max);
+#else
+    count = drain_counts(ring, state, samples, max);
+#endif
+    state->drainPending = (edge_ring_count(ring) > 0);
+    TRACE(TRACE_DRAIN, count);
+    return count;
+}
+
+static uint32_t capture_gpio_overruns(int channel)
+{
+    return isrChannels[channel].ring.overruns;
+}
+
+static uint32_t capture_gpio_edges(int channel)
+{
+    const edge_ring_t *ring = &isrChannels[channel].ring;
+    
+    return ring->head + ring->overruns;
+}
+
+#if CONFIG_CAPTURE_FORMAT_EDGE_TIME
+static uint64_t capture_gpio_time_base(int channel)
+{
+    return readerChannels[channel].baseCycles;
+}
+#endif
+
+bool capture_gpio_detach(int channel)
+{
+    isr_channel_t *isrChannel = &isrChannels[channel];
+    
+    if (!__atomic_load_n(&started, __ATOMIC_ACQUIRE))
+    {
+        return false;
+    }
+#if CONFIG_CAPTURE_FORMAT_EDGE_TIME
+    // Hold the reader's clock where it is until the first injection.
+    isrChannel->injectedUntil = readerChannels[channel].lastCcount;
+#endif
+    __atomic_store_n(&isrChannel->detached, true, __ATOMIC_RELEASE);
+    gpio_isr_handler_remove(capture_channels[channel].gpio);
+    return true;
+}
+
+void capture_gpio_inject_until(int channel, uint32_t ccount)
+{
+    __atomic_store_n(&isrChannels[channel].injectedUntil, ccount, __ATOMIC_RELEASE);
+}
+
+bool capture_gpio_inject(int channel, uint32_t ccount, uint32_t level)
+{
+    isr_channel_t *isrChannel = &isrChannels[channel];
+    
+    if (!edge_ring_push(&isrChannel->ring, capture_channels[channel].gpio, level, ccount))
+    {
+        return false;
+    }
+    if (edge_ring_count(&isrChannel->ring) == DRAIN_THRESHOLD && reader != NULL)
+    {
+        xTaskNotifyGive(reader);
+    }
+    return true;
+}
+
+const capture_backend_t capture_gpio_backend =
+{
+    .name = "GPIO interrupt",
+    .init = capture_gpio_init,
+    .wait = capture_gpio_wait,
+    .read = capture_gpio_read,
+    .overruns = capture_gpio_overruns,
+    .edges = capture_gpio_edges,
+#if CONFIG_CAPTURE_FORMAT_EDGE_TIME
+    .time_base = capture_gpio_time_base,
+#endif
+};
@@ -0,0 +1,149 @@
+/* Pulse Counter (PCNT) Capture Backend
+
+   Each channel's pin is routed into its own PCNT unit, so edges are counted
+   in hardware with no CPU involvement. The 16 bit hardware counters are
+   extended to 64 bits by an interrupt on the high limit, which fires once
+   every PCNT_H_LIM edges rather than once per edge.
+
+   wait() waits for the next sample period, and read() then emits the
+   channel's accumulated count as a single sample. A sample holds the low
+   32 bits of the count, so it wraps every 2^32 edges and goes negative
+   after 2^31; clients take the difference of two samples modulo 2^32.
+*/
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/pcnt.h"
+#include "esp_log.h"
+
+#include "capture.h"
+
+#define PCNT_H_LIM 32767
+#define PCNT_UNITS CAPTURE_CHANNELS
+
+_Static_assert(PCNT_UNITS <= PCNT_UNIT_MAX, "More capture channels than PCNT units");
+
+static const char* TAG = "capture pcnt";
+
+static volatile uint64_t overflow[PCNT_UNITS];
+static uint32_t highest[PCNT_UNITS];    // Low 32 bits of the highest total read.
+static TickType_t lastWake;
+static TickType_t samplePeriod;
+
+static void IRAM_ATTR pcnt_overflow_isr(void* arg)
+{
+    overflow[(intptr_t) arg] += PCNT_H_LIM;
+}
+
+static uint64_t pcnt_read_unit(int unit)
+{
+    uint64_t high;
+    int16_t low;
+    
+    do
+    {
+        high = overflow[unit];
+        pcnt_get_counter_value((pcnt_unit_t) unit, &low);
+    } while (high != overflow[unit]);
+    
+    return high + (uint16_t) low;
+}
+
+// The unit's total, as read() and edges() both see it. The count only ever
+// increases, so a drop below the highest total read means the counter
+// wrapped to zero before its overflow interrupt had been serviced. Only the
+// low 32 bits of the highest are kept, so any task can raise them with one
+// atomic word.
+static uint64_t pcnt_total(int unit)
+{
+    uint64_t total = pcnt_read_unit(unit);
+    uint32_t seen = __atomic_load_n(&highest[unit], __ATOMIC_RELAXED);
+    
+    while ((int32_t) ((uint32_t) total - seen) < 0)
+    {
+        total += PCNT_H_LIM;
+    }
+    while ((int32_t) ((uint32_t) total - seen) > 0 &&
+           !__atomic_compare_exchange_n(&highest[unit], &seen, (uint32_t) total, false,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+    return total;
+}
+
+static void capture_pcnt_init(void)
+{
+    for (int unit = 0; unit < PCNT_UNITS; unit++)
+    {
+        pcnt_config_t pcnt_config = {
+            .pulse_gpio_num = capture_channels[unit].gpio,
+            .ctrl_gpio_num = PCNT_PIN_NOT_USED,
+            .channel = PCNT_CHANNEL_0,
+            .unit = (pcnt_unit_t) unit,
+            .pos_mode = PCNT_COUNT_INC,
+            // Match the interrupt backend's choice of edges.
+            .neg_mode = capture_channels[unit].anyEdge ? PCNT_COUNT_INC : PCNT_COUNT_DIS,
+            .lctrl_mode = PCNT_MODE_KEEP,
+            .hctrl_mode = PCNT_MODE_KEEP,
+            .counter_h_lim = PCNT_H_LIM,
+            .counter_l_lim = 0,
+        };
+        ESP_ERROR_CHECK(pcnt_unit_config(&pcnt_config));
+        pcnt_filter_disable((pcnt_unit_t) unit);
+        pcnt_event_enable((pcnt_unit_t) unit, PCNT_EVT_H_LIM);
+        pcnt_counter_pause((pcnt_unit_t) unit);
+        pcnt_counter_clear((pcnt_unit_t) unit);
+    }
+    
+    ESP_ERROR_CHECK(pcnt_isr_service_install(0));
+    for (int unit = 0; unit < PCNT_UNITS; unit++)
+    {
+        pcnt_isr_handler_add((pcnt_unit_t) unit, pcnt_overflow_isr, (void*) (intptr_t) unit);
+        pcnt_intr_enable((pcnt_unit_t) unit);
+        pcnt_counter_resume((pcnt_unit_t) unit);
+    }
+    
+    samplePeriod = pdMS_TO_TICKS(CONFIG_CAPTURE_PCNT_SAMPLE_PERIOD_MS);
+    if (samplePeriod == 0)
+    {
+        samplePeriod = 1;
+    }
+    lastWake = xTaskGetTickCount();
+    ESP_LOGI(TAG, "Sampling every %u ticks", samplePeriod);
+}
+
+static void capture_pcnt_wait(TickType_t wait)
+{
+    (void) wait;    // Paced by the sample period instead.
+    vTaskDelayUntil(&lastWake, samplePeriod);
+}
+
+static size_t capture_pcnt_read(int channel, int32_t *samples, size_t max)
+{
+    if (max == 0)
+    {
+        return 0;
+    }
+    samples[0] = (int32_t) (uint32_t) pcnt_total(channel);
+    return 1;
+}
+
+static uint32_t capture_pcnt_overruns(int channel)
+{
+    (void) channel;
+    return 0;   // The hardware counter never drops edges.
+}
+
+static uint32_t capture_pcnt_edges(int channel)
+{
+    return (uint32_t) pcnt_total(channel);
+}
+
+const capture_backend_t capture_pcnt_backend =
+{
+    .name = "PCNT",
+    .init = capture_pcnt_init,
+    .wait = capture_pcnt_wait,
+    .read = capture_pcnt_read,
+    .overruns = capture_pcnt_overruns,
+    .edges = capture_pcnt_edges,
+};
@@ -0,0 +1,117 @@
+/* Connection Manager
+
+   See conn_manager.h.
+*/
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+
+#include "conn_manager.h"
+#include "stream_server.h"
+
+static const char* TAG = "conn manager";
+
+static const char *stateNames[] = { "waiting for WiFi", "listening", "streaming" };
+
+static volatile bool wifiUp = false;
+static conn_state_t state = CONN_WAIT_WIFI;
+
+static int64_t unreceivedSince;     // Start of the current spell with nobody receiving.
+static int64_t unreceivedTotal = 0; // Completed spells only.
+
+void conn_manager_wifi_up(void)
+{
+    wifiUp = true;
+    stream_server_wake();
+}
+
+void conn_manager_wifi_down(void)
+{
+    wifiUp = false;
+    stream_server_wake();
+}
+
+conn_state_t conn_manager_state(void)
+{
+    return state;
+}
+
+int64_t conn_manager_unreceived_time(void)
+{
+    if (state == CONN_STREAMING)
+    {
+        return unreceivedTotal;
+    }
+    return unreceivedTotal + esp_timer_get_time() - unreceivedSince;
+}
+
+static void set_state(conn_state_t next)
+{
+    int64_t now = esp_timer_get_time();
+    
+    if (next == state)
+    {
+        return;
+    }
+    ESP_LOGI(TAG, "%s -> %s", stateNames[state], stateNames[next]);
+    if (next == CONN_STREAMING)
+    {
+        unreceivedTotal += now - unreceivedSince;
+        ESP_LOGI(TAG, "Receiving again after %lld ms (%lld ms in total with nobody receiving)",
+                 (long long) (now - unreceivedSince) / 1000, (long long) unreceivedTotal / 1000);
+    }
+    else if (state == CONN_STREAMING)
+    {
+        unreceivedSince = now;
+    }
+    state = next;
+}
+
+void conn_manager_run(int port)
+{
+    int64_t lastRetry = esp_timer_get_time();
+    
+    unreceivedSince = lastRetry;
+    while(1)
+    {
+        // Blocks for at most a second; also releases blocks nobody wants.
+        stream_server_poll();
+    
+        int64_t now = esp_timer_get_time();
+        switch (state)
+        {
+            case CONN_WAIT_WIFI:
+                if (wifiUp)
+                {
+                    if (stream_server_listen(port))
+                    {
+                        set_state(CONN_LISTENING);
+                    }
+                }
+                else if (now - lastRetry >= CONFIG_WIFI_RECONNECT_INTERVAL_MS * 1000LL)
+                {
+                    // The event handler gives up after a few attempts; keep trying.
+                    esp_wifi_connect();
+                    lastRetry = now;
+                }
+                break;
+    
+            case CONN_LISTENING:
+            case CONN_STREAMING:
+                if (!wifiUp)
+                {
+                    stream_server_close();
+                    lastRetry = now;
+                    set_state(CONN_WAIT_WIFI);
+                }
+                else
+                {
+                    set_state(stream_server_client_count() > 0 ? CONN_STREAMING : CONN_LISTENING);
+                }
+                break;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+/* Connection Manager
+
+   Owns the listening socket across WiFi drops.
+
+   The network task runs conn_manager_run(), which moves between three
+   states:
+
+     WAIT_WIFI  - no IP address. No listener is open; new blocks are released
+                  as they arrive and the AP is retried every
+                  CONFIG_WIFI_RECONNECT_INTERVAL_MS.
+     LISTENING  - listener open, nobody connected.
+     STREAMING  - at least one client connected.
+
+   Losing the IP address closes every client and the listener; getting it
+   back reopens the listener, so clients can reconnect without a reboot.
+   Lost clients are detected by send errors and by TCP keepalive (see
+   stream_server.c) and the manager drops back to LISTENING.
+
+   Time spent outside STREAMING is time nobody was receiving data; it is
+   accumulated and logged when a client next connects.
+*/
+#ifndef CONN_MANAGER_H
+#define CONN_MANAGER_H
+
+#include <stdint.h>
+
+typedef enum
+{
+    CONN_WAIT_WIFI,
+    CONN_LISTENING,
+    CONN_STREAMING,
+} conn_state_t;
+
+// Called from the WiFi/IP event handler.
+void conn_manager_wifi_up(void);
+void conn_manager_wifi_down(void);
+
+// Body of the network task; never returns.
+void conn_manager_run(int port);
+
+conn_state_t conn_manager_state(void);
+
+// Total microseconds spent with nobody receiving data, up to now.
+int64_t conn_manager_unreceived_time(void);
+
+#endif // CONN_MANAGER_H
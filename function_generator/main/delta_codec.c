@@ -0,0 +1,76 @@
+/* Delta Codec
+
+   See delta_codec.h.
+*/
+#include "delta_codec.h"
+
+size_t delta_varint_encode(const int32_t *samples, size_t count, uint8_t *out, size_t capacity)
+{
+    uint8_t *pos = out;
+    uint8_t *end = out + capacity;
+    uint32_t prev = 0;
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        // Wrapping difference, so any pair of int32 values round trips.
+        uint32_t delta = (uint32_t) samples[i] - prev;
+        uint32_t zigzag = (delta << 1) ^ (uint32_t) ((int32_t) delta >> 31);
+        prev = (uint32_t) samples[i];
+        
+        if (end - pos < 5)
+        {
+            // Close to the end - check each byte.
+            do
+            {
+                if (pos == end)
+                {
+                    return 0;
+                }
+                *pos++ = (uint8_t) (zigzag | (zigzag > 0x7F ? 0x80 : 0));
+                zigzag >>= 7;
+            } while (zigzag != 0);
+            continue;
+        }
+        while (zigzag > 0x7F)
+        {
+            *pos++ = (uint8_t) (zigzag | 0x80);
+            zigzag >>= 7;
+        }
+        *pos++ = (uint8_t) zigzag;
+    }
+    return pos - out;
+}
+
+size_t delta_varint_decode(const uint8_t *in, size_t len, int32_t *samples, size_t count)
+{
+    const uint8_t *pos = in;
+    const uint8_t *end = in + len;
+    uint32_t prev = 0;
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t zigzag = 0;
+        int shift = 0;
+        uint8_t byte;
+        
+        do
+        {
+            if (pos == end || shift > 28)
+            {
+                return 0;
+            }
+            byte = *pos++;
+            // The fifth byte holds the top 4 bits; more would not fit.
+            if (shift == 28 && (byte & 0x70))
+            {
+                return 0;
+            }
+            zigzag |= (uint32_t) (byte & 0x7F) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        
+        prev += (zigzag >> 1) ^ (0u - (zigzag & 1));
+        samples[i] = (int32_t) prev;
+    }
+    return pos - in;
+}
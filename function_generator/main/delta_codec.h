@@ -0,0 +1,32 @@
+/* Delta Codec
+
+   Zigzag-delta varint coding for sample blocks. The first sample is coded
+   as a delta from zero (the base value) and every following sample as the
+   signed difference from its predecessor. Each delta is zigzag mapped so
+   small negative and positive steps both give small numbers, then written
+   7 bits per byte, least significant group first, with the top bit set on
+   all but the last byte.
+
+   A stream of consecutive counters codes to one byte per sample.
+
+   No ESP-IDF dependencies; shared with the host-side tools.
+*/
+#ifndef DELTA_CODEC_H
+#define DELTA_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest possible encoding of 'count' samples.
+#define DELTA_VARINT_MAX_SIZE(count) ((count) * 5)
+
+// Encodes 'count' samples into 'out'. Returns the number of bytes written,
+// or 0 if the result would not fit in 'capacity'.
+size_t delta_varint_encode(const int32_t *samples, size_t count, uint8_t *out, size_t capacity);
+
+// Decodes exactly 'count' samples from 'in'. Returns the number of bytes
+// consumed, or 0 if 'in' is truncated or malformed, including a varint
+// holding more than 32 bits.
+size_t delta_varint_decode(const uint8_t *in, size_t len, int32_t *samples, size_t count);
+
+#endif // DELTA_CODEC_H
@@ -0,0 +1,26 @@
+/* Edge Records
+
+   See edge_record.h.
+*/
+#include "edge_record.h"
+
+size_t edge_record_decode(const int32_t *records, size_t count, uint64_t anchor, edge_time_t *edges)
+{
+    uint64_t cycles = anchor;
+    size_t edgeCount = 0;
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t record = (uint32_t) records[i];
+    
+        cycles += record >> 1;
+        if ((record >> 1) == EDGE_RECORD_DELTA_MAX)
+        {
+            continue;   // Gap record.
+        }
+        edges[edgeCount].cycles = cycles;
+        edges[edgeCount].level = record & 1;
+        edgeCount++;
+    }
+    return edgeCount;
+}
@@ -0,0 +1,49 @@
+/* Edge Records
+
+   Per-edge timing for the edge-time sample format. Each sample is one 32
+   bit record:
+
+     bits 31..1  CPU cycles since the previous record
+     bit 0       pin level just after the edge
+
+   A block holds the edges of one capture channel, given in the block
+   header, so the record does not say which pin the edge was on.
+
+   The first record's delta is measured from the block's anchor, the 64 bit
+   cycle count carried in the block header (see WIRE_FLAG_EDGE_TIME), so an
+   edge's absolute time is the anchor plus the sum of the deltas up to and
+   including its record.
+
+   An interval too long for 31 bits is carried by gap records: a delta of
+   EDGE_RECORD_DELTA_MAX with the level bit clear, standing for
+   that many cycles and no edge. Edge records always have a smaller delta.
+
+   No ESP-IDF dependencies; shared with the host-side tools.
+*/
+#ifndef EDGE_RECORD_H
+#define EDGE_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EDGE_RECORD_DELTA_MAX 0x7FFFFFFFu
+#define EDGE_RECORD_GAP ((int32_t) (EDGE_RECORD_DELTA_MAX << 1))
+
+typedef struct
+{
+    uint64_t cycles;    // Absolute CPU cycle count of the edge.
+    uint8_t level;      // Pin level just after the edge.
+} edge_time_t;
+
+// 'delta' must be less than EDGE_RECORD_DELTA_MAX.
+static inline int32_t edge_record_pack(uint32_t delta, unsigned level)
+{
+    return (int32_t) ((delta << 1) | (level & 1));
+}
+
+// Decodes 'count' records measured from 'anchor' into 'edges', which must
+// have room for 'count' entries. Returns the number of edges; gap records
+// produce none.
+size_t edge_record_decode(const int32_t *records, size_t count, uint64_t anchor, edge_time_t *edges);
+
+#endif // EDGE_RECORD_H
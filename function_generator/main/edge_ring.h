@@ -0,0 +1,92 @@
+/* Edge Ring
+
+   Lock-free single-producer/single-consumer ring of GPIO edge events.
+
+   The producer is the GPIO ISR and the consumer is SignalReceiverTask. Each
+   side owns exactly one index: the ISR only ever stores 'head' and the task
+   only ever stores 'tail', so a push is a couple of loads, one event write
+   and one index store - no kernel call and no critical section.
+
+   When the ring is full the ISR drops the edge and counts it in 'overruns'
+   rather than overwriting data the task has not yet read.
+*/
+#ifndef EDGE_RING_H
+#define EDGE_RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sdkconfig.h"
+
+#define EDGE_RING_SIZE CONFIG_EDGE_RING_SIZE
+
+_Static_assert((EDGE_RING_SIZE & (EDGE_RING_SIZE - 1)) == 0,
+               "CONFIG_EDGE_RING_SIZE must be a power of two");
+
+typedef struct
+{
+    uint32_t ccount;    // CPU cycle count when the ISR ran.
+    uint16_t gpio;      // GPIO number the edge arrived on.
+    uint16_t level;     // Pin level when the ISR ran.
+} edge_event_t;
+
+typedef struct
+{
+    volatile uint32_t head;      // Written by the ISR only.
+    volatile uint32_t tail;      // Written by the task only.
+    volatile uint32_t overruns;  // Edges dropped because the ring was full. ISR only.
+    edge_event_t events[EDGE_RING_SIZE];
+} edge_ring_t;
+
+/* Producer side - must stay inlined so it runs from IRAM inside the ISR. */
+static inline __attribute__((always_inline))
+bool edge_ring_push(edge_ring_t *ring, uint32_t gpio, uint32_t level, uint32_t ccount)
+{
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    if (head - tail >= EDGE_RING_SIZE)
+    {
+        ring->overruns++;
+        return false;
+    }
+    edge_event_t *event = &ring->events[head & (EDGE_RING_SIZE - 1)];
+    event->ccount = ccount;
+    event->gpio = gpio;
+    event->level = level;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/* Consumer side. */
+
+// Number of events waiting to be read.
+static inline size_t edge_ring_count(const edge_ring_t *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail;
+}
+
+// Returns the number of events that can be read contiguously from *span
+// (i.e. up to the wrap point). Call edge_ring_release() once processed.
+static inline size_t edge_ring_span(const edge_ring_t *ring, const edge_event_t **span)
+{
+    uint32_t tail = ring->tail;
+    size_t count = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+    size_t index = tail & (EDGE_RING_SIZE - 1);
+
+    if (count > EDGE_RING_SIZE - index)
+    {
+        count = EDGE_RING_SIZE - index;
+    }
+    *span = &ring->events[index];
+    return count;
+}
+
+// Hands 'count' slots back to the ISR.
+static inline void edge_ring_release(edge_ring_t *ring, size_t count)
+{
+    __atomic_store_n(&ring->tail, ring->tail + (uint32_t) count, __ATOMIC_RELEASE);
+}
+
+#endif // EDGE_RING_H
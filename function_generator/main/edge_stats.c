@@ -0,0 +1,122 @@
+/* Edge Statistics
+
+   See edge_stats.h.
+*/
+#include <string.h>
+
+#include "edge_stats.h"
+
+static void reset_window(edge_stats_t *stats)
+{
+    stats->periods = 0;
+    stats->missing = 0;
+    stats->edgeInWindow = false;
+    stats->min = UINT32_MAX;
+    stats->max = 0;
+    stats->mean = 0.0;
+    stats->m2 = 0.0;
+}
+
+void edge_stats_init(edge_stats_t *stats, uint32_t channel, uint64_t windowCycles, uint64_t start)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->channel = channel;
+    stats->windowCycles = windowCycles;
+    stats->windowStart = start;
+    reset_window(stats);
+}
+
+/*
+  Summarises the current window and moves on to the window containing
+  'cycles'. Returns false if the summary is suppressed as a repeat empty
+  window.
+ */
+static bool close_window(edge_stats_t *stats, uint64_t cycles, edge_summary_t *summary)
+{
+    bool empty = (stats->periods == 0 && stats->missing == 0);
+    bool report = !(empty && stats->quiet);
+    
+    if (report)
+    {
+        summary->start = stats->windowStart;
+        summary->channel = stats->channel;
+        summary->periods = stats->periods;
+        summary->missing = stats->missing;
+        summary->min = stats->periods ? stats->min : 0;
+        summary->max = stats->max;
+        summary->mean = (float) stats->mean;
+        summary->variance = (stats->periods > 1) ? (float) (stats->m2 / stats->periods) : 0.0f;
+    }
+    
+    // Edges that all counted as missing mean the signal has slowed; learn its
+    // period again. A window with no edges leaves it, so the first edge after
+    // a dropout counts the edges lost in it, however many windows it spans.
+    if (stats->periods != 0)
+    {
+        stats->expected = (uint32_t) stats->mean;
+    }
+    else if (stats->edgeInWindow)
+    {
+        stats->expected = 0;
+    }
+    uint64_t windows = (cycles - stats->windowStart) / stats->windowCycles;
+    stats->quiet = empty;
+    stats->windowStart += windows * stats->windowCycles;
+    reset_window(stats);
+    return report;
+}
+
+bool edge_stats_add(edge_stats_t *stats, uint64_t cycles, edge_summary_t *summary)
+{
+    bool closed = false;
+    
+    // An edge from before the window (possible once edge_stats_close() has
+    // moved on) is counted in the current window.
+    if (cycles > stats->windowStart && cycles - stats->windowStart >= stats->windowCycles)
+    {
+        closed = close_window(stats, cycles, summary);
+    }
+    
+    if (stats->haveEdge)
+    {
+        uint64_t period = cycles - stats->lastEdge;
+        uint32_t expected = stats->expected;
+    
+        if (expected != 0 && period > expected + expected / 2)
+        {
+            uint64_t missing = (period + expected / 2) / expected - 1;
+            stats->missing += (missing > UINT32_MAX - stats->missing) ? UINT32_MAX - stats->missing
+                                                                         : (uint32_t) missing;
+        }
+        else
+        {
+            uint32_t value = (period > UINT32_MAX) ? UINT32_MAX : (uint32_t) period;
+            double delta = (double) value - stats->mean;
+    
+            stats->periods++;
+            stats->mean += delta / stats->periods;
+            stats->m2 += delta * ((double) value - stats->mean);
+            if (value < stats->min)
+            {
+                stats->min = value;
+            }
+            if (value > stats->max)
+            {
+                stats->max = value;
+            }
+        }
+    }
+    stats->lastEdge = cycles;
+    stats->haveEdge = true;
+    stats->edgeInWindow = true;
+    return closed;
+}
+
+bool edge_stats_close(edge_stats_t *stats, uint64_t now, edge_summary_t *summary)
+{
+    if (now <= stats->windowStart || now - stats->windowStart < stats->windowCycles)
+    {
+        return false;
+    }
+    return close_window(stats, now, summary);
+}
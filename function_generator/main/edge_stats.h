@@ -0,0 +1,84 @@
+/* Edge Statistics
+
+   Windowed frequency/period statistics for one capture channel, computed as
+   the edges arrive in O(1) memory.
+
+   Time is divided into fixed windows of 'windowCycles' CPU cycles. Each
+   rising edge ends a period (the time since the previous rising edge),
+   which is counted in the window the edge falls in. When a window ends a
+   summary is produced with the number of periods, their min, max, mean and
+   variance (Welford's method, in double precision), and the number of edges
+   that appear to be missing.
+
+   An edge is treated as missing when a period is more than 1.5 times the
+   expected period, the mean of the last window with periods in it. Such a
+   period is left out of the statistics and counted as
+   round(period / expected) - 1 missing edges instead. The chain of periods
+   runs on across windows with no edges in them, so a period longer than a
+   window is measured, and a dropout of several windows is counted as the
+   edges lost in it. Until a period is known, and again after a window
+   whose edges were all taken as missing (the signal has slowed), the next
+   period is measured whatever its length and sets the expected period.
+
+   A window with no periods still produces a summary, but a run of empty
+   windows produces only the first; the next summary's start time shows
+   how long the signal was absent.
+
+   No ESP-IDF dependencies; shared with the host-side tools.
+*/
+#ifndef EDGE_STATS_H
+#define EDGE_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct __attribute__((packed))
+{
+    uint64_t start;         // Window start, absolute CPU cycles.
+    uint32_t channel;       // Capture channel.
+    uint32_t periods;       // Periods measured in the window.
+    uint32_t missing;       // Edges estimated missing.
+    uint32_t min;           // Shortest period, cycles.
+    uint32_t max;           // Longest period, cycles.
+    float mean;             // Mean period, cycles.
+    float variance;         // Period variance, cycles^2.
+} edge_summary_t;
+
+// Summaries are sent as whole int32 samples.
+#define EDGE_SUMMARY_WORDS (sizeof(edge_summary_t) / sizeof(int32_t))
+
+_Static_assert(sizeof(edge_summary_t) % sizeof(int32_t) == 0,
+               "edge_summary_t must be a whole number of samples");
+
+typedef struct
+{
+    uint64_t windowCycles;
+    uint64_t windowStart;
+    uint64_t lastEdge;
+    bool haveEdge;
+    bool edgeInWindow;      // An edge has arrived in the current window.
+    bool quiet;             // The last window closed was empty.
+    uint32_t channel;
+    uint32_t expected;      // Period for missing-edge detection; 0 until known.
+    uint32_t periods;
+    uint32_t missing;
+    uint32_t min;
+    uint32_t max;
+    // Double: periods are cycle counts, so their squares are far beyond a
+    // float's 24 bit mantissa.
+    double mean;
+    double m2;              // Sum of squared differences from the mean.
+} edge_stats_t;
+
+// Starts the first window at 'start'.
+void edge_stats_init(edge_stats_t *stats, uint32_t channel, uint64_t windowCycles, uint64_t start);
+
+// Adds a rising edge. Edges must be added in time order. Returns true and
+// fills in 'summary' if the edge ended the previous window.
+bool edge_stats_add(edge_stats_t *stats, uint64_t cycles, edge_summary_t *summary);
+
+// Ends the current window if 'now' is past it, so windows close even when
+// no edges arrive. Returns true and fills in 'summary' if one was produced.
+bool edge_stats_close(edge_stats_t *stats, uint64_t now, edge_summary_t *summary);
+
+#endif // EDGE_STATS_H
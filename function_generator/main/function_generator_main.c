@@ -13,6 +13,7 @@
 #include "nvs_flash.h"
 #include "esp_wifi.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_http_server.h"
 #include "tcpip_adapter.h"
 
@@ -22,7 +23,20 @@
 #include <lwip/netdb.h>
 #include <fcntl.h>
 
-#define PORT 23
+#include "capture.h"
+#include "capture_bench.h"
+#include "signal_gen.h"
+#include "sample_pool.h"
+#include "wire_format.h"
+#include "base85.h"
+#include "stream_server.h"
+#include "conn_manager.h"
+#include "edge_record.h"
+#include "edge_stats.h"
+#include "stats.h"
+#include "trace.h"
+
+#define PORT CONFIG_STREAM_PORT
 #define WIFI_MAXIMUM_RETRY 5
 #define MAX_WIFI_CONNECTION_ATTEMPTS 25
 
@@ -32,47 +46,43 @@
 
 #define CORE0 0
 #define CORE1 1
-#define BUFFER_SIZE 5000 // Size of double buffer for data compilation. This value will need to be calibrated.
-#define ASCII_BUFFER_SIZE BUFFER_SIZE*5 // Buffer for Ascii85 data tx.
+
+// Capture (the GPIO ISR and SignalReceiverTask) and the network stack each
+// get a core of their own.
+#if CONFIG_FREERTOS_UNICORE
+#define CAPTURE_CORE CORE0
+#define NETWORK_CORE CORE0
+#else
+#define CAPTURE_CORE CONFIG_CAPTURE_TASK_CORE
+#define NETWORK_CORE CONFIG_NETWORK_TASK_CORE
+#endif
 
 /*
-  This set-up caters for two generators (GPIO 18 & 19) and two Reveivers (GPIO 4 & 5)
-  However we are ony using GPIO 18 & GPIO 4.
+  This set-up caters for two generators (GPIO 18 & 19), driven by the
+  signal generator - see signal_gen.h. The receivers, one per capture
+  channel (GPIO 4 & 5 by default), are set up by the capture backend - see
+  capture.h.
  */
 #define GPIO_OUTPUT_IO_0 18
 #define GPIO_OUTPUT_IO_1 19
 #define GPIO_OUTPUT_PIN_SEL ((1ULL<<GPIO_OUTPUT_IO_0) | (1ULL<<GPIO_OUTPUT_IO_1))
-#define GPIO_INPUT_IO_0 4
-#define GPIO_INPUT_IO_1 5
-#define GPIO_INPUT_PIN_SEL ((1ULL<<GPIO_INPUT_IO_0) | (1ULL<<GPIO_INPUT_IO_1))
-#define ESP_INTR_FLAG_DEFAULT 0
 
 
 static const char* TAG = "wifi function_generator";
 
-int buffers[2][BUFFER_SIZE];
-
-static int listen_socket;
-static int telnet_socket;
 static bool wifiConnected = false;
-static bool telnetClientConnected = false;
 
-//static TaskHandle_t taskSignalGenerator;
 static TaskHandle_t taskSignalReceiver;
 // static TaskHandle_t taskDataCompilation;
-static TaskHandle_t taskDataTransmission;
-static TaskHandle_t taskSocketListenConnect;
+static TaskHandle_t taskNetwork;
+#if CONFIG_CAPTURE_BENCHMARK
+static TaskHandle_t taskCaptureBench;
+#endif
 
 void SignalReceiverTask (void *pvParameters);
-// void SignalGeneratorTask (void *pvParameters);
 // void DataCompilationTask (void *pvParameters);
-void DataTransmissionTask (void *pvParameters);
-
-void SocketListenConnectTask (void *pvParameters);
-
-static xQueueHandle gpio_evt_queue = NULL;
-
-uint32_t dataBuffers[2][BUFFER_SIZE];
+void NetworkTask (void *pvParameters);
+void CaptureBenchTask (void *pvParameters);
 
 /* The event group allows multiple bits for each event, but we only care about one event
  * - are we connected to the AP and do we have an IP? */
@@ -82,26 +92,13 @@ const int WIFI_CONNECTED_BIT = BIT0;
 static EventGroupHandle_t s_wifi_event_group;
 static int s_retry_num = 0;
 
-void socketCreation ()
-{
-        printf (">> socketCreation \n");
-        xTaskCreatePinnedToCore (SocketListenConnectTask,
-                                 "SocketListenConnectTask",
-                                 4096,
-                                 NULL,
-                                 0,
-                                 &taskSocketListenConnect,
-                                 CORE0);
-    printf ("<< socketCreation \n");
-}
-
-
 static void event_handler(void* arg, esp_event_base_t event_base,
                           int32_t event_id, void* event_data)
 {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        conn_manager_wifi_down();
         if (s_retry_num < WIFI_MAXIMUM_RETRY) {
             esp_wifi_connect();
             xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
@@ -116,9 +113,10 @@ static void event_handler(void* arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "IP Address: %s", ip4addr_ntoa(&event->ip_info.ip));
         s_retry_num = 0;
         xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-        
-        // Open Telnet, then trigger listening for client.
-        socketCreation();;
+        conn_manager_wifi_up();
+    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_LOST_IP) {
+        ESP_LOGI(TAG, "lost ip");
+        conn_manager_wifi_down();
     }
 }
 
@@ -130,7 +128,7 @@ void wifi_setup()
     
     tcpip_adapter_init();
     esp_event_loop_create_default();
-
+    
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
     
@@ -147,6 +145,12 @@ void wifi_setup()
                                                IP_EVENT_STA_GOT_IP,
                                                &event_handler,
                                                NULL));
+    ESP_ERROR_CHECK(
+                    esp_event_handler_register(
+                                               IP_EVENT,
+                                               IP_EVENT_STA_LOST_IP,
+                                               &event_handler,
+                                               NULL));
     
     wifi_config_t wifi_config = {
         .sta = {
@@ -168,12 +172,6 @@ void wifi_setup()
 }
 
 
-static void IRAM_ATTR gpio_isr_handler(void* arg)
-{
-    uint32_t gpio_num = (uint32_t) arg;
-    xQueueSendFromISR(gpio_evt_queue, &gpio_num, NULL);
-}
-
 static void gpio_setup()
 {
     printf (">> gpio_setup \n");
@@ -191,41 +189,73 @@ static void gpio_setup()
     io_conf.pull_up_en = 0;
     //configure GPIO with the given settings
     gpio_config(&io_conf);
-    //interrupt of rising edge
-    io_conf.intr_type = GPIO_PIN_INTR_POSEDGE;
-    //bit mask of the pins, use GPIO4/5 here
-    io_conf.pin_bit_mask = GPIO_INPUT_PIN_SEL;
-    //set as input mode
-    io_conf.mode = GPIO_MODE_INPUT;
-    //enable pull-up mode
-    io_conf.pull_up_en = 1;
-    gpio_config(&io_conf);
-    //change gpio intrrupt type for one pin
-    gpio_set_intr_type(GPIO_INPUT_IO_0, GPIO_INTR_ANYEDGE);
-    //create a queue to handle gpio event from isr
-    gpio_evt_queue = xQueueCreate(10, sizeof(uint32_t));
     //gpio task - now started with other tasks.
     // xTaskCreate(signalGenerator, "gpio_task_example", 2048, NULL, 10, NULL);
-    //install gpio isr service
-    gpio_install_isr_service(ESP_INTR_FLAG_DEFAULT);
-    //hook isr handler for specific gpio pin
-    gpio_isr_handler_add(GPIO_INPUT_IO_0, gpio_isr_handler, (void*) GPIO_INPUT_IO_0);
-    
-    //hook isr handler for specific gpio pin
-    gpio_isr_handler_add(GPIO_INPUT_IO_1, gpio_isr_handler, (void*) GPIO_INPUT_IO_1);
-    //remove isr handler for gpio number.
-    gpio_isr_handler_remove(GPIO_INPUT_IO_0);
-    //hook isr handler for specific gpio pin again
-    gpio_isr_handler_add(GPIO_INPUT_IO_0, gpio_isr_handler, (void*) GPIO_INPUT_IO_0);
+    
+    //receiver pins are owned by the capture backend, started by SignalReceiverTask
+    printf ("Capture backend: %s\n", capture_backend.name);
     
     printf ("<< gpio_setup \n");
 }
 
 
+#if CONFIG_SIGNAL_GEN_ENABLE
+// Starts the test signal chosen in menuconfig on output 0.
+static void start_test_signal(void)
+{
+    signal_config_t config = {
+#if CONFIG_SIGNAL_GEN_SOURCE_SOFT
+        .source = SIGNAL_SOURCE_SOFT,
+        .target = CONFIG_SIGNAL_GEN_CHANNEL,
+#elif CONFIG_SIGNAL_GEN_SOURCE_RMT
+        .source = SIGNAL_SOURCE_RMT,
+        .target = CONFIG_SIGNAL_GEN_GPIO,
+#else
+        .source = SIGNAL_SOURCE_LEDC,
+        .target = CONFIG_SIGNAL_GEN_GPIO,
+#endif
+        .frequency = CONFIG_SIGNAL_GEN_FREQUENCY_HZ,
+        .dutyPercent = CONFIG_SIGNAL_GEN_DUTY_PERCENT,
+#if !CONFIG_SIGNAL_GEN_SOURCE_RMT
+        .sweepTo = CONFIG_SIGNAL_GEN_SWEEP_TO_HZ,
+        .sweepMs = CONFIG_SIGNAL_GEN_SWEEP_MS,
+#endif
+#if !CONFIG_SIGNAL_GEN_SOURCE_LEDC
+        .burstPulses = CONFIG_SIGNAL_GEN_BURST_PULSES,
+        .burstIntervalMs = CONFIG_SIGNAL_GEN_BURST_INTERVAL_MS,
+#endif
+    };
+    
+    signal_gen_start(0, &config);
+}
+#endif
+
+// Logs the settings the network profile is about, and warns if the
+// high-throughput profile was chosen without sdkconfig.throughput applied.
+static void log_network_profile(void)
+{
+    ESP_LOGI(TAG, "Network: CPU %d MHz, tick %d Hz, TCP send buffer %d bytes, window %d bytes",
+             CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ, CONFIG_FREERTOS_HZ,
+             CONFIG_LWIP_TCP_SND_BUF_DEFAULT, CONFIG_LWIP_TCP_WND_DEFAULT);
+#if CONFIG_STREAM_PROFILE_THROUGHPUT
+    if (CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ < 240 || CONFIG_FREERTOS_HZ < 1000 ||
+        CONFIG_LWIP_TCP_SND_BUF_DEFAULT < 32768)
+    {
+        ESP_LOGW(TAG, "High-throughput network profile chosen, but sdkconfig.throughput "
+                 "was not applied - see the README");
+    }
+#endif
+}
+
+
 void app_main()
 {
     printf("Function Generator\n");
     
+#if CONFIG_TRACE_ENABLE
+    trace_init();
+#endif
+    
     //Initialize NVS
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -235,32 +265,31 @@ void app_main()
     ESP_ERROR_CHECK(ret);
     
     ESP_LOGI(TAG, "ESP_WIFI_MODE_STA");
+    log_network_profile();
     
     wifi_setup();
     
+    sample_pool_init();
+    stream_server_init();
+#if CONFIG_BASE85_KERNEL_LUT2
+    base85_init();
+#endif
+    
     gpio_setup();
     {
-        
+    
     }
     
-    // Now set up tasks to run independently.
-    /*
-    xTaskCreatePinnedToCore (SignalGeneratorTask,
-                             "SignalGeneratorTask",  // A name just for humans
-                             2048,  // This stack size can be checked & adjusted by reading the Stack Highwater
-                             NULL,
-                             10, // ISR has highest priority.
-                             &taskSignalGenerator,
-                             CORE0);
-    */
-    // Now set up tasks to run independently.
+    // Now set up tasks to run independently. The only traffic between the
+    // capture and network cores is one queued pointer and one wake-up per
+    // filled block.
     xTaskCreatePinnedToCore (SignalReceiverTask,
                              "SignalReceiverTask",  // A name just for humans
                              2048,  // This stack size can be checked & adjusted by reading the Stack Highwater
                              NULL,
                              10, // ISR has highest priority.
                              &taskSignalReceiver,
-                             CORE0);
+                             CAPTURE_CORE);
     /*
     xTaskCreatePinnedToCore (DataCompilationTask,
                             "DataCompilationTask",
@@ -270,87 +299,220 @@ void app_main()
                             &taskDataCompilation,
                             CORE1);
     */
-    // Data Transmission executes on Core 0
-    xTaskCreatePinnedToCore (DataTransmissionTask,
-                            "DataTransmissionTask",
-                            32768,
+    // Network (listening, clients and transmission) executes alongside the WiFi driver
+    xTaskCreatePinnedToCore (NetworkTask,
+                            "NetworkTask",
+                            4096,
                             NULL,
                             3,
-                            &taskDataTransmission,
-                            CORE0);
-
+                            &taskNetwork,
+                            NETWORK_CORE);
+    stats_register_task(taskSignalReceiver);
+    stats_register_task(taskNetwork);
+#if CONFIG_SIGNAL_GEN_ENABLE
+    start_test_signal();
+#endif
+#if CONFIG_CAPTURE_BENCHMARK
+    xTaskCreatePinnedToCore (CaptureBenchTask,
+                            "CaptureBenchTask",
+                            3072,
+                            NULL,
+                            2,
+                            &taskCaptureBench,
+                            NETWORK_CORE);
+#endif
+    
 }
 
 /*--------------------------------------------------*/
 /*---------------------- Tasks ---------------------*/
 /*--------------------------------------------------*/
-#define PAUSE_COUNT 1000
+
+#if CONFIG_STREAM_CONTENT_SUMMARIES
+#define CPU_MHZ CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ
+#define SUMMARY_BATCH 64    // Edge records decoded per pass.
+
+// Every edge in a batch can close a window, plus one time-driven close.
+_Static_assert((SUMMARY_BATCH + 1) * EDGE_SUMMARY_WORDS <= SAMPLE_BLOCK_SIZE,
+               "CONFIG_SAMPLE_BLOCK_SIZE is too small to hold a batch of summaries");
+
+static edge_stats_t edgeStats[CAPTURE_CHANNELS];
+static int32_t records[SUMMARY_BATCH];
+static edge_time_t edgeTimes[SUMMARY_BATCH];
+
+static void append_summary(sample_block_t *block, const edge_summary_t *summary)
+{
+    memcpy(&block->samples[block->count], summary, sizeof(*summary));
+    block->count += EDGE_SUMMARY_WORDS;
+}
+
 /*
-void SignalGeneratorTask(void *pvParameters)
+  Reads a batch of the channel's edge records and reduces the rising edges
+  to window summaries, appended to the block. A channel that only
+  interrupts on rising edges counts all of its edges. Returns the number of
+  records read.
+ */
+static size_t summarise_edges(int channel, sample_block_t *block)
 {
-    (void) pvParameters;
+    static bool started = false;
+    edge_stats_t *stats = &edgeStats[channel];
+    bool anyEdge = capture_channels[channel].anyEdge;
+    edge_summary_t summary;
     
-    uint32_t dataValue = 0;
-    uint32_t inData = 0;
-    int pauseCt = 0;
+    if (!started)
+    {
+        for (int i = 0; i < CAPTURE_CHANNELS; i++)
+        {
+            edge_stats_init(&edgeStats[i], i,
+                            (uint64_t) CONFIG_STREAM_SUMMARY_WINDOW_MS * 1000 * CPU_MHZ,
+                            capture_backend.time_base(i));
+        }
+        started = true;
+    }
     
-    vTaskDelay(1);  // Ensure all tasks are up and running before we commence
-    while(1)
+    uint64_t anchor = capture_backend.time_base(channel);
+    size_t read = capture_backend.read(channel, records, SUMMARY_BATCH);
+    size_t edges = edge_record_decode(records, read, anchor, edgeTimes);
+    for (size_t i = 0; i < edges; i++)
     {
-        dataValue++;
-        pauseCt++;
-        gpio_set_level(GPIO_OUTPUT_IO_0, dataValue % 2);
-        gpio_set_level(GPIO_OUTPUT_IO_1, dataValue % 2);
-        xTaskNotifyWait(0, 0, &inData, 10000);
-        if (pauseCt == PAUSE_COUNT) // Need to relinquish CPU every now and then
+        const edge_time_t *edge = &edgeTimes[i];
+        if ((edge->level || !anyEdge) &&
+            edge_stats_add(stats, edge->cycles, &summary))
         {
-            vTaskDelay(1);
-            pauseCt = 0;
+            append_summary(block, &summary);
         }
     }
+    
+    // Close a window the signal has gone quiet in, allowing for edges still
+    // waiting in the edge ring.
+    uint64_t now = (uint64_t) (esp_timer_get_time() - CONFIG_CAPTURE_DRAIN_TIMEOUT_MS * 1000) * CPU_MHZ;
+    if (edge_stats_close(stats, now, &summary))
+    {
+        append_summary(block, &summary);
+    }
+    return read;
 }
- */
+#endif
 
+/*
+  Fills one block per capture channel. Each pass waits for the backend to
+  have a batch ready, then drains every channel into its own block; a full
+  block is handed to the stream server and the channel carries on in a
+  fresh one.
+ */
 void SignalReceiverTask(void *pvParameters)
 {
     (void) pvParameters;
     
-    int32_t signalCt = 0;
-    uint32_t io_num;
-    // uint32_t inData = 0;
+    uint32_t overruns[CAPTURE_CHANNELS] = { 0 };
+    uint32_t dropped = 0;
+    uint32_t shed = 0;
+    TickType_t drainTimeout = pdMS_TO_TICKS(CONFIG_CAPTURE_DRAIN_TIMEOUT_MS);
+    sample_block_t *blocks[CAPTURE_CHANNELS];
     
-    int buff = 0;
-    int prevBuff = 1;
-    int count = 0;
+#if CONFIG_CAPTURE_THROUGHPUT_LOG
+    uint32_t samples = 0;
+    uint32_t drains = 0;
+    TickType_t logTime = xTaskGetTickCount();
+#endif
     
-    int pauseCt = 0;
+    if (drainTimeout == 0)
+    {
+        drainTimeout = 1;
+    }
     
     vTaskDelay(1);  // Ensure all tasks are up and running before we commence
+    
+    // Installed from here so the capture interrupts are serviced on this core.
+    capture_backend.init();
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        blocks[channel] = sample_pool_first();
+    }
     while(1)
     {
-        pauseCt++;
-        // if (xQueueReceive(gpio_evt_queue, &io_num, portMAX_DELAY))
-        if (xQueueReceive(gpio_evt_queue, &io_num, 5))
+        size_t read = 0;
+        bool submitted = false;
+    
+        capture_backend.wait(drainTimeout);
+        TRACE_SYNC();
+        for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
         {
-            buffers[buff][count++] = signalCt++;
-            
-            if (count >= BUFFER_SIZE)
+            sample_block_t *block = blocks[channel];
+    
+            block->channel = channel;
+#if CONFIG_STREAM_CONTENT_SUMMARIES
+            block->timestamp = esp_timer_get_time();
+            read += summarise_edges(channel, block);
+#else
+            bool first = (block->count == 0);
+#if CONFIG_CAPTURE_FORMAT_EDGE_TIME
+            if (first)
             {
-                count = 0;
-                prevBuff = buff;
-                buff = 1 - buff;
-                xTaskNotify(taskDataTransmission, prevBuff, eSetValueWithOverwrite);
+                // The block's records are measured from here.
+                block->timestamp = capture_backend.time_base(channel);
+            }
+#endif
+            size_t channelRead = capture_backend.read(channel, &block->samples[block->count],
+                                                      SAMPLE_BLOCK_SIZE - block->count);
+#if !CONFIG_CAPTURE_FORMAT_EDGE_TIME
+            if (first)
+            {
+                block->timestamp = esp_timer_get_time();
+            }
+#endif
+            block->count += channelRead;
+            read += channelRead;
+#endif
+    
+#if CONFIG_STREAM_CONTENT_SUMMARIES
+            // Summaries are few; send them as soon as there are any.
+            if (block->count > 0)
+#else
+            if (block->count >= SAMPLE_BLOCK_SIZE)
+#endif
+            {
+                blocks[channel] = sample_pool_submit(block);
+                submitted = true;
+            }
+    
+            if (capture_backend.overruns(channel) != overruns[channel])
+            {
+                ESP_LOGW(TAG, "Capture overrun on channel %d: %u edges lost", channel,
+                         capture_backend.overruns(channel) - overruns[channel]);
+                overruns[channel] = capture_backend.overruns(channel);
             }
-            //xTaskNotify(taskSignalGenerator, inData, eSetValueWithOverwrite);
         }
-        else
+        if (submitted)
         {
-            printf("No data received\n");
+            stream_server_wake();
         }
-        if (pauseCt == PAUSE_COUNT) // Need to relinquish CPU every now and then
+    
+#if CONFIG_CAPTURE_THROUGHPUT_LOG
+        if (read > 0)
         {
-            vTaskDelay(1);
-            pauseCt = 0;
+            samples += read;
+            drains++;
+        }
+        if (xTaskGetTickCount() - logTime >= pdMS_TO_TICKS(1000))
+        {
+            ESP_LOGI(TAG, "Capture: %u samples/s, %u drains/s, %u samples/drain",
+                     samples, drains, drains ? samples / drains : 0);
+            samples = 0;
+            drains = 0;
+            logTime += pdMS_TO_TICKS(1000);
+        }
+#endif
+    
+        if (sample_pool_dropped() != dropped)
+        {
+            ESP_LOGW(TAG, "Sample pool exhausted: %u blocks dropped", sample_pool_dropped() - dropped);
+            dropped = sample_pool_dropped();
+        }
+        if (sample_pool_shed() != shed)
+        {
+            ESP_LOGW(TAG, "Clients backed up: %u blocks shed", sample_pool_shed() - shed);
+            shed = sample_pool_shed();
         }
     }
     
@@ -371,7 +533,7 @@ void DataCompilationTask(void *pvParameters)
     {
         xTaskNotifyWait(0, 0, &inData, 1000);
         buffers[buff][count++] = inData;
-        
+    
         if (count >= BUFFER_SIZE)
         {
             pauseCt++;
@@ -379,7 +541,7 @@ void DataCompilationTask(void *pvParameters)
             prevBuff = buff;
             buff = 1 - buff;
             xTaskNotify(taskDataTransmission, prevBuff, eSetValueWithOverwrite);
- 
+    
             // if (pauseCt == PAUSE_COUNT * 2) // Need to relinquish CPU every now and then
             // {
                 // vTaskDelay(1);
@@ -390,114 +552,28 @@ void DataCompilationTask(void *pvParameters)
     }
 }
 */
-void DataTransmissionTask(void *pvParameters)
+/*
+  Owns every socket. The connection manager keeps the listener open while
+  there is an IP address and sleeps in the stream server's select() until
+  there is a connection, client data, send space or a new block to deal with.
+ */
+void NetworkTask(void *pvParameters)
 {
-    uint32_t inData;
-    int iascii;
-    char txData[ASCII_BUFFER_SIZE];
-    
     (void) pvParameters;
     
-    while(1)
-    {
-        xTaskNotifyWait(0, 0, &inData, 10000);
-        //printf("Received buffer: \n");
-        if (wifiConnected && telnetClientConnected)
-        {
-            // printf("Sending data to client from buffer: %d. First number: %d \n", inData, buffers[inData][0]);
-            iascii = 0;
-            for (int i = 0; i<BUFFER_SIZE; i++)
-            {
-                int val = buffers[inData][i];
-                for (int j=0; j<4; j++)
-                {
-                    txData[iascii++] = val % 85 + 33;
-                    val = val / 85;
-                }
-                txData[iascii++] = val + 33;
-            }
-
-            int sent = send(telnet_socket, txData, iascii, 0);
-            if (sent < 0)
-            {
-                ESP_LOGE(TAG, "Error occurred sending data. Error No: %d", sent);
-            }
-        }
-    }
+    conn_manager_run(PORT);
 }
-    
 
-void SocketListenConnectTask (void *pvParamters)
+#if CONFIG_CAPTURE_BENCHMARK
+/*
+  Measures the sustained edge rate once capture is running, then exits.
+ */
+void CaptureBenchTask(void *pvParameters)
 {
-    char addr_str[128];
-    int addr_family;
-    int ip_protocol;
-    
-    struct sockaddr_in dest_addr;
-    
-    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    dest_addr.sin_family = AF_INET;
-    dest_addr.sin_port = htons(PORT);
-    addr_family = AF_INET;
-    ip_protocol = IPPROTO_TCP;
-    inet_ntoa_r(dest_addr.sin_addr, addr_str, sizeof(addr_str)-1);
-    
-    listen_socket = socket(addr_family, SOCK_STREAM, ip_protocol);
-    if (listen_socket < 0)
-    {
-        ESP_LOGE(TAG, "Unable to create socket: Error No: %d", errno);
-        vTaskDelete(NULL);
-    }
-    
-    // Mark socket as non blocking.
-    int status = fcntl(listen_socket, F_SETFL, fcntl(listen_socket, F_GETFL, 0) | O_NONBLOCK);
-    if (status == -1)
-    {
-        ESP_LOGE(TAG, "Error setting non-blocking status: %s", strerror(errno));
-        vTaskDelete(NULL);
-    }
+    (void) pvParameters;
     
-    int err = bind(listen_socket, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-    if (err != 0)
-    {
-        ESP_LOGE(TAG, "Socket unable to bind: Error No: %s", strerror(errno));
-        close(listen_socket);
-        vTaskDelete(NULL);
-    }
-    err = listen(listen_socket, 1);
-    if (err != 0)
-    {
-        ESP_LOGE(TAG, "Socket unable to listen: Error No: %s", strerror(errno));
-        close(listen_socket);
-        vTaskDelete(NULL);
-    }
-    else
-    {
-        bool client_connected = false;
-        
-        // Listening for Client connection.
-        while (!client_connected)
-        {
-            struct sockaddr source_addr;
-            uint addr_len = sizeof(source_addr);
-            telnet_socket = accept(listen_socket, (struct sockaddr *)&source_addr, &addr_len);
-            if (telnet_socket == -1 && errno == EWOULDBLOCK)
-            {
-                ESP_LOGI(TAG, "Awaiting connection");
-                vTaskDelay(100);
-            }
-            else if (telnet_socket < 0)
-            {
-                ESP_LOGE(TAG, "Unable to accept connection %s", strerror(errno));
-                vTaskDelay(100);
-            }
-            else
-            {
-                ESP_LOGI(TAG, "Connected");
-                client_connected = true;
-            }
-        }
-        telnetClientConnected = true;
-    }
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    capture_bench_run(CAPTURE_CORE, NETWORK_CORE);
     vTaskDelete(NULL);
 }
+#endif
@@ -84,6 +84,13 @@ struct telnet_t {
 #if defined(HAVE_ZLIB)
 	/* zlib (mccp2) compression */
 	z_stream *z;
+	/* zlib memory functions and deflate parameters; see telnet_set_zlib() */
+	alloc_func zalloc;
+	free_func zfree;
+	void *zopaque;
+	int zlevel;
+	int zwindow_bits;
+	int zmem_level;
 #endif
 	/* RFC1143 option negotiation states */
 	struct telnet_rfc1143_t *q;
@@ -156,6 +163,14 @@ static telnet_error_t _error(telnet_t *telnet, unsigned line,
 }
 
 #if defined(HAVE_ZLIB)
+/* release a zlib box with whichever allocator it came from */
+static void _free_zlib(telnet_t *telnet, z_stream *z) {
+	if (telnet->zfree != 0)
+		telnet->zfree(telnet->zopaque, z);
+	else
+		free(z);
+}
+
 /* initialize the zlib box for a telnet box; if deflate is non-zero, it
  * initializes zlib for delating (compression), otherwise for inflating
  * (decompression).  returns TELNET_EOK on success, something else on
@@ -171,21 +186,32 @@ telnet_error_t _init_zlib(telnet_t *telnet, int deflate, int err_fatal) {
 				err_fatal, "cannot initialize compression twice");
 
 	/* allocate zstream box */
-	if ((z= (z_stream *)calloc(1, sizeof(z_stream))) == 0)
+	if (telnet->zalloc != 0) {
+		if ((z = (z_stream *)telnet->zalloc(telnet->zopaque, 1,
+				sizeof(z_stream))) != 0)
+			memset(z, 0, sizeof(z_stream));
+	} else
+		z = (z_stream *)calloc(1, sizeof(z_stream));
+	if (z == 0)
 		return _error(telnet, __LINE__, __func__, TELNET_ENOMEM, err_fatal,
 				"malloc() failed: %s", strerror(errno));
+	z->zalloc = telnet->zalloc;
+	z->zfree = telnet->zfree;
+	z->opaque = telnet->zopaque;
 
 	/* initialize */
 	if (deflate) {
-		if ((rs = deflateInit(z, Z_DEFAULT_COMPRESSION)) != Z_OK) {
-			free(z);
+		if ((rs = deflateInit2(z, telnet->zlevel, Z_DEFLATED,
+				telnet->zwindow_bits, telnet->zmem_level,
+				Z_DEFAULT_STRATEGY)) != Z_OK) {
+			_free_zlib(telnet, z);
 			return _error(telnet, __LINE__, __func__, TELNET_ECOMPRESS,
 					err_fatal, "deflateInit() failed: %s", zError(rs));
 		}
 		telnet->flags |= TELNET_PFLAG_DEFLATE;
 	} else {
 		if ((rs = inflateInit(z)) != Z_OK) {
-			free(z);
+			_free_zlib(telnet, z);
 			return _error(telnet, __LINE__, __func__, TELNET_ECOMPRESS,
 					err_fatal, "inflateInit() failed: %s", zError(rs));
 		}
@@ -222,7 +248,7 @@ static void _send(telnet_t *telnet, const char *buffer,
 				_error(telnet, __LINE__, __func__, TELNET_ECOMPRESS, 1,
 						"deflate() failed: %s", zError(rs));
 				deflateEnd(telnet->z);
-				free(telnet->z);
+				_free_zlib(telnet, telnet->z);
 				telnet->z = 0;
 				break;
 			}
@@ -246,7 +272,6 @@ static void _send(telnet_t *telnet, const char *buffer,
 	ev.type = TELNET_EV_SEND;
 	ev.data.buffer = buffer;
 	ev.data.size = size;
-    printf("Sending data uncompressed. Nos bytes: %d \n", size);
 	telnet->eh(telnet, &ev, telnet->ud);
 }
 
@@ -892,6 +917,11 @@ telnet_t *telnet_init(const telnet_telopt_t *telopts,
 	telnet->telopts = telopts;
 	telnet->eh = eh;
 	telnet->flags = flags;
+#if defined(HAVE_ZLIB)
+	telnet->zlevel = Z_DEFAULT_COMPRESSION;
+	telnet->zwindow_bits = MAX_WBITS;
+	telnet->zmem_level = 8;
+#endif /* defined(HAVE_ZLIB) */
 
 	return telnet;
 }
@@ -913,7 +943,7 @@ void telnet_free(telnet_t *telnet) {
 			deflateEnd(telnet->z);
 		else
 			inflateEnd(telnet->z);
-		free(telnet->z);
+		_free_zlib(telnet, telnet->z);
 		telnet->z = 0;
 	}
 #endif /* defined(HAVE_ZLIB) */
@@ -1216,7 +1246,7 @@ void telnet_recv(telnet_t *telnet, const char *buffer,
 
 				/* disable compression */
 				inflateEnd(telnet->z);
-				free(telnet->z);
+				_free_zlib(telnet, telnet->z);
 				telnet->z = 0;
 
 				/* send event */
@@ -1467,6 +1497,29 @@ void telnet_begin_compress2(telnet_t *telnet) {
 #endif /* defined(HAVE_ZLIB) */
 }
 
+/* set the zlib memory functions and deflate parameters */
+void telnet_set_zlib(telnet_t *telnet,
+		void *(*zalloc)(void *opaque, unsigned int items, unsigned int size),
+		void (*zfree)(void *opaque, void *address), void *opaque,
+		int level, int window_bits, int mem_level) {
+#if defined(HAVE_ZLIB)
+	telnet->zalloc = zalloc;
+	telnet->zfree = zfree;
+	telnet->zopaque = opaque;
+	telnet->zlevel = level;
+	telnet->zwindow_bits = window_bits;
+	telnet->zmem_level = mem_level;
+#else
+	(void)telnet;
+	(void)zalloc;
+	(void)zfree;
+	(void)opaque;
+	(void)level;
+	(void)window_bits;
+	(void)mem_level;
+#endif /* defined(HAVE_ZLIB) */
+}
+
 /* send formatted data with \r and \n translation in addition to IAC IAC */
 int telnet_vprintf(telnet_t *telnet, const char *fmt, va_list va) {
 	va_list va_temp;
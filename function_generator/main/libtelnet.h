@@ -506,6 +506,33 @@ extern void telnet_subnegotiation(telnet_t *telnet, unsigned char telopt,
  */
 extern void telnet_begin_compress2(telnet_t *telnet);
 
+/*!
+ * \brief Set how COMPRESS2 allocates and configures its zlib stream.
+ *
+ * By default the z_stream is allocated with calloc(), zlib allocates its
+ * own state with malloc(), and deflate runs at the default level with the
+ * largest window and memory level (some 256 KB in all).  Calling this
+ * before telnet_begin_compress2() makes both come from zalloc and zfree
+ * instead, with the same signatures as zlib's alloc_func and free_func,
+ * and passes the given parameters to deflateInit2().  zlib needs about
+ * (1 << (window_bits + 2)) + (1 << (mem_level + 9)) bytes, plus its
+ * state and the z_stream.
+ *
+ * Has no effect unless zlib support is compiled into libtelnet.
+ *
+ * \param telnet      Telnet state tracker object.
+ * \param zalloc      Allocator, or 0 for the defaults.
+ * \param zfree       Release function for memory from zalloc.
+ * \param opaque      Passed to zalloc and zfree.
+ * \param level       Compression level, Z_DEFAULT_COMPRESSION or 0 to 9.
+ * \param window_bits Base two logarithm of the window size, 9 to 15.
+ * \param mem_level   Memory for the compression state, 1 to 9.
+ */
+extern void telnet_set_zlib(telnet_t *telnet,
+		void *(*zalloc)(void *opaque, unsigned int items, unsigned int size),
+		void (*zfree)(void *opaque, void *address), void *opaque,
+		int level, int window_bits, int mem_level);
+
 /*!
  * \brief Send formatted data.
  *
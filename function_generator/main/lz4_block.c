@@ -0,0 +1,228 @@
+/* LZ4 Block
+
+   See lz4_block.h.
+*/
+#include <string.h>
+
+#include "lz4_block.h"
+
+// Format limits: a match is at least 4 bytes, the last 5 bytes are always
+// literals and the last match starts at least 12 bytes before the end.
+#define MIN_MATCH 4
+#define LAST_LITERALS 5
+#define MF_LIMIT 12
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t value;
+    
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t hash(uint32_t value)
+{
+    return (value * 2654435761u) >> (32 - LZ4_BLOCK_HASH_BITS);
+}
+
+// Bytes from 'pos' that match those from 'ref', going no further than 'limit'.
+static size_t match_length(const uint8_t *src, size_t pos, size_t ref, size_t limit)
+{
+    size_t length = MIN_MATCH;
+    
+    // A word at a time; the first differing byte is the lowest set one
+    // (little-endian, as the ESP32 and the host are).
+    while (pos + length + 4 <= limit)
+    {
+        uint32_t diff = read32(src + pos + length) ^ read32(src + ref + length);
+        if (diff != 0)
+        {
+            return length + (__builtin_ctz(diff) >> 3);
+        }
+        length += 4;
+    }
+    while (pos + length < limit && src[pos + length] == src[ref + length])
+    {
+        length++;
+    }
+    return length;
+}
+
+// Bytes a length takes beyond its token nibble.
+static inline size_t length_bytes(size_t length)
+{
+    return length >= 15 ? (length - 15) / 255 + 1 : 0;
+}
+
+// Writes the part of a length that does not fit in its token nibble.
+static uint8_t *put_length(uint8_t *op, size_t length)
+{
+    while (length >= 255)
+    {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t) length;
+    return op;
+}
+
+// The token and literals of a sequence; the caller adds any match.
+static uint8_t *put_literals(uint8_t *op, const uint8_t *literals, size_t count, uint8_t matchNibble)
+{
+    uint8_t *token = op++;
+    
+    if (count >= 15)
+    {
+        *token = 0xF0 | matchNibble;
+        op = put_length(op, count - 15);
+    }
+    else
+    {
+        *token = (uint8_t) (count << 4) | matchNibble;
+    }
+    memcpy(op, literals, count);
+    return op + count;
+}
+
+size_t lz4_block_compress(const void *in, size_t len, uint8_t *out, size_t capacity,
+                          lz4_block_arena_t *arena)
+{
+    const uint8_t *src = in;
+    uint8_t *op = out;
+    uint8_t *end = out + capacity;
+    size_t anchor = 0;
+    
+    if (len > LZ4_BLOCK_MAX_INPUT)
+    {
+        return 0;
+    }
+    if (len > MF_LIMIT)
+    {
+        size_t matchLimit = len - LAST_LITERALS;
+        size_t pos = 0;
+    
+        while (pos < len - MF_LIMIT)
+        {
+            uint32_t h = hash(read32(src + pos));
+            size_t ref = arena->table[h];
+            arena->table[h] = (uint16_t) pos;
+    
+            // The entry may be from an earlier buffer; the compare settles it.
+            if (ref >= pos || read32(src + ref) != read32(src + pos))
+            {
+                // Step further the longer nothing has matched.
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+            while (pos > anchor && ref > 0 && src[pos - 1] == src[ref - 1])
+            {
+                pos--;
+                ref--;
+            }
+            size_t length = match_length(src, pos, ref, matchLimit);
+            size_t literals = pos - anchor;
+    
+            if ((size_t) (end - op) < 1 + length_bytes(literals) + literals + 2 + length_bytes(length - MIN_MATCH))
+            {
+                return 0;
+            }
+            op = put_literals(op, src + anchor, literals, length - MIN_MATCH >= 15 ? 15 : length - MIN_MATCH);
+            size_t offset = pos - ref;
+            *op++ = (uint8_t) offset;
+            *op++ = (uint8_t) (offset >> 8);
+            if (length - MIN_MATCH >= 15)
+            {
+                op = put_length(op, length - MIN_MATCH - 15);
+            }
+    
+            pos += length;
+            anchor = pos;
+            // Keep the table current for the next search.
+            if (pos < len - MF_LIMIT)
+            {
+                arena->table[hash(read32(src + pos - 2))] = (uint16_t) (pos - 2);
+            }
+        }
+    }
+    
+    size_t literals = len - anchor;
+    if ((size_t) (end - op) < 1 + length_bytes(literals) + literals)
+    {
+        return 0;
+    }
+    op = put_literals(op, src + anchor, literals, 0);
+    return op - out;
+}
+
+// Reads the part of a length that did not fit in its token nibble. Returns
+// false if the input ends first.
+static int get_length(const uint8_t **ip, const uint8_t *end, size_t *length)
+{
+    uint8_t byte;
+    
+    do
+    {
+        if (*ip == end)
+        {
+            return 0;
+        }
+        byte = *(*ip)++;
+        *length += byte;
+    } while (byte == 255);
+    return 1;
+}
+
+size_t lz4_block_decompress(const uint8_t *in, size_t len, void *out, size_t capacity)
+{
+    const uint8_t *ip = in;
+    const uint8_t *inEnd = in + len;
+    uint8_t *start = out;
+    uint8_t *op = start;
+    uint8_t *outEnd = start + capacity;
+    
+    while (ip < inEnd)
+    {
+        uint8_t token = *ip++;
+        size_t literals = token >> 4;
+        if (literals == 15 && !get_length(&ip, inEnd, &literals))
+        {
+            return 0;
+        }
+        if ((size_t) (inEnd - ip) < literals || (size_t) (outEnd - op) < literals)
+        {
+            return 0;
+        }
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+        if (ip == inEnd)
+        {
+            // The last sequence has literals only.
+            break;
+        }
+    
+        if (inEnd - ip < 2)
+        {
+            return 0;
+        }
+        size_t offset = ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+        size_t length = token & 0x0F;
+        if (length == 15 && !get_length(&ip, inEnd, &length))
+        {
+            return 0;
+        }
+        length += MIN_MATCH;
+        if (offset == 0 || offset > (size_t) (op - start) || (size_t) (outEnd - op) < length)
+        {
+            return 0;
+        }
+        // Byte by byte: the match may overlap what it is copying.
+        const uint8_t *ref = op - offset;
+        while (length-- > 0)
+        {
+            *op++ = *ref++;
+        }
+    }
+    return op - start;
+}
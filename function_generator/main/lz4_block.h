@@ -0,0 +1,48 @@
+/* LZ4 Block
+
+   Compression of one buffer at a time in the LZ4 block format, so any LZ4
+   library's LZ4_decompress_safe() reads the output. Each buffer stands
+   alone: matches never reach into an earlier one, and there is no frame
+   header or checksum (the wire header has the CRC).
+
+   The compressor is the greedy single-probe search of LZ4's fast mode. Its
+   only working memory is the caller's arena, a hash table of 2^
+   LZ4_BLOCK_HASH_BITS 16 bit positions that is reused from buffer to
+   buffer without clearing: a stale entry only ever costs a failed compare.
+   Buffers are limited to LZ4_BLOCK_MAX_INPUT bytes so that positions fit
+   in 16 bits.
+
+   What it gains depends on repetition at the byte level: delta varint
+   coded counts (see delta_codec.h) compress many times over, raw counts
+   and jittery edge records hardly at all.
+
+   No ESP-IDF dependencies; shared with the host-side tools.
+*/
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZ4_BLOCK_HASH_BITS 12
+#define LZ4_BLOCK_MAX_INPUT 0xFFFF
+
+// Largest possible compressed size of 'len' bytes.
+#define LZ4_BLOCK_MAX_SIZE(len) ((len) + (len) / 255 + 16)
+
+typedef struct
+{
+    uint16_t table[1 << LZ4_BLOCK_HASH_BITS];
+} lz4_block_arena_t;
+
+// Compresses 'len' bytes of 'in' into 'out'. Returns the compressed size,
+// or 0 if it would not fit in 'capacity' or 'len' is over
+// LZ4_BLOCK_MAX_INPUT. 'arena' needs no initialisation.
+size_t lz4_block_compress(const void *in, size_t len, uint8_t *out, size_t capacity,
+                          lz4_block_arena_t *arena);
+
+// Decompresses all of 'in' into 'out'. Returns the decompressed size, or 0
+// if 'in' is malformed or the result would not fit in 'capacity'.
+size_t lz4_block_decompress(const uint8_t *in, size_t len, void *out, size_t capacity);
+
+#endif // LZ4_BLOCK_H
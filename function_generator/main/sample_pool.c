@@ -0,0 +1,106 @@
+/* Sample Pool
+
+   See sample_pool.h.
+*/
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+
+#include "sample_pool.h"
+#include "trace.h"
+
+static sample_block_t blocks[SAMPLE_POOL_TOTAL];
+
+static QueueHandle_t freeQueue = NULL;
+static QueueHandle_t readyQueue = NULL;
+static uint32_t dropped = 0;
+static uint32_t shed = 0;
+static bool backpressure = false;   // Set by the consumer, read by the producer.
+static uint32_t sequence = 0;
+
+void sample_pool_init(void)
+{
+    freeQueue = xQueueCreate(SAMPLE_POOL_TOTAL, sizeof(sample_block_t *));
+    readyQueue = xQueueCreate(SAMPLE_POOL_TOTAL, sizeof(sample_block_t *));
+    configASSERT(freeQueue != NULL && readyQueue != NULL);
+    
+    for (int i = 0; i < SAMPLE_POOL_TOTAL; i++)
+    {
+        sample_block_t *block = &blocks[i];
+        block->count = 0;
+        xQueueSend(freeQueue, &block, 0);
+    }
+}
+
+sample_block_t *sample_pool_first(void)
+{
+    sample_block_t *block = NULL;
+    
+    xQueueReceive(freeQueue, &block, portMAX_DELAY);
+    return block;
+}
+
+sample_block_t *sample_pool_submit(sample_block_t *full)
+{
+    sample_block_t *next = NULL;
+    
+    full->sequence = sequence++;
+    full->submitted = esp_timer_get_time();
+    if (__atomic_load_n(&backpressure, __ATOMIC_RELAXED))
+    {
+        // Nobody can take it - shed this block and keep filling it.
+        TRACE(TRACE_BLOCK_DROP, full->sequence);
+        shed++;
+        full->count = 0;
+        return full;
+    }
+    if (xQueueReceive(freeQueue, &next, 0) != pdTRUE)
+    {
+        // Nowhere to go - drop this block and keep filling it.
+        TRACE(TRACE_BLOCK_DROP, full->sequence);
+        dropped++;
+        full->count = 0;
+        return full;
+    }
+    
+    TRACE(TRACE_BLOCK_SUBMIT, full->sequence);
+    xQueueSend(readyQueue, &full, 0);
+    next->count = 0;
+    return next;
+}
+
+sample_block_t *sample_pool_receive(TickType_t wait)
+{
+    sample_block_t *block = NULL;
+    
+    if (xQueueReceive(readyQueue, &block, wait) != pdTRUE)
+    {
+        return NULL;
+    }
+    return block;
+}
+
+void sample_pool_release(sample_block_t *block)
+{
+    xQueueSend(freeQueue, &block, 0);
+}
+
+uint32_t sample_pool_dropped(void)
+{
+    return dropped;
+}
+
+void sample_pool_set_backpressure(bool on)
+{
+    __atomic_store_n(&backpressure, on, __ATOMIC_RELAXED);
+}
+
+uint32_t sample_pool_shed(void)
+{
+    return shed;
+}
+
+uint32_t sample_pool_waiting(void)
+{
+    return uxQueueMessagesWaiting(readyQueue);
+}
@@ -0,0 +1,75 @@
+/* Sample Pool
+
+   Fixed pool of sample blocks shared by SignalReceiverTask (producer) and
+   NetworkTask (consumer).
+
+   Free blocks wait on a free list, filled blocks on a ready queue. The
+   producer hands over a full block and receives an empty one in return;
+   when no empty block is available the full block is discarded and counted
+   as dropped, so bursts are absorbed by the pool and data is only ever lost
+   a whole block at a time.
+
+   The consumer can also apply back-pressure when it has nowhere to send
+   blocks (every client's socket and queue are full). Full blocks are then
+   discarded at submit and counted as shed, before they take a block from
+   the pool or any of the consumer's time, until the back-pressure is
+   released.
+*/
+#ifndef SAMPLE_POOL_H
+#define SAMPLE_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+
+#define SAMPLE_POOL_BLOCKS CONFIG_SAMPLE_POOL_BLOCKS
+#define SAMPLE_BLOCK_SIZE CONFIG_SAMPLE_BLOCK_SIZE
+
+// The stream server's replay ring keeps its blocks out of circulation, and
+// the producer fills one block per capture channel at a time, so both come
+// on top of the blocks the producer and consumer share.
+#define SAMPLE_POOL_TOTAL (SAMPLE_POOL_BLOCKS + CONFIG_STREAM_REPLAY_BLOCKS + CONFIG_CAPTURE_CHANNELS - 1)
+
+typedef struct
+{
+    uint32_t sequence;  // Assigned on submit, one sequence across all channels.
+                        // Dropped blocks use up a number too.
+    uint32_t count;     // Number of samples filled in.
+    uint8_t channel;    // Capture channel the samples came from.
+    int64_t timestamp;  // esp_timer time (us) at which the first sample was read, or
+                        // for edge records the cycle count they are measured from.
+    int64_t submitted;  // esp_timer time (us) at which the block was submitted.
+    int32_t samples[SAMPLE_BLOCK_SIZE];
+    uint32_t refs;      // Owned by the stream server once published: clients
+                        // and the replay ring still holding the block.
+} sample_block_t;
+
+// Creates the free list and ready queue. Call once before any other function.
+void sample_pool_init(void);
+
+// Producer: takes the first empty block to fill.
+sample_block_t *sample_pool_first(void);
+
+// Producer: queues a full block for transmission and returns the next empty
+// block. If the pool is exhausted, 'full' is emptied and returned instead.
+sample_block_t *sample_pool_submit(sample_block_t *full);
+
+// Consumer: waits up to 'wait' ticks for a full block. NULL on timeout.
+sample_block_t *sample_pool_receive(TickType_t wait);
+
+// Consumer: returns a block to the free list once it has been sent.
+void sample_pool_release(sample_block_t *block);
+
+// Number of full blocks discarded because the pool ran out.
+uint32_t sample_pool_dropped(void);
+
+// Consumer: while 'on', full blocks are shed at submit rather than queued.
+void sample_pool_set_backpressure(bool on);
+
+// Number of full blocks shed under back-pressure.
+uint32_t sample_pool_shed(void);
+
+// Number of full blocks waiting for the consumer.
+uint32_t sample_pool_waiting(void);
+
+#endif // SAMPLE_POOL_H
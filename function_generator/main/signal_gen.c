@@ -0,0 +1,690 @@
+/* Signal Generator
+
+   See signal_gen.h.
+*/
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/ledc.h"
+#include "driver/rmt.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "xtensa/core-macros.h"
+
+#include "capture.h"
+#include "signal_gen.h"
+#include "stats.h"
+
+#define APB_HZ 80000000
+#define LEDC_MAX_BITS 10
+#define RMT_MAX_TICKS 32767         // Longest level in one RMT item.
+#define RMT_MAX_DIV 255
+#define SOFT_FRACTION_BITS 8        // Software edge times are kept in 1/256 cycles.
+#define SOFT_EDGES_PER_PASS 4096    // Edges written per output per tick at most.
+#define CPU_HZ ((uint64_t) CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ * 1000000)
+
+#if CONFIG_FREERTOS_UNICORE
+#define CAPTURE_CORE 0
+#else
+#define CAPTURE_CORE CONFIG_CAPTURE_TASK_CORE
+#endif
+
+// A software signal as SignalGeneratorTask runs it. Times are absolute, in
+// 1/256 CPU cycles on the capture core.
+typedef struct
+{
+    bool active;
+    int channel;
+    bool anyEdge;
+    signal_config_t config;
+    uint64_t high;              // Rising edge to falling edge.
+    uint64_t low;               // Falling edge to rising edge.
+    uint64_t sweepStart;
+    uint64_t sweepLength;       // Whole CPU cycles.
+    uint64_t burstStart;
+    uint64_t burstInterval;
+    uint32_t inBurst;           // Pulses so far in the current burst.
+    uint32_t level;             // Level the next edge goes to.
+    uint64_t next;              // Time of the next edge.
+} soft_signal_t;
+
+typedef struct
+{
+    bool running;
+    signal_config_t config;
+    
+    // LEDC and RMT: pulses are counted from the time the current frequency
+    // took effect.
+    int64_t startUs;
+    uint64_t basePulses;
+    uint8_t ledcBits;
+    esp_timer_handle_t timer;   // Sweep steps (LEDC) or burst starts (RMT).
+    bool rmtInstalled;
+    rmt_item32_t *items;
+    
+    // Software: a request is written here and taken by SignalGeneratorTask,
+    // which owns 'soft' and counts 'softPulses'.
+    bool softRequest;
+    bool softStart;             // The request is to start rather than stop.
+    signal_config_t softConfig;
+    soft_signal_t soft;
+    uint64_t softPulses;
+} output_t;
+
+static const char* TAG = "signal gen";
+
+static output_t outputs[SIGNAL_OUTPUTS];
+static TaskHandle_t taskSignalGenerator = NULL;
+
+/*--------------------------------------------------*/
+/*---------------------- LEDC ----------------------*/
+/*--------------------------------------------------*/
+
+// Finest duty resolution the timer can run at 'frequency' with.
+static uint8_t ledc_bits(uint32_t frequency)
+{
+    uint8_t bits = 1;
+    
+    while (bits < LEDC_MAX_BITS && ((uint64_t) frequency << (bits + 1)) <= APB_HZ)
+    {
+        bits++;
+    }
+    return bits;
+}
+
+static uint32_t ledc_duty(uint8_t bits, uint8_t percent)
+{
+    uint32_t steps = 1u << bits;
+    uint32_t duty = (steps * percent + 50) / 100;
+    
+    return duty < 1 ? 1 : duty > steps - 1 ? steps - 1 : duty;
+}
+
+static esp_err_t ledc_configure(int output, uint32_t frequency, uint8_t bits)
+{
+    output_t *out = &outputs[output];
+    ledc_timer_config_t timer = {
+        .speed_mode = LEDC_HIGH_SPEED_MODE,
+        .duty_resolution = (ledc_timer_bit_t) bits,
+        .timer_num = (ledc_timer_t) output,
+        .freq_hz = frequency,
+        .clk_cfg = LEDC_USE_APB_CLK,
+    };
+    ledc_channel_config_t channel = {
+        .gpio_num = out->config.target,
+        .speed_mode = LEDC_HIGH_SPEED_MODE,
+        .channel = (ledc_channel_t) output,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = (ledc_timer_t) output,
+        .duty = ledc_duty(bits, out->config.dutyPercent),
+        .hpoint = 0,
+    };
+    
+    esp_err_t err = ledc_timer_config(&timer);
+    if (err == ESP_OK)
+    {
+        err = ledc_channel_config(&channel);
+    }
+    out->ledcBits = bits;
+    return err;
+}
+
+// Frequency 'elapsedUs' into a sweep.
+static uint32_t sweep_frequency(const signal_config_t *config, uint64_t elapsedUs)
+{
+    uint64_t length = (uint64_t) config->sweepMs * 1000;
+    int64_t span = (int64_t) config->sweepTo - config->frequency;
+    
+    return config->frequency + span * (int64_t) (elapsedUs % length) / (int64_t) length;
+}
+
+static void ledc_sweep_step(void *arg)
+{
+    output_t *out = (output_t *) arg;
+    int output = out - outputs;
+    
+    ledc_set_freq(LEDC_HIGH_SPEED_MODE, (ledc_timer_t) output,
+                  sweep_frequency(&out->config, esp_timer_get_time() - out->startUs));
+}
+
+static bool ledc_start(int output)
+{
+    output_t *out = &outputs[output];
+    const signal_config_t *config = &out->config;
+    
+    if (config->burstPulses)
+    {
+        ESP_LOGE(TAG, "Output %d: LEDC cannot produce bursts; use the RMT or software source", output);
+        return false;
+    }
+    // Sweeps keep the resolution the top frequency needs.
+    uint32_t top = config->sweepTo > config->frequency ? config->sweepTo : config->frequency;
+    esp_err_t err = ledc_configure(output, config->frequency, ledc_bits(top));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Output %d: LEDC cannot produce %u Hz: %s", output, config->frequency, esp_err_to_name(err));
+        return false;
+    }
+    if (config->sweepTo)
+    {
+        esp_timer_create_args_t args = {
+            .callback = ledc_sweep_step,
+            .arg = out,
+            .name = "signal sweep",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&args, &out->timer));
+        ESP_ERROR_CHECK(esp_timer_start_periodic(out->timer, SIGNAL_SWEEP_STEP_MS * 1000));
+    }
+    return true;
+}
+
+static bool ledc_set_frequency(int output, uint32_t frequency)
+{
+    output_t *out = &outputs[output];
+    uint8_t bits = ledc_bits(frequency);
+    esp_err_t err;
+    
+    // Keep the timer running if its resolution allows the new frequency;
+    // otherwise reconfigure it, at the cost of a glitch.
+    if (bits >= out->ledcBits)
+    {
+        err = ledc_set_freq(LEDC_HIGH_SPEED_MODE, (ledc_timer_t) output, frequency);
+    }
+    else
+    {
+        err = ledc_configure(output, frequency, bits);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Output %d: LEDC cannot produce %u Hz: %s", output, frequency, esp_err_to_name(err));
+    }
+    return err == ESP_OK;
+}
+
+/*--------------------------------------------------*/
+/*---------------------- RMT -----------------------*/
+/*--------------------------------------------------*/
+
+static void rmt_burst(void *arg)
+{
+    output_t *out = (output_t *) arg;
+    
+    rmt_write_items((rmt_channel_t) (out - outputs), out->items, out->config.burstPulses, false);
+}
+
+/*
+  Sets up the RMT channel and one item per pulse of a burst, or a single
+  looping item for a continuous signal. Fails if the period cannot be made
+  from whole clock ticks with each level under RMT_MAX_TICKS.
+ */
+static bool rmt_start(int output)
+{
+    output_t *out = &outputs[output];
+    const signal_config_t *config = &out->config;
+    rmt_channel_t channel = (rmt_channel_t) output;
+    
+    if (config->sweepTo)
+    {
+        ESP_LOGE(TAG, "Output %d: RMT cannot sweep; use the LEDC or software source", output);
+        return false;
+    }
+    if (config->burstPulses && (uint64_t) config->burstPulses * 1000000 / config->frequency >=
+                               (uint64_t) config->burstIntervalMs * 1000)
+    {
+        ESP_LOGE(TAG, "Output %d: a burst of %u pulses at %u Hz does not fit in %u ms",
+                 output, config->burstPulses, config->frequency, config->burstIntervalMs);
+        return false;
+    }
+    
+    // Smallest divider that keeps the longer level within one item.
+    uint32_t longest = config->dutyPercent > 50 ? config->dutyPercent : 100 - config->dutyPercent;
+    uint64_t perLevel = (uint64_t) config->frequency * 100 * RMT_MAX_TICKS;
+    uint64_t div = ((uint64_t) APB_HZ * longest + perLevel - 1) / perLevel;
+    div = div < 1 ? 1 : div;
+    uint32_t period = (APB_HZ / div + config->frequency / 2) / config->frequency;
+    if (div > RMT_MAX_DIV || period < 2)
+    {
+        ESP_LOGE(TAG, "Output %d: RMT cannot produce %u Hz", output, config->frequency);
+        return false;
+    }
+    uint32_t high = (period * config->dutyPercent + 50) / 100;
+    high = high < 1 ? 1 : high > period - 1 ? period - 1 : high;
+    
+    rmt_config_t rmt = {
+        .rmt_mode = RMT_MODE_TX,
+        .channel = channel,
+        .gpio_num = config->target,
+        .clk_div = (uint8_t) div,
+        .mem_block_num = 1,
+        .tx_config = {
+            .loop_en = config->burstPulses == 0,
+            .idle_output_en = true,
+            .idle_level = RMT_IDLE_LEVEL_LOW,
+        },
+    };
+    esp_err_t err = rmt_config(&rmt);
+    if (err == ESP_OK && !out->rmtInstalled)
+    {
+        err = rmt_driver_install(channel, 0, 0);
+        out->rmtInstalled = (err == ESP_OK);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Output %d: RMT set-up failed: %s", output, esp_err_to_name(err));
+        return false;
+    }
+    
+    // A continuous signal is one item and an end marker, repeated by the
+    // peripheral; a burst is sent from 'items' by the driver.
+    size_t count = config->burstPulses ? config->burstPulses : 2;
+    out->items = calloc(count, sizeof(rmt_item32_t));
+    if (out->items == NULL)
+    {
+        ESP_LOGE(TAG, "Output %d: no memory for %u RMT items", output, (unsigned) count);
+        return false;
+    }
+    for (size_t i = 0; i < (config->burstPulses ? count : 1); i++)
+    {
+        out->items[i].level0 = 1;
+        out->items[i].duration0 = high;
+        out->items[i].level1 = 0;
+        out->items[i].duration1 = period - high;
+    }
+    
+    if (config->burstPulses == 0)
+    {
+        rmt_fill_tx_items(channel, out->items, 2, 0);
+        rmt_tx_start(channel, true);
+        return true;
+    }
+    esp_timer_create_args_t args = {
+        .callback = rmt_burst,
+        .arg = out,
+        .name = "signal burst",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&args, &out->timer));
+    rmt_burst(out);
+    ESP_ERROR_CHECK(esp_timer_start_periodic(out->timer, (uint64_t) config->burstIntervalMs * 1000));
+    return true;
+}
+
+static void rmt_stop(int output)
+{
+    output_t *out = &outputs[output];
+    rmt_channel_t channel = (rmt_channel_t) output;
+    
+    // Let a burst finish so the driver is idle for the next start.
+    if (out->config.burstPulses)
+    {
+        rmt_wait_tx_done(channel, pdMS_TO_TICKS(out->config.burstIntervalMs) + 1);
+    }
+    rmt_tx_stop(channel);
+    free(out->items);
+    out->items = NULL;
+}
+
+/*--------------------------------------------------*/
+/*-------------------- Software --------------------*/
+/*--------------------------------------------------*/
+
+static void soft_set_frequency(soft_signal_t *soft, uint32_t frequency)
+{
+    uint64_t period = (CPU_HZ << SOFT_FRACTION_BITS) / frequency;
+    
+    soft->high = period * soft->config.dutyPercent / 100;
+    soft->low = period - soft->high;
+}
+
+// Takes over the channel and sets the signal up. Returns false if capture
+// has not started yet.
+static bool soft_begin(output_t *out)
+{
+    soft_signal_t *soft = &out->soft;
+    
+    if (!capture_gpio_detach(out->softConfig.target))
+    {
+        return false;
+    }
+    soft->config = out->softConfig;
+    soft->channel = soft->config.target;
+    soft->anyEdge = capture_channels[soft->channel].anyEdge;
+    soft->sweepLength = (uint64_t) soft->config.sweepMs * (CPU_HZ / 1000);
+    soft->burstInterval = ((uint64_t) soft->config.burstIntervalMs * (CPU_HZ / 1000)) << SOFT_FRACTION_BITS;
+    soft->inBurst = 0;
+    soft->level = 1;
+    soft_set_frequency(soft, soft->config.frequency);
+    __atomic_store_n(&out->softPulses, 0, __ATOMIC_RELAXED);
+    return true;
+}
+
+// Starts the signal at 'now'.
+static void soft_restart_clock(soft_signal_t *soft, uint64_t now)
+{
+    soft->sweepStart = soft->burstStart = soft->next = now;
+    soft->active = true;
+}
+
+// Writes the edges due by 'now', up to SOFT_EDGES_PER_PASS.
+static void soft_run(output_t *out, uint64_t now)
+{
+    soft_signal_t *soft = &out->soft;
+    uint32_t pulses = 0;
+    
+    for (int edges = 0; edges < SOFT_EDGES_PER_PASS && soft->next <= now; edges++)
+    {
+        uint32_t ccount = (uint32_t) (soft->next >> SOFT_FRACTION_BITS);
+    
+        if (soft->level)
+        {
+            capture_gpio_inject(soft->channel, ccount, 1);
+            pulses++;
+            soft->level = 0;
+            soft->next += soft->high;
+            continue;
+        }
+        if (soft->anyEdge)
+        {
+            capture_gpio_inject(soft->channel, ccount, 0);
+        }
+        soft->level = 1;
+        soft->next += soft->low;
+        if (soft->config.burstPulses && ++soft->inBurst == soft->config.burstPulses)
+        {
+            soft->inBurst = 0;
+            soft->burstStart += soft->burstInterval;
+            soft->next = soft->burstStart;
+        }
+        if (soft->config.sweepTo)
+        {
+            uint64_t elapsed = (soft->next - soft->sweepStart) >> SOFT_FRACTION_BITS;
+            int64_t span = (int64_t) soft->config.sweepTo - soft->config.frequency;
+            soft_set_frequency(soft, soft->config.frequency +
+                               span * (int64_t) (elapsed % soft->sweepLength) / (int64_t) soft->sweepLength);
+        }
+    }
+    __atomic_fetch_add(&out->softPulses, pulses, __ATOMIC_RELAXED);
+}
+
+/*
+  Runs the software outputs. Pinned to the capture core, below
+  SignalReceiverTask's priority, so the cycle counts it writes are the
+  ones the receiver reads and the receiver empties the ring as soon as the
+  generator has written a batch. Wakes once a tick and writes every edge
+  due since the last, then tells the receiver how far it has got on every
+  channel it has taken over, so the receiver's clock for those channels
+  keeps up without passing edges not yet written.
+ */
+static void SignalGeneratorTask(void *pvParameters)
+{
+    (void) pvParameters;
+    
+    uint32_t lastCcount = XTHAL_GET_CCOUNT();
+    uint64_t cycles = lastCcount;
+    uint32_t detached = 0;     // Channels taken over, by bit.
+    bool starting[SIGNAL_OUTPUTS] = { false };
+    bool behind = false;
+    
+    while (1)
+    {
+        // Requests first, so a signal starts after its channel was
+        // detached, by the clock read below.
+        for (int output = 0; output < SIGNAL_OUTPUTS; output++)
+        {
+            output_t *out = &outputs[output];
+            if (__atomic_load_n(&out->softRequest, __ATOMIC_ACQUIRE))
+            {
+                out->soft.active = false;
+                if (out->softStart)
+                {
+                    if (!soft_begin(out))
+                    {
+                        continue;   // Capture has not started; try again next tick.
+                    }
+                    detached |= 1u << out->soft.channel;
+                    starting[output] = true;
+                }
+                __atomic_store_n(&out->softRequest, false, __ATOMIC_RELEASE);
+            }
+        }
+    
+        uint32_t ccount = XTHAL_GET_CCOUNT();
+        cycles += (uint32_t) (ccount - lastCcount);
+        lastCcount = ccount;
+        uint64_t now = cycles << SOFT_FRACTION_BITS;
+        uint32_t until[CAPTURE_CHANNELS];
+    
+        for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+        {
+            until[channel] = ccount;
+        }
+        for (int output = 0; output < SIGNAL_OUTPUTS; output++)
+        {
+            output_t *out = &outputs[output];
+            if (starting[output])
+            {
+                soft_restart_clock(&out->soft, now);
+                starting[output] = false;
+            }
+            if (out->soft.active)
+            {
+                soft_run(out, now);
+                if (out->soft.next <= now)
+                {
+                    // Only as far as the edges actually written.
+                    until[out->soft.channel] = (uint32_t) (out->soft.next >> SOFT_FRACTION_BITS) - 1;
+                    if (!behind)
+                    {
+                        ESP_LOGW(TAG, "Output %d is falling behind: more than %d edges a tick",
+                                 output, SOFT_EDGES_PER_PASS);
+                        behind = true;
+                    }
+                }
+            }
+        }
+        for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+        {
+            if (detached & (1u << channel))
+            {
+                capture_gpio_inject_until(channel, until[channel]);
+            }
+        }
+        vTaskDelay(1);
+    }
+}
+
+// Hands a start or stop to SignalGeneratorTask and waits for it to be taken.
+static void soft_request(int output, bool start)
+{
+    output_t *out = &outputs[output];
+    
+    if (taskSignalGenerator == NULL)
+    {
+        xTaskCreatePinnedToCore (SignalGeneratorTask,
+                                 "SignalGeneratorTask",
+                                 2048,
+                                 NULL,
+                                 9,     // Below SignalReceiverTask.
+                                 &taskSignalGenerator,
+                                 CAPTURE_CORE);
+        stats_register_task(taskSignalGenerator);
+    }
+    out->softConfig = out->config;
+    out->softStart = start;
+    __atomic_store_n(&out->softRequest, true, __ATOMIC_RELEASE);
+    while (__atomic_load_n(&out->softRequest, __ATOMIC_ACQUIRE))
+    {
+        vTaskDelay(1);
+    }
+}
+
+static bool soft_start(int output)
+{
+    const signal_config_t *config = &outputs[output].config;
+    
+#if CONFIG_CAPTURE_BACKEND_PCNT
+    ESP_LOGE(TAG, "Output %d: the software source needs the GPIO interrupt capture backend", output);
+    return false;
+#endif
+    if (config->target < 0 || config->target >= CAPTURE_CHANNELS)
+    {
+        ESP_LOGE(TAG, "Output %d: no capture channel %d", output, config->target);
+        return false;
+    }
+    for (int other = 0; other < SIGNAL_OUTPUTS; other++)
+    {
+        if (other != output && outputs[other].running && outputs[other].config.source == SIGNAL_SOURCE_SOFT &&
+            outputs[other].config.target == config->target)
+        {
+            ESP_LOGE(TAG, "Output %d: channel %d is already driven by output %d", output, config->target, other);
+            return false;
+        }
+    }
+    soft_request(output, true);
+    return true;
+}
+
+/*--------------------------------------------------*/
+/*--------------------- Outputs --------------------*/
+/*--------------------------------------------------*/
+
+// Pulses since the current frequency took effect, from the elapsed time.
+static uint64_t timed_pulses(const output_t *out)
+{
+    const signal_config_t *config = &out->config;
+    uint64_t elapsed = esp_timer_get_time() - out->startUs;
+    
+    if (config->burstPulses)
+    {
+        uint64_t interval = (uint64_t) config->burstIntervalMs * 1000;
+        uint64_t partial = (uint64_t) config->frequency * (elapsed % interval) / 1000000;
+        return (elapsed / interval) * config->burstPulses +
+               (partial < config->burstPulses ? partial : config->burstPulses);
+    }
+    if (config->sweepTo)
+    {
+        // The mean frequency over each whole sweep, and the integral of the
+        // linear ramp over the part sweep.
+        double length = config->sweepMs * 1000.0;
+        double part = (double) (elapsed % (uint64_t) length);
+        double span = (double) config->sweepTo - config->frequency;
+        return (uint64_t) (((elapsed / (uint64_t) length) * (config->frequency + config->sweepTo) * length / 2 +
+                            config->frequency * part + span * part * part / (2 * length)) / 1e6);
+    }
+    return (uint64_t) config->frequency * elapsed / 1000000;
+}
+
+bool signal_gen_start(int output, const signal_config_t *config)
+{
+    output_t *out = &outputs[output];
+    bool started = false;
+    
+    signal_gen_stop(output);
+    if (config->frequency == 0 || config->dutyPercent < 1 || config->dutyPercent > 99 ||
+        (config->sweepTo && config->sweepMs == 0) || (config->burstPulses && config->burstIntervalMs == 0))
+    {
+        ESP_LOGE(TAG, "Output %d: invalid signal", output);
+        return false;
+    }
+    out->config = *config;
+    out->startUs = esp_timer_get_time();
+    out->basePulses = 0;
+    switch (config->source)
+    {
+        case SIGNAL_SOURCE_LEDC: started = ledc_start(output); break;
+        case SIGNAL_SOURCE_RMT: started = rmt_start(output); break;
+        case SIGNAL_SOURCE_SOFT: started = soft_start(output); break;
+    }
+    out->running = started;
+    if (!started)
+    {
+        signal_gen_stop(output);
+        return false;
+    }
+    ESP_LOGI(TAG, "Output %d: %s %d, %u Hz at %u%%%s", output,
+             config->source == SIGNAL_SOURCE_SOFT ? "software, channel" :
+             config->source == SIGNAL_SOURCE_RMT ? "RMT, GPIO" : "LEDC, GPIO",
+             config->target, config->frequency, config->dutyPercent,
+             config->sweepTo ? ", sweeping" : config->burstPulses ? ", bursts" : "");
+    return true;
+}
+
+bool signal_gen_set_frequency(int output, uint32_t frequency)
+{
+    output_t *out = &outputs[output];
+    
+    if (!out->running || out->config.sweepTo || out->config.burstPulses || frequency == 0)
+    {
+        return false;
+    }
+    switch (out->config.source)
+    {
+        case SIGNAL_SOURCE_LEDC:
+            if (!ledc_set_frequency(output, frequency))
+            {
+                return false;
+            }
+            out->basePulses += timed_pulses(out);
+            out->startUs = esp_timer_get_time();
+            out->config.frequency = frequency;
+            return true;
+    
+        case SIGNAL_SOURCE_RMT:
+        case SIGNAL_SOURCE_SOFT:
+        {
+            // Restart, carrying the count over.
+            uint64_t pulses = signal_gen_pulses(output);
+            signal_config_t config = out->config;
+            config.frequency = frequency;
+            if (!signal_gen_start(output, &config))
+            {
+                return false;
+            }
+            out->basePulses = pulses;
+            return true;
+        }
+    }
+    return false;
+}
+
+void signal_gen_stop(int output)
+{
+    output_t *out = &outputs[output];
+    
+    if (out->timer != NULL)
+    {
+        esp_timer_stop(out->timer);
+        esp_timer_delete(out->timer);
+        out->timer = NULL;
+    }
+    if (out->running && out->config.source != SIGNAL_SOURCE_SOFT)
+    {
+        out->basePulses += timed_pulses(out);
+    }
+    if (out->running || out->items != NULL)
+    {
+        switch (out->config.source)
+        {
+            case SIGNAL_SOURCE_LEDC:
+                ledc_stop(LEDC_HIGH_SPEED_MODE, (ledc_channel_t) output, 0);
+                break;
+            case SIGNAL_SOURCE_RMT:
+                rmt_stop(output);
+                break;
+            case SIGNAL_SOURCE_SOFT:
+                soft_request(output, false);
+                break;
+        }
+    }
+    out->running = false;
+}
+
+uint64_t signal_gen_pulses(int output)
+{
+    const output_t *out = &outputs[output];
+    
+    if (out->config.source == SIGNAL_SOURCE_SOFT)
+    {
+        return out->basePulses + __atomic_load_n(&out->softPulses, __ATOMIC_RELAXED);
+    }
+    return out->running ? out->basePulses + timed_pulses(out) : out->basePulses;
+}
@@ -0,0 +1,82 @@
+/* Signal Generator
+
+   Test signals at known rates, so throughput and loss can be measured
+   without an external generator. Each of the SIGNAL_OUTPUTS outputs runs
+   one signal from one of three sources:
+
+   - SIGNAL_SOURCE_LEDC: a square or PWM wave from the LEDC peripheral on
+     a GPIO. Any frequency up to 40 MHz (20 MHz at duty cycles other than
+     50%), with fine frequency steps, and linear sweeps. Duty resolution
+     is as fine as the highest frequency allows, up to 0.1%.
+   - SIGNAL_SOURCE_RMT: a pulse train from the RMT peripheral on a GPIO.
+     Periods are whole 80 MHz clock ticks (times a divider below about
+     1.2 kHz), so frequencies are less fine than LEDC, but a burst is an
+     exact number of pulses. Continuous or bursts, no sweeps.
+   - SIGNAL_SOURCE_SOFT: no pin at all. SignalGeneratorTask, on the
+     capture core, writes the edges straight into a capture channel's edge
+     ring with the cycle counts they were due at, and the channel's pin is
+     disconnected. Works without hardware, including in the host build,
+     and supports sweeps and bursts. GPIO interrupt backend only. Edges
+     the channel would not capture (falling edges on a rising-edge
+     channel) are not written.
+
+   LEDC and RMT spend no CPU time per edge: a sweep is one frequency
+   update every SIGNAL_SWEEP_STEP_MS and a burst one RMT start per burst,
+   both from an esp_timer. Their outputs must be wired to a capture pin.
+
+   A sweep runs linearly from 'frequency' to 'sweepTo' over 'sweepMs' and
+   then starts again. A burst is 'burstPulses' pulses at 'frequency',
+   started every 'burstIntervalMs'.
+
+   signal_gen_pulses() gives the number of pulses (rising edges) produced
+   so far, for comparison with the edges captured. It is exact for the
+   software source and computed from the elapsed time for the others.
+
+   All functions must be called from one task.
+*/
+#ifndef SIGNAL_GEN_H
+#define SIGNAL_GEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SIGNAL_OUTPUTS 2
+#define SIGNAL_SWEEP_STEP_MS 10
+
+typedef enum
+{
+    SIGNAL_SOURCE_LEDC,
+    SIGNAL_SOURCE_RMT,
+    SIGNAL_SOURCE_SOFT,
+} signal_source_t;
+
+typedef struct
+{
+    signal_source_t source;
+    int target;                 // GPIO, or capture channel for SIGNAL_SOURCE_SOFT.
+    uint32_t frequency;         // Hz.
+    uint8_t dutyPercent;        // High time as a percentage of the period, 1 to 99.
+    uint32_t sweepTo;           // Hz at the end of a sweep, or 0 for a fixed frequency.
+    uint32_t sweepMs;
+    uint32_t burstPulses;       // Pulses per burst, or 0 for a continuous signal.
+    uint32_t burstIntervalMs;   // From the start of one burst to the next.
+} signal_config_t;
+
+// Starts 'output' (0 to SIGNAL_OUTPUTS - 1), stopping whatever it was
+// running first. Returns false, with the reason logged, if the source
+// cannot produce the signal asked for.
+bool signal_gen_start(int output, const signal_config_t *config);
+
+// Changes the frequency of a running fixed-frequency signal, keeping its
+// duty cycle. Returns false if it could not be changed.
+bool signal_gen_set_frequency(int output, uint32_t frequency);
+
+// Stops 'output'. A software source's capture channel stays disconnected
+// from its pin.
+void signal_gen_stop(int output);
+
+// Pulses produced since the output was last started, including any
+// produced before a frequency change or a stop.
+uint64_t signal_gen_pulses(int output);
+
+#endif // SIGNAL_GEN_H
@@ -0,0 +1,209 @@
+/* Runtime Statistics
+
+   See stats.h.
+*/
+#include <stdarg.h>
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+#include "stats.h"
+#include "capture.h"
+#include "sample_pool.h"
+
+#define STATS_MAX_TASKS 24
+
+stats_core_t stats_cores[portNUM_PROCESSORS];
+
+static const char *histogramNames[STATS_HISTOGRAMS] =
+{
+    [STATS_RING_AT_DRAIN] = "Ring at drain",
+    [STATS_READY_BLOCKS] = "Ready blocks",
+    [STATS_CLIENT_QUEUE] = "Client queue",
+    [STATS_SEND_LATENCY_MS] = "Send latency ms",
+    [STATS_CLIENT_BACKLOG_KB] = "Backlog KB",
+};
+
+static int64_t lastReport = 0;
+static uint32_t lastBytesSent = 0;
+#if CONFIG_STREAM_BINARY_LZ4
+static uint32_t lastCompressIn = 0;
+static uint32_t lastCompressOut = 0;
+static uint32_t lastCompressCycles = 0;
+#endif
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+static TaskStatus_t tasks[STATS_MAX_TASKS];
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+static struct
+{
+    UBaseType_t number;
+    uint32_t runTime;
+} lastRun[STATS_MAX_TASKS];
+static int lastRunCount = 0;
+static uint32_t lastTotalRunTime = 0;
+#endif
+#else
+static TaskHandle_t tasks[STATS_MAX_TASKS];
+static int taskCount = 0;
+#endif
+
+void stats_register_task(TaskHandle_t task)
+{
+#if !CONFIG_FREERTOS_USE_TRACE_FACILITY
+    if (taskCount < STATS_MAX_TASKS)
+    {
+        tasks[taskCount++] = task;
+    }
+#else
+    (void) task;    // Every task is listed anyway.
+#endif
+}
+
+static uint32_t counter_total(stats_counter_t counter)
+{
+    uint32_t total = 0;
+    
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        total += __atomic_load_n(&stats_cores[core].counters[counter], __ATOMIC_RELAXED);
+    }
+    return total;
+}
+
+// Appends to the report, truncating once it is full.
+static void append(char *buffer, size_t size, size_t *length, const char *format, ...)
+{
+    va_list args;
+    
+    if (*length >= size - 1)
+    {
+        return;
+    }
+    va_start(args, format);
+    int written = vsnprintf(buffer + *length, size - *length, format, args);
+    va_end(args);
+    if (written > 0)
+    {
+        *length += written;
+        if (*length > size - 1)
+        {
+            *length = size - 1;
+        }
+    }
+}
+
+static void report_tasks(char *buffer, size_t size, size_t *length)
+{
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    uint32_t totalRunTime = 0;
+    int count = uxTaskGetSystemState(tasks, STATS_MAX_TASKS, &totalRunTime);
+    
+    append(buffer, size, length, "%-16s%8s  %s\n", "Task", "CPU", "Stack free");
+    for (int i = 0; i < count; i++)
+    {
+        append(buffer, size, length, "%-16s", tasks[i].pcTaskName);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        // Percent of one core since the last report.
+        uint32_t previous = 0;
+        for (int j = 0; j < lastRunCount; j++)
+        {
+            if (lastRun[j].number == tasks[i].xTaskNumber)
+            {
+                previous = lastRun[j].runTime;
+                break;
+            }
+        }
+        uint32_t elapsed = totalRunTime - lastTotalRunTime;
+        uint32_t used = tasks[i].ulRunTimeCounter - previous;
+        uint32_t permille = elapsed ? (uint32_t) ((uint64_t) used * 1000 / elapsed) : 0;
+        append(buffer, size, length, " %4u.%u%%", permille / 10, permille % 10);
+#else
+        append(buffer, size, length, "      -");
+#endif
+        append(buffer, size, length, "  %u\n", (unsigned) tasks[i].usStackHighWaterMark);
+    }
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    for (int i = 0; i < count; i++)
+    {
+        lastRun[i].number = tasks[i].xTaskNumber;
+        lastRun[i].runTime = tasks[i].ulRunTimeCounter;
+    }
+    lastRunCount = count;
+    lastTotalRunTime = totalRunTime;
+#endif
+#else
+    append(buffer, size, length, "%-16s  %s\n", "Task", "Stack free");
+    for (int i = 0; i < taskCount; i++)
+    {
+        append(buffer, size, length, "%-16s  %u\n", pcTaskGetTaskName(tasks[i]),
+               (unsigned) uxTaskGetStackHighWaterMark(tasks[i]));
+    }
+#endif
+}
+
+size_t stats_report(char *buffer, size_t size)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t bytesSent = counter_total(STATS_BYTES_SENT);
+    int64_t elapsed = now - lastReport;
+    size_t length = 0;
+    
+    buffer[0] = '\0';
+    append(buffer, size, &length, "Uptime %lld.%03lld s\n",
+           (long long) (now / 1000000), (long long) (now / 1000 % 1000));
+    report_tasks(buffer, size, &length);
+    
+    for (int channel = 0; channel < CAPTURE_CHANNELS; channel++)
+    {
+        append(buffer, size, &length, "Channel %d overruns: %u\n", channel,
+               capture_backend.overruns(channel));
+    }
+    append(buffer, size, &length, "Blocks dropped (pool full): %u, shed (clients backed up): %u, "
+           "skipped (slow client): %u\n",
+           sample_pool_dropped(), sample_pool_shed(), counter_total(STATS_BLOCKS_SKIPPED));
+    append(buffer, size, &length, "Sends short: %u, stalled: %u\n",
+           counter_total(STATS_SHORT_SENDS), counter_total(STATS_SEND_STALLS));
+#if CONFIG_STREAM_UDP_ENABLE
+    append(buffer, size, &length, "Datagrams sent: %u, dropped: %u, subscriptions refused: %u\n",
+           counter_total(STATS_DATAGRAMS_SENT), counter_total(STATS_DATAGRAMS_DROPPED),
+           counter_total(STATS_SUBSCRIPTIONS_REFUSED));
+#endif
+#if CONFIG_STREAM_BINARY_LZ4
+    uint32_t compressIn = counter_total(STATS_COMPRESS_IN);
+    uint32_t compressOut = counter_total(STATS_COMPRESS_OUT);
+    uint32_t compressCycles = counter_total(STATS_COMPRESS_CYCLES);
+    uint32_t in = compressIn - lastCompressIn;
+    uint32_t out = compressOut - lastCompressOut;
+    uint32_t permille = in > 0 ? (uint32_t) ((uint64_t) out * 1000 / in) : 1000;
+    uint32_t cyclesPer100 = in > 0 ? (uint32_t) ((uint64_t) (compressCycles - lastCompressCycles) * 100 / in) : 0;
+    append(buffer, size, &length, "Compressed: %u of %u bytes (%u.%u%%), %u.%02u cycles/byte\n",
+           out, in, permille / 10, permille % 10, cyclesPer100 / 100, cyclesPer100 % 100);
+    lastCompressIn = compressIn;
+    lastCompressOut = compressOut;
+    lastCompressCycles = compressCycles;
+#endif
+    append(buffer, size, &length, "Sent: %u bytes/s\n",
+           elapsed > 0 ? (uint32_t) ((uint64_t) (bytesSent - lastBytesSent) * 1000000 / elapsed) : 0);
+    
+    append(buffer, size, &length, "Histograms (0, 1, 2-3, 4-7, ... %u+):\n", 1u << (STATS_BUCKETS - 2));
+    for (int histogram = 0; histogram < STATS_HISTOGRAMS; histogram++)
+    {
+        append(buffer, size, &length, "%-16s", histogramNames[histogram]);
+        for (int bucket = 0; bucket < STATS_BUCKETS; bucket++)
+        {
+            uint32_t total = 0;
+            for (int core = 0; core < portNUM_PROCESSORS; core++)
+            {
+                total += __atomic_load_n(&stats_cores[core].buckets[histogram][bucket], __ATOMIC_RELAXED);
+            }
+            append(buffer, size, &length, " %u", total);
+        }
+        append(buffer, size, &length, "\n");
+    }
+    
+    lastReport = now;
+    lastBytesSent = bytesSent;
+    return length;
+}
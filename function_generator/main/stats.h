@@ -0,0 +1,97 @@
+/* Runtime Statistics
+
+   Counters and histograms cheap enough to leave enabled, and a text report
+   that pulls them together with task, capture and pool state:
+
+   - CPU use of every task since the previous report (needs
+     CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS) and its stack high-water mark
+   - edge ring overruns per capture channel
+   - blocks dropped because the pool was full, shed under back-pressure and
+     skipped for slow clients, and sends the socket only partly took or
+     refused
+   - UDP stream datagrams sent and dropped
+   - the LZ4 compression ratio and cycles per input byte since the previous
+     report
+   - bytes sent per second since the previous report
+   - histograms of edge ring occupancy at each drain, filled blocks waiting
+     for NetworkTask, client queue length at each publish, and the time from
+     a block being submitted to a client having all of it
+
+   Each core updates its own copy of the counters with relaxed atomic adds,
+   so the hot paths never contend with the other core and never take a
+   lock. The report sums the copies.
+
+   Histograms use log2 buckets: bucket 0 counts zeros, bucket b counts
+   values from 2^(b-1) to 2^b - 1, and the last bucket everything larger.
+   They count from boot.
+*/
+#ifndef STATS_H
+#define STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#define STATS_BUCKETS 12
+#define STATS_REPORT_SIZE 2048
+
+typedef enum
+{
+    STATS_BYTES_SENT,
+    STATS_BLOCKS_SKIPPED,       // Not queued for a client whose queue was full.
+    STATS_SHORT_SENDS,          // send() took part of what it was given.
+    STATS_SEND_STALLS,          // send() took nothing: the socket was full.
+    STATS_DATAGRAMS_SENT,       // UDP stream datagrams, one per destination.
+    STATS_DATAGRAMS_DROPPED,    // UDP stream datagrams the stack had no room for.
+    STATS_SUBSCRIPTIONS_REFUSED, // UDP subscriptions from an address with no client.
+    STATS_COMPRESS_IN,          // Payload bytes given to the LZ4 compressor.
+    STATS_COMPRESS_OUT,         // Payload bytes sent for them, compressed or not.
+    STATS_COMPRESS_CYCLES,      // CPU cycles spent compressing.
+    STATS_COUNTERS
+} stats_counter_t;
+
+typedef enum
+{
+    STATS_RING_AT_DRAIN,        // Events in an edge ring when it is drained.
+    STATS_READY_BLOCKS,         // Filled blocks waiting when NetworkTask polls.
+    STATS_CLIENT_QUEUE,         // Client queue length when a block is published.
+    STATS_SEND_LATENCY_MS,      // Block submitted to fully sent, per client.
+    STATS_CLIENT_BACKLOG_KB,    // Bytes queued for a client and not yet taken by
+                                // its socket, when a block is published.
+    STATS_HISTOGRAMS
+} stats_histogram_t;
+
+typedef struct
+{
+    uint32_t counters[STATS_COUNTERS];
+    uint32_t buckets[STATS_HISTOGRAMS][STATS_BUCKETS];
+} stats_core_t;
+
+extern stats_core_t stats_cores[portNUM_PROCESSORS];
+
+static inline void stats_count(stats_counter_t counter, uint32_t n)
+{
+    __atomic_fetch_add(&stats_cores[xPortGetCoreID()].counters[counter], n, __ATOMIC_RELAXED);
+}
+
+static inline void stats_sample(stats_histogram_t histogram, uint32_t value)
+{
+    int bucket = value ? 32 - __builtin_clz(value) : 0;
+    
+    if (bucket >= STATS_BUCKETS)
+    {
+        bucket = STATS_BUCKETS - 1;
+    }
+    __atomic_fetch_add(&stats_cores[xPortGetCoreID()].buckets[histogram][bucket], 1, __ATOMIC_RELAXED);
+}
+
+// Adds a task to the report. Only needed without
+// CONFIG_FREERTOS_USE_TRACE_FACILITY, when tasks cannot be listed.
+void stats_register_task(TaskHandle_t task);
+
+// Writes the report to 'buffer' as text lines and returns its length.
+// Rates are measured since the previous call. Call from one task only.
+size_t stats_report(char *buffer, size_t size);
+
+#endif // STATS_H
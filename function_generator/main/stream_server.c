@@ -0,0 +1,1412 @@
+/* Stream Server
+
+   See stream_server.h.
+*/
+#include <string.h>
+#include <stdlib.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "lwip/sockets.h"
+#include <fcntl.h>
+#include "xtensa/core-macros.h"
+
+#include "stream_server.h"
+#include "udp_stream.h"
+#include "wire_format.h"
+#include "delta_codec.h"
+#include "lz4_block.h"
+#include "base85.h"
+#include "libtelnet.h"
+#include "stats.h"
+#include "trace.h"
+#if CONFIG_STREAM_TELNET_MCCP2
+#include "zlib_arena.h"
+#endif
+
+#define TX_CHUNK_SAMPLES (CONFIG_LWIP_TCP_MSS / 5) // Samples Ascii85 encoded per send(), one TCP segment's worth.
+#define TX_CHUNK_SIZE TX_CHUNK_SAMPLES*5 // Buffer for Ascii85 data tx.
+// Most libtelnet can make of 'bytes' of text holding 'iacs' IAC bytes. Each
+// IAC is doubled, and cuts the text into pieces that COMPRESS2 deflates and
+// flushes one by one, each at the cost of a block header and a sync flush.
+#define TELNET_OUT_BOUND(bytes, iacs) \
+    ((bytes) + (iacs) + ((bytes) + (iacs)) / 8 + 16 * (2 * (iacs) + 1) + 8)
+// Kept free for negotiation, and replies to the client while a chunk waits.
+#define TELNET_REPLY_ROOM 64
+// Room for a whole chunk with no IAC in it, as Ascii85 of counts is.
+// Chunks with IACs are given to libtelnet a part at a time (telnet_fit()).
+#define TELNET_OUT_SIZE (TELNET_OUT_BOUND(TX_CHUNK_SIZE, 0) + TELNET_REPLY_ROOM)
+
+#if CONFIG_BASE85_KERNEL_REFERENCE
+#define base85_encode_block base85_encode_block_reference
+#elif CONFIG_BASE85_KERNEL_LUT2
+#define base85_encode_block base85_encode_block_lut2
+#else
+#define base85_encode_block base85_encode_block_mulshift
+#endif
+
+/*
+  A frame sent between two blocks rather than as one: a stats record or a
+  trace dump. One copy is shared by every client sending it.
+ */
+typedef struct
+{
+    wire_header_t header;
+    const void *payload;
+    int senders;                // Clients part way through sending it.
+    void (*sent)(void);         // Called once no client is sending it, or NULL.
+} stream_record_t;
+
+#define RECORD_KINDS 2          // Stats and trace.
+
+typedef struct
+{
+    int sock;                   // -1 when the slot is free.
+    char protocol;              // WIRE_HANDSHAKE_*, or 0 while negotiating.
+    uint32_t peer;              // IPv4 address it connected from, network order.
+    int64_t connectTime;        // esp_timer time of accept().
+    bool firstSent;             // Connect-to-first-byte latency reported.
+    sample_block_t *queue[STREAM_CLIENT_QUEUE];
+    int head;                   // Slot of the block being sent.
+    int length;                 // Blocks queued.
+    size_t offset;              // Bytes of the head block already sent.
+    size_t unsent;              // Bytes of the queued blocks the socket has yet to take;
+                                // binary blocks count at their raw size until framed.
+    bool socketFull;            // The last send() was short or would have blocked.
+    uint32_t skipped;           // Blocks skipped because the queue was full.
+    bool resuming;              // Catching up from the replay ring.
+    uint32_t resumeSequence;    // Next sequence wanted from the replay ring.
+    char command[16];           // Command line received so far.
+    int commandLength;
+    bool commandOverlong;       // The line outgrew 'command'; it is dropped.
+    stream_record_t *records[RECORD_KINDS]; // Records to send at the next block
+                                            // boundaries, oldest first.
+    int recordCount;
+    size_t recordOffset;        // Bytes of the oldest record already sent.
+    bool framed;                // The head block's binary frame is below.
+    wire_header_t frameHeader;
+    const void *framePayload;   // 'frameData', or the head block's samples.
+#if CONFIG_STREAM_BINARY_DELTA_VARINT || CONFIG_STREAM_BINARY_LZ4
+    uint8_t frameData[SAMPLE_BLOCK_SIZE * sizeof(int32_t)];
+#endif
+#if CONFIG_STREAM_TELNET_MCCP2
+    telnet_t *telnet;           // Ascii85 through libtelnet, or NULL.
+    zlib_arena_t *arena;        // Held while COMPRESS2 is on.
+    bool compressing;
+    char telnetOut[TELNET_OUT_SIZE]; // libtelnet's output, waiting for the socket.
+    size_t telnetLength;
+    size_t telnetOffset;        // Bytes of telnetOut already sent.
+    bool telnetOverflow;        // Output was lost; the stream is broken.
+    uint32_t textBytes;         // Ascii85 given to libtelnet...
+    uint32_t wireBytes;         // ...and what it made of it.
+#endif
+} stream_client_t;
+
+static const char* TAG = "stream server";
+
+static stream_client_t clients[STREAM_MAX_CLIENTS];
+static int clientCount = 0;
+static bool backpressure = false;   // Sample pool told to shed blocks.
+
+#if STREAM_REPLAY_BLOCKS > 0
+static sample_block_t *replay[STREAM_REPLAY_BLOCKS];
+static int replayHead = 0;          // Oldest block.
+static int replayLength = 0;
+#endif
+
+static int listenSocket = -1;
+static int wakeSocket = -1;         // Bound to loopback; select() wakes when it is sent to.
+static int wakeSendSocket = -1;
+static struct sockaddr_in wakeAddr;
+
+static char txData[TX_CHUNK_SIZE];
+
+// The stats record is only re-rendered once no client is part way through it.
+static stream_record_t statsRecord;
+static char statsText[STATS_REPORT_SIZE];
+#if CONFIG_STREAM_STATS_INTERVAL_S > 0
+static int64_t statsTime = 0;
+#endif
+
+#if CONFIG_TRACE_ENABLE
+// Recording stays paused until every client has been sent the dump.
+static stream_record_t traceRecord = {
+    .sent = trace_resume,
+};
+#endif
+
+#if CONFIG_STREAM_THROUGHPUT_LOG
+static uint32_t samplesSent = 0;
+static uint32_t copied = 0;
+static TickType_t logTime;
+#endif
+
+#if CONFIG_STREAM_TELNET_MCCP2
+// The server offers COMPRESS2 and refuses everything else.
+static const telnet_telopt_t telnetOptions[] = {
+    { TELNET_TELOPT_COMPRESS2, TELNET_WILL, TELNET_DONT },
+    { -1, 0, 0 }
+};
+#endif
+
+#if CONFIG_STREAM_BINARY_LZ4
+// Compression working memory, allocated once. With delta coding the coded
+// samples wait here to be compressed into the client's frame.
+static struct
+{
+    lz4_block_arena_t arena;
+#if CONFIG_STREAM_BINARY_DELTA_VARINT
+    uint8_t coded[SAMPLE_BLOCK_SIZE * sizeof(int32_t)];
+#endif
+} compressScratch;
+#endif
+
+void stream_server_init(void)
+{
+    socklen_t addrLen = sizeof(wakeAddr);
+    
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        clients[i].sock = -1;
+    }
+    
+    // A UDP socket on the loopback interface lets other tasks wake the
+    // network task out of select() when a block is ready.
+    memset(&wakeAddr, 0, sizeof(wakeAddr));
+    wakeAddr.sin_family = AF_INET;
+    wakeAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    wakeAddr.sin_port = 0;
+    wakeSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    wakeSendSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (wakeSocket < 0 || wakeSendSocket < 0 ||
+        bind(wakeSocket, (struct sockaddr *)&wakeAddr, sizeof(wakeAddr)) != 0 ||
+        getsockname(wakeSocket, (struct sockaddr *)&wakeAddr, &addrLen) != 0)
+    {
+        ESP_LOGE(TAG, "Unable to create wake-up socket: %s", strerror(errno));
+    }
+    fcntl(wakeSocket, F_SETFL, fcntl(wakeSocket, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(wakeSendSocket, F_SETFL, fcntl(wakeSendSocket, F_GETFL, 0) | O_NONBLOCK);
+#if CONFIG_STREAM_THROUGHPUT_LOG
+    logTime = xTaskGetTickCount();
+#endif
+}
+
+bool stream_server_listen(int port)
+{
+    struct sockaddr_in dest_addr;
+    
+    dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_port = htons(port);
+    
+    listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket < 0)
+    {
+        ESP_LOGE(TAG, "Unable to create socket: Error No: %d", errno);
+        return false;
+    }
+    
+    // Allow the port to be re-bound straight after a WiFi drop closed it.
+    int reuse = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    
+    // Mark socket as non blocking.
+    int status = fcntl(listenSocket, F_SETFL, fcntl(listenSocket, F_GETFL, 0) | O_NONBLOCK);
+    if (status == -1)
+    {
+        ESP_LOGE(TAG, "Error setting non-blocking status: %s", strerror(errno));
+        close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+    
+    int err = bind(listenSocket, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+    if (err != 0)
+    {
+        ESP_LOGE(TAG, "Socket unable to bind: Error No: %s", strerror(errno));
+        close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+    err = listen(listenSocket, STREAM_MAX_CLIENTS);
+    if (err != 0)
+    {
+        ESP_LOGE(TAG, "Socket unable to listen: Error No: %s", strerror(errno));
+        close(listenSocket);
+        listenSocket = -1;
+        return false;
+    }
+    ESP_LOGI(TAG, "Listening on port %d", port);
+#if CONFIG_STREAM_UDP_ENABLE
+    // The TCP stream carries on without it.
+    udp_stream_open(CONFIG_STREAM_UDP_PORT);
+#endif
+    return true;
+}
+
+void stream_server_wake(void)
+{
+    char wake = 0;
+    
+    TRACE(TRACE_WAKE, 0);
+    sendto(wakeSendSocket, &wake, 1, 0, (struct sockaddr *)&wakeAddr, sizeof(wakeAddr));
+}
+
+bool stream_server_has_peer(uint32_t addr)
+{
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        if (clients[i].sock >= 0 && clients[i].peer == addr)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// UDP subscribers are counted by the TCP sessions they hold.
+int stream_server_client_count(void)
+{
+    return clientCount;
+}
+
+static void block_release(sample_block_t *block)
+{
+    if (--block->refs == 0)
+    {
+        sample_pool_release(block);
+    }
+}
+
+static void accept_client(void)
+{
+    struct sockaddr source_addr;
+    socklen_t addr_len = sizeof(source_addr);
+    stream_client_t *client = NULL;
+    
+    int sock = accept(listenSocket, (struct sockaddr *)&source_addr, &addr_len);
+    if (sock < 0)
+    {
+        if (errno != EWOULDBLOCK)
+        {
+            ESP_LOGE(TAG, "Unable to accept connection %s", strerror(errno));
+        }
+        return;
+    }
+    
+    for (int i = 0; i < STREAM_MAX_CLIENTS && client == NULL; i++)
+    {
+        if (clients[i].sock < 0)
+        {
+            client = &clients[i];
+        }
+    }
+    if (client == NULL)
+    {
+        ESP_LOGW(TAG, "Too many clients - closing connection");
+        close(sock);
+        return;
+    }
+    
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+    
+    // A client that vanishes without closing (power loss, out of range) is
+    // only noticed through keepalive once its queue stops draining.
+    int keepAlive = 1;
+    int keepIdle = CONFIG_STREAM_KEEPALIVE_IDLE_S;
+    int keepInterval = CONFIG_STREAM_KEEPALIVE_INTERVAL_S;
+    int keepCount = CONFIG_STREAM_KEEPALIVE_COUNT;
+    setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &keepAlive, sizeof(keepAlive));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPIDLE, &keepIdle, sizeof(keepIdle));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPINTVL, &keepInterval, sizeof(keepInterval));
+    setsockopt(sock, IPPROTO_TCP, TCP_KEEPCNT, &keepCount, sizeof(keepCount));
+    
+    memset(client, 0, sizeof(*client));
+    client->sock = sock;
+    client->peer = ((struct sockaddr_in *) &source_addr)->sin_addr.s_addr;
+    client->connectTime = esp_timer_get_time();
+    clientCount++;
+    ESP_LOGI(TAG, "Client %d connected, %d connected", (int) (client - clients), clientCount);
+}
+
+// The client has sent its oldest record, or is gone.
+static void record_done(stream_client_t *client)
+{
+    stream_record_t *record = client->records[0];
+    
+    client->recordCount--;
+    memmove(&client->records[0], &client->records[1], client->recordCount * sizeof(client->records[0]));
+    client->recordOffset = 0;
+    if (--record->senders == 0 && record->sent != NULL)
+    {
+        record->sent();
+    }
+}
+
+static void drop_client(stream_client_t *client)
+{
+    ESP_LOGI(TAG, "Client %d disconnected, %u blocks skipped",
+             (int) (client - clients), client->skipped);
+    close(client->sock);
+    client->sock = -1;
+    while (client->recordCount > 0)
+    {
+        record_done(client);
+    }
+    
+    while (client->length > 0)
+    {
+        block_release(client->queue[client->head]);
+        client->head = (client->head + 1) % STREAM_CLIENT_QUEUE;
+        client->length--;
+    }
+#if CONFIG_STREAM_TELNET_MCCP2
+    if (client->telnet != NULL)
+    {
+        if (client->compressing)
+        {
+            ESP_LOGI(TAG, "Client %d: COMPRESS2 sent %u bytes of Ascii85 as %u",
+                     (int) (client - clients), client->textBytes, client->wireBytes);
+        }
+        telnet_free(client->telnet);
+        client->telnet = NULL;
+    }
+    if (client->arena != NULL)
+    {
+        zlib_arena_give(client->arena);
+        client->arena = NULL;
+    }
+#endif
+    clientCount--;
+}
+
+/*
+  Tells the sample pool to shed blocks while every streaming client is backed
+  up: its socket would not take all of the last send and its queue is
+  full, so a block published now would only be skipped. Shedding at the
+  pool costs the capture side nothing and loses the same whole blocks.
+  Released as soon as any client has room, or there are no clients.
+  Never applied while the UDP stream is sending, as it never backs up.
+ */
+static void update_backpressure(void)
+{
+    bool backedUp = false;
+    
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        const stream_client_t *client = &clients[i];
+        if (client->sock < 0 || client->protocol == 0 || client->protocol == WIRE_HANDSHAKE_UDP)
+        {
+            continue;
+        }
+        if (client->resuming || !client->socketFull || client->length < STREAM_CLIENT_QUEUE)
+        {
+            backedUp = false;
+            break;
+        }
+        backedUp = true;
+    }
+#if CONFIG_STREAM_UDP_ENABLE
+    if (udp_stream_active())
+    {
+        backedUp = false;
+    }
+#endif
+    if (backedUp != backpressure)
+    {
+        backpressure = backedUp;
+        sample_pool_set_backpressure(backedUp);
+    }
+}
+
+void stream_server_close(void)
+{
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        if (clients[i].sock >= 0)
+        {
+            drop_client(&clients[i]);
+        }
+    }
+    if (listenSocket >= 0)
+    {
+        close(listenSocket);
+        listenSocket = -1;
+        ESP_LOGI(TAG, "Stopped listening");
+    }
+#if CONFIG_STREAM_UDP_ENABLE
+    udp_stream_close();
+#endif
+    update_backpressure();
+}
+
+#if CONFIG_STREAM_BINARY_LZ4
+/*
+  Compresses the payload into the client's frame if that makes it smaller.
+  A payload left in the scratch buffer is copied there instead. Blocks are
+  never empty, so neither is the payload.
+ */
+static void compress_payload(stream_client_t *client, const sample_block_t *block,
+                             uint8_t *flags, uint32_t *payloadSize)
+{
+    uint32_t start = XTHAL_GET_CCOUNT();
+    size_t compressedSize = lz4_block_compress(client->framePayload, *payloadSize, client->frameData,
+                                               *payloadSize - 1, &compressScratch.arena);
+    
+    stats_count(STATS_COMPRESS_CYCLES, XTHAL_GET_CCOUNT() - start);
+    stats_count(STATS_COMPRESS_IN, *payloadSize);
+    if (compressedSize > 0)
+    {
+        *flags |= WIRE_FLAG_LZ4;
+        *payloadSize = compressedSize;
+        client->framePayload = client->frameData;
+    }
+    else if (client->framePayload != block->samples)
+    {
+        memcpy(client->frameData, client->framePayload, *payloadSize);
+        client->framePayload = client->frameData;
+    }
+    stats_count(STATS_COMPRESS_OUT, *payloadSize);
+#if CONFIG_STREAM_THROUGHPUT_LOG
+    copied += client->framePayload == client->frameData ? *payloadSize : 0;
+#endif
+}
+#endif
+
+// Bytes a binary block takes with raw samples; no encoding makes it bigger.
+static size_t raw_frame_size(const sample_block_t *block)
+{
+    return sizeof(wire_header_t) + block->count * sizeof(block->samples[0]);
+}
+
+/*
+  Fills in the binary frame of the client's head block, when it starts to
+  send it: delta coded if selected and smaller, otherwise the samples as
+  they are, then compressed if selected and smaller. Encoding as each
+  client gets to a block, into its own frame, keeps the pool's blocks to
+  their samples.
+ */
+static void frame_block(stream_client_t *client, const sample_block_t *block)
+{
+    uint8_t encoding = WIRE_ENCODING_RAW;
+    uint8_t flags = STREAM_BLOCK_FLAGS;
+    uint32_t payloadSize = block->count * sizeof(block->samples[0]);
+    
+    client->framePayload = block->samples;
+#if CONFIG_STREAM_BINARY_DELTA_VARINT
+#if CONFIG_STREAM_BINARY_LZ4
+    uint8_t *coded = compressScratch.coded;
+#else
+    uint8_t *coded = client->frameData;
+#endif
+    size_t encodedSize = delta_varint_encode(block->samples, block->count, coded, payloadSize);
+    if (encodedSize > 0)
+    {
+        encoding = WIRE_ENCODING_DELTA_VARINT;
+        client->framePayload = coded;
+        payloadSize = encodedSize;
+#if CONFIG_STREAM_THROUGHPUT_LOG
+        copied += encodedSize;
+#endif
+    }
+#endif
+#if CONFIG_STREAM_BINARY_LZ4
+    compress_payload(client, block, &flags, &payloadSize);
+#endif
+    wire_header_init(&client->frameHeader, encoding, flags, STREAM_BLOCK_CLOCK_MHZ,
+                     block->sequence, block->count, block->channel, block->timestamp,
+                     client->framePayload, payloadSize);
+    client->framed = true;
+    client->unsent -= raw_frame_size(block) - (sizeof(client->frameHeader) + payloadSize);
+}
+
+// Ascii85 has no framing to say which channel a sample came from, so those
+// clients are sent channel 0 only. UDP sessions are sent nothing.
+static bool wants_block(const stream_client_t *client, const sample_block_t *block)
+{
+    return client->protocol == WIRE_HANDSHAKE_BINARY ||
+           (client->protocol == WIRE_HANDSHAKE_ASCII85 && block->channel == 0);
+}
+
+// Bytes a queued block not yet framed counts for in 'unsent'.
+static size_t frame_size(const stream_client_t *client, const sample_block_t *block)
+{
+    if (client->protocol == WIRE_HANDSHAKE_BINARY)
+    {
+        return raw_frame_size(block);
+    }
+    return block->count * BASE85_CHARS_PER_SAMPLE;
+}
+
+static void queue_block(stream_client_t *client, sample_block_t *block)
+{
+    client->queue[(client->head + client->length) % STREAM_CLIENT_QUEUE] = block;
+    client->length++;
+    client->unsent += frame_size(client, block);
+    block->refs++;
+}
+
+// Holds on to the newest block for clients that resume later. The oldest
+// block drops out once the ring is full.
+static void replay_add(sample_block_t *block)
+{
+#if STREAM_REPLAY_BLOCKS > 0
+    if (replayLength == STREAM_REPLAY_BLOCKS)
+    {
+        block_release(replay[replayHead]);
+        replayHead = (replayHead + 1) % STREAM_REPLAY_BLOCKS;
+        replayLength--;
+    }
+    replay[(replayHead + replayLength) % STREAM_REPLAY_BLOCKS] = block;
+    replayLength++;
+    block->refs++;
+#endif
+}
+
+// Oldest held block with a sequence number at or after 'sequence', or NULL.
+static sample_block_t *replay_find(uint32_t sequence)
+{
+#if STREAM_REPLAY_BLOCKS > 0
+    for (int i = 0; i < replayLength; i++)
+    {
+        sample_block_t *block = replay[(replayHead + i) % STREAM_REPLAY_BLOCKS];
+        if ((int32_t) (block->sequence - sequence) >= 0)
+        {
+            return block;
+        }
+    }
+#endif
+    return NULL;
+}
+
+/*
+  Tops up a resuming client's queue from the replay ring. Once it has been
+  given the newest block it goes back to receiving blocks as they are
+  published.
+ */
+static void replay_refill(stream_client_t *client)
+{
+    while (client->resuming && client->length < STREAM_CLIENT_QUEUE)
+    {
+        sample_block_t *block = replay_find(client->resumeSequence);
+        if (block == NULL)
+        {
+            client->resuming = false;
+            ESP_LOGI(TAG, "Client %d caught up", (int) (client - clients));
+            break;
+        }
+        if (block->sequence != client->resumeSequence)
+        {
+            ESP_LOGW(TAG, "Client %d: blocks %u to %u are no longer held", (int) (client - clients),
+                     client->resumeSequence, block->sequence - 1);
+        }
+        if (wants_block(client, block))
+        {
+            queue_block(client, block);
+        }
+        client->resumeSequence = block->sequence + 1;
+    }
+}
+
+static void publish(sample_block_t *block)
+{
+    TRACE(TRACE_PUBLISH, block->sequence);
+    block->refs = 0;
+#if CONFIG_STREAM_UDP_ENABLE
+    udp_stream_publish(block);
+#endif
+    replay_add(block);
+    
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        stream_client_t *client = &clients[i];
+        if (client->sock < 0 || client->protocol == 0)
+        {
+            continue;
+        }
+        if (client->resuming)
+        {
+            replay_refill(client);
+            continue;
+        }
+        if (!wants_block(client, block))
+        {
+            continue;
+        }
+        stats_sample(STATS_CLIENT_QUEUE, client->length);
+        stats_sample(STATS_CLIENT_BACKLOG_KB, client->unsent / 1024);
+        if (client->length == STREAM_CLIENT_QUEUE)
+        {
+            client->skipped++;
+            stats_count(STATS_BLOCKS_SKIPPED, 1);
+            ESP_LOGW(TAG, "Client %d too slow, skipped block %u (%u so far)",
+                     i, block->sequence, client->skipped);
+            continue;
+        }
+        queue_block(client, block);
+    }
+    
+    if (block->refs == 0)
+    {
+        sample_pool_release(block);
+    }
+}
+
+/*
+  Queues 'record' for 'client', or for every binary client if NULL.
+  Clients that have not yet finished sending it are skipped.
+ */
+static void queue_record(stream_record_t *record, stream_client_t *client)
+{
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        stream_client_t *target = &clients[i];
+        if ((client != NULL && target != client) || target->sock < 0 ||
+            target->protocol != WIRE_HANDSHAKE_BINARY)
+        {
+            continue;
+        }
+        bool queued = false;
+        for (int r = 0; r < target->recordCount; r++)
+        {
+            queued |= (target->records[r] == record);
+        }
+        if (!queued)
+        {
+            target->records[target->recordCount++] = record;
+            record->senders++;
+        }
+    }
+}
+
+static void render_stats(void)
+{
+    size_t length = stats_report(statsText, sizeof(statsText));
+    
+    statsRecord.payload = statsText;
+    wire_header_init(&statsRecord.header, WIRE_ENCODING_RAW, WIRE_FLAG_STATS, 0,
+                     0, 0, 0, esp_timer_get_time(), statsText, length);
+}
+
+// Queues a stats record for 'client', or for every binary client if NULL.
+static void queue_stats(stream_client_t *client)
+{
+    if (statsRecord.senders == 0)
+    {
+        render_stats();
+    }
+    queue_record(&statsRecord, client);
+}
+
+#if CONFIG_TRACE_ENABLE
+/*
+  Freezes the trace and queues a dump of it for 'client'. Clients asking
+  while a dump is still being sent share the same one.
+ */
+static void queue_trace(stream_client_t *client)
+{
+    if (traceRecord.senders == 0)
+    {
+        size_t size;
+        traceRecord.payload = trace_freeze(&size);
+        wire_header_init(&traceRecord.header, WIRE_ENCODING_RAW, WIRE_FLAG_TRACE,
+                         CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ, 0, 0, 0, esp_timer_get_time(),
+                         traceRecord.payload, size);
+    }
+    queue_record(&traceRecord, client);
+}
+#endif
+
+/*
+  Sends the rest of the client's oldest record. Returns false if the socket is
+  full or the client had to be dropped.
+ */
+static bool send_record(stream_client_t *client)
+{
+    const stream_record_t *record = client->records[0];
+    size_t frameSize = sizeof(record->header) + record->header.payload_size;
+    
+    while (client->recordOffset < frameSize)
+    {
+        const char *data;
+        size_t length;
+    
+        if (client->recordOffset < sizeof(record->header))
+        {
+            data = (const char *) &record->header + client->recordOffset;
+            length = sizeof(record->header) - client->recordOffset;
+        }
+        else
+        {
+            data = (const char *) record->payload + client->recordOffset - sizeof(record->header);
+            length = frameSize - client->recordOffset;
+        }
+        int sent = send(client->sock, data, length, MSG_DONTWAIT);
+        if (sent < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                ESP_LOGE(TAG, "Error occurred sending record: %s", strerror(errno));
+                drop_client(client);
+                return false;
+            }
+            stats_count(STATS_SEND_STALLS, 1);
+            client->socketFull = true;
+            return false;
+        }
+        stats_count(STATS_BYTES_SENT, sent);
+        client->recordOffset += sent;
+        if ((size_t) sent < length)
+        {
+            stats_count(STATS_SHORT_SENDS, 1);
+        }
+    }
+    record_done(client);
+    return true;
+}
+
+#if CONFIG_STREAM_TELNET_MCCP2
+/*
+  Sends what libtelnet has made of the client's stream. Returns false if the
+  socket is full or the client had to be dropped.
+ */
+static bool flush_telnet(stream_client_t *client)
+{
+    if (client->telnetOverflow)
+    {
+        ESP_LOGE(TAG, "Client %d: telnet output overflowed", (int) (client - clients));
+        drop_client(client);
+        return false;
+    }
+    while (client->telnetOffset < client->telnetLength)
+    {
+        size_t length = client->telnetLength - client->telnetOffset;
+    
+        TRACE(TRACE_SEND_BEGIN, client - clients);
+        int sent = send(client->sock, client->telnetOut + client->telnetOffset, length, MSG_DONTWAIT);
+        TRACE(TRACE_SEND_END, sent > 0 ? sent : 0);
+        if (sent < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                ESP_LOGE(TAG, "Error occurred sending data: %s", strerror(errno));
+                drop_client(client);
+                return false;
+            }
+            stats_count(STATS_SEND_STALLS, 1);
+            client->socketFull = true;
+            return false;
+        }
+        stats_count(STATS_BYTES_SENT, sent);
+        client->telnetOffset += sent;
+        if ((size_t) sent < length)
+        {
+            stats_count(STATS_SHORT_SENDS, 1);
+            client->socketFull = true;
+            return false;
+        }
+    }
+    client->telnetOffset = 0;
+    client->telnetLength = 0;
+    return true;
+}
+
+/*
+  How much of 'data' libtelnet can be given without the worst it could make
+  of it overflowing telnetOut.
+ */
+static size_t telnet_fit(const stream_client_t *client, const char *data, size_t length)
+{
+    size_t room = sizeof(client->telnetOut) - TELNET_REPLY_ROOM - client->telnetLength;
+    size_t iacs = 0;
+    
+    if (TELNET_OUT_BOUND(length, 0) <= room && memchr(data, TELNET_IAC, length) == NULL)
+    {
+        return length;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        size_t iac = ((unsigned char) data[i] == TELNET_IAC) ? 1 : 0;
+        if (TELNET_OUT_BOUND(i + 1, iacs + iac) > room)
+        {
+            return i;
+        }
+        iacs += iac;
+    }
+    return length;
+}
+#endif
+
+/*
+  Sends from the client's queue until it is empty or the socket is full.
+  A pending record goes out between two blocks. A telnet client's chunks go
+  through libtelnet, one at a time: each is sent before the next is made.
+  Returns false if the client had to be dropped.
+ */
+static bool send_client(stream_client_t *client)
+{
+    while (client->length > 0 || client->recordCount > 0)
+    {
+#if CONFIG_STREAM_TELNET_MCCP2
+        if (client->telnet != NULL && !flush_telnet(client))
+        {
+            return client->sock >= 0;
+        }
+#endif
+        if (client->recordCount > 0 && client->offset == 0)
+        {
+            if (!send_record(client))
+            {
+                return client->sock >= 0;
+            }
+            continue;
+        }
+    
+        sample_block_t *block = client->queue[client->head];
+        const char *data;
+        size_t length;
+        size_t frameSize;
+    
+        if (client->protocol == WIRE_HANDSHAKE_BINARY)
+        {
+            if (!client->framed)
+            {
+                frame_block(client, block);
+            }
+            frameSize = sizeof(client->frameHeader) + client->frameHeader.payload_size;
+            if (client->offset < sizeof(client->frameHeader))
+            {
+                data = (const char *) &client->frameHeader + client->offset;
+                length = sizeof(client->frameHeader) - client->offset;
+            }
+            else
+            {
+                data = (const char *) client->framePayload + client->offset - sizeof(client->frameHeader);
+                length = frameSize - client->offset;
+            }
+        }
+        else
+        {
+            frameSize = frame_size(client, block);
+            // Re-encode from the first sample not yet fully sent.
+            size_t first = client->offset / BASE85_CHARS_PER_SAMPLE;
+            size_t count = block->count - first;
+            if (count > TX_CHUNK_SAMPLES)
+            {
+                count = TX_CHUNK_SAMPLES;
+            }
+            length = base85_encode_block(&block->samples[first], count, txData);
+            data = txData + client->offset % BASE85_CHARS_PER_SAMPLE;
+            length -= client->offset % BASE85_CHARS_PER_SAMPLE;
+#if CONFIG_STREAM_THROUGHPUT_LOG
+            copied += length;
+#endif
+        }
+    
+        int sent;
+#if CONFIG_STREAM_TELNET_MCCP2
+        if (client->telnet != NULL)
+        {
+            // libtelnet puts all it is given, compressed or not, into
+            // telnetOut, so it is given no more than is sure to fit. The
+            // rest goes once that has been sent.
+            length = telnet_fit(client, data, length);
+            client->textBytes += length;
+            telnet_send(client->telnet, data, length);
+            sent = length;
+        }
+        else
+#endif
+        {
+            TRACE(TRACE_SEND_BEGIN, client - clients);
+            sent = send(client->sock, data, length, MSG_DONTWAIT);
+            TRACE(TRACE_SEND_END, sent > 0 ? sent : 0);
+            if (sent < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    stats_count(STATS_SEND_STALLS, 1);
+                    client->socketFull = true;
+                    return true;
+                }
+                ESP_LOGE(TAG, "Error occurred sending data: %s", strerror(errno));
+                drop_client(client);
+                return false;
+            }
+            stats_count(STATS_BYTES_SENT, sent);
+        }
+#if CONFIG_STREAM_THROUGHPUT_LOG
+        copied += sent;
+#endif
+        if (!client->firstSent)
+        {
+            client->firstSent = true;
+            ESP_LOGI(TAG, "Client %d: first data %lld us after connect", (int) (client - clients),
+                     (long long) (esp_timer_get_time() - client->connectTime));
+        }
+    
+        client->offset += sent;
+        client->unsent -= sent;
+        client->socketFull = false;
+        if (client->offset == frameSize)
+        {
+#if CONFIG_STREAM_THROUGHPUT_LOG
+            samplesSent += block->count;
+#endif
+            stats_sample(STATS_SEND_LATENCY_MS, (uint32_t) ((esp_timer_get_time() - block->submitted) / 1000));
+            block_release(block);
+            client->head = (client->head + 1) % STREAM_CLIENT_QUEUE;
+            client->length--;
+            client->offset = 0;
+            client->framed = false;
+            replay_refill(client);
+        }
+        else if ((size_t) sent < length)
+        {
+            // Socket buffer full. The rest goes from 'offset' when select()
+            // says there is room again.
+            stats_count(STATS_SHORT_SENDS, 1);
+            client->socketFull = true;
+            return true;
+        }
+    }
+#if CONFIG_STREAM_TELNET_MCCP2
+    if (client->telnet != NULL)
+    {
+        flush_telnet(client);
+    }
+#endif
+    return client->sock >= 0;
+}
+
+/*
+  Restarts the client's stream at 'sequence' from the replay ring. Queued
+  blocks not yet started are dropped; one already framed or part sent is
+  finished first so the stream stays framed, and may be repeated.
+ */
+static void resume_client(stream_client_t *client, uint32_t sequence)
+{
+    int keep = (client->offset > 0 || client->framed) ? 1 : 0;
+    
+    while (client->length > keep)
+    {
+        sample_block_t *block = client->queue[(client->head + client->length - 1) % STREAM_CLIENT_QUEUE];
+        client->unsent -= frame_size(client, block);
+        block_release(block);
+        client->length--;
+    }
+    ESP_LOGI(TAG, "Client %d resuming from block %u", (int) (client - clients), sequence);
+    client->resuming = true;
+    client->resumeSequence = sequence;
+    replay_refill(client);
+}
+
+/*
+  Commands are single lines of text:
+    R<sequence>   resume the stream from that block sequence number
+    stats         send a stats record (binary) or log one (Ascii85)
+    trace         send a dump of the trace rings (binary, CONFIG_TRACE_ENABLE)
+ */
+static void handle_command(stream_client_t *client, const char *command)
+{
+    char *end;
+    
+    if (command[0] == 'R')
+    {
+        unsigned long sequence = strtoul(command + 1, &end, 10);
+        if (end != command + 1 && *end == '\0')
+        {
+            resume_client(client, sequence);
+            return;
+        }
+    }
+    if (strcmp(command, "stats") == 0)
+    {
+        if (client->protocol == WIRE_HANDSHAKE_BINARY)
+        {
+            queue_stats(client);
+        }
+        else
+        {
+            // No framing to carry it in the Ascii85 stream.
+            if (statsRecord.senders == 0)
+            {
+                render_stats();
+            }
+            ESP_LOGI(TAG, "Stats:\n%s", statsText);
+        }
+        return;
+    }
+    if (strcmp(command, "trace") == 0)
+    {
+#if CONFIG_TRACE_ENABLE
+        if (client->protocol == WIRE_HANDSHAKE_BINARY)
+        {
+            queue_trace(client);
+            return;
+        }
+        ESP_LOGW(TAG, "Client %d: a trace can only be sent to binary clients", (int) (client - clients));
+#else
+        ESP_LOGW(TAG, "Client %d: tracing is not enabled (CONFIG_TRACE_ENABLE)", (int) (client - clients));
+#endif
+        return;
+    }
+    ESP_LOGW(TAG, "Client %d: unknown command '%s'", (int) (client - clients), command);
+}
+
+// Collects command lines from what the client has sent. A line too long
+// for any command is dropped whole rather than run cut short, where an
+// "R<sequence>" could resume from the wrong block.
+static void receive_commands(stream_client_t *client, const char *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        if (data[i] == '\r' || data[i] == '\n')
+        {
+            client->command[client->commandLength] = '\0';
+            if (client->commandOverlong)
+            {
+                ESP_LOGW(TAG, "Client %d: command '%s...' too long, ignored", (int) (client - clients),
+                         client->command);
+            }
+            else if (client->commandLength > 0)
+            {
+                handle_command(client, client->command);
+            }
+            client->commandLength = 0;
+            client->commandOverlong = false;
+        }
+        else if (client->commandLength < (int) sizeof(client->command) - 1)
+        {
+            client->command[client->commandLength++] = data[i];
+        }
+        else
+        {
+            client->commandOverlong = true;
+        }
+    }
+}
+
+#if CONFIG_STREAM_TELNET_MCCP2
+// The client said DO COMPRESS2: everything from here on is deflated, if
+// there is an arena to do it in.
+static void begin_compress(stream_client_t *client)
+{
+    if (client->arena != NULL)
+    {
+        return;
+    }
+    client->arena = zlib_arena_take();
+    if (client->arena == NULL)
+    {
+        ESP_LOGW(TAG, "Client %d: no zlib arena free - not compressing", (int) (client - clients));
+        return;
+    }
+    telnet_set_zlib(client->telnet, zlib_arena_alloc, zlib_arena_free, client->arena,
+                    CONFIG_STREAM_MCCP2_LEVEL, CONFIG_STREAM_MCCP2_WINDOW_BITS,
+                    CONFIG_STREAM_MCCP2_MEM_LEVEL);
+    telnet_begin_compress2(client->telnet);
+    if (!client->compressing)
+    {
+        // deflateInit2() failed; libtelnet has said why.
+        zlib_arena_give(client->arena);
+        client->arena = NULL;
+        return;
+    }
+    ESP_LOGI(TAG, "Client %d: COMPRESS2 using %u of %u arena bytes", (int) (client - clients),
+             (unsigned) client->arena->used, (unsigned) ZLIB_ARENA_SIZE);
+}
+
+static void telnet_event(telnet_t *telnet, telnet_event_t *event, void *userData)
+{
+    stream_client_t *client = userData;
+    
+    switch (event->type)
+    {
+        case TELNET_EV_SEND:
+            if (event->data.size > sizeof(client->telnetOut) - client->telnetLength)
+            {
+                client->telnetOverflow = true;
+                break;
+            }
+            memcpy(client->telnetOut + client->telnetLength, event->data.buffer, event->data.size);
+            client->telnetLength += event->data.size;
+            client->wireBytes += event->data.size;
+            break;
+        case TELNET_EV_DATA:
+            receive_commands(client, event->data.buffer, event->data.size);
+            break;
+        case TELNET_EV_DO:
+            if (event->neg.telopt == TELNET_TELOPT_COMPRESS2)
+            {
+                begin_compress(client);
+            }
+            break;
+        case TELNET_EV_COMPRESS:
+            client->compressing = event->compress.state != 0;
+            break;
+        case TELNET_EV_WARNING:
+        case TELNET_EV_ERROR:
+            ESP_LOGW(TAG, "Client %d telnet: %s", (int) (client - clients), event->error.msg);
+            break;
+        default:
+            break;
+    }
+}
+
+static void start_telnet(stream_client_t *client)
+{
+    client->telnet = telnet_init(telnetOptions, telnet_event, 0, client);
+    if (client->telnet == NULL)
+    {
+        ESP_LOGE(TAG, "Client %d: no memory for telnet", (int) (client - clients));
+        return;
+    }
+    // Only offered while there is an arena to accept it with.
+    if (zlib_arena_available())
+    {
+        telnet_negotiate(client->telnet, TELNET_WILL, TELNET_TELOPT_COMPRESS2);
+    }
+}
+#endif
+
+/*
+  The client picks its protocol by sending a single byte straight after
+  connecting. Any other first byte, or nothing, gets the configured default.
+  With CONFIG_STREAM_TELNET_MCCP2 a client that opens with a telnet command,
+  or that sends nothing where Ascii85 is the default, is taken to be a
+  telnet client and offered COMPRESS2.
+ */
+static void set_protocol(stream_client_t *client, char protocol)
+{
+    bool telnet = false;
+    
+#if CONFIG_STREAM_TELNET_MCCP2
+    if ((unsigned char) protocol == TELNET_IAC)
+    {
+        protocol = WIRE_HANDSHAKE_ASCII85;
+        telnet = true;
+    }
+#endif
+    if (protocol != WIRE_HANDSHAKE_BINARY && protocol != WIRE_HANDSHAKE_ASCII85 &&
+        protocol != WIRE_HANDSHAKE_UDP)
+    {
+#if CONFIG_STREAM_DEFAULT_BINARY
+        protocol = WIRE_HANDSHAKE_BINARY;
+#else
+        protocol = WIRE_HANDSHAKE_ASCII85;
+#if CONFIG_STREAM_TELNET_MCCP2
+        telnet = true;
+#endif
+#endif
+    }
+    client->protocol = protocol;
+#if CONFIG_STREAM_TELNET_MCCP2
+    if (telnet)
+    {
+        start_telnet(client);
+        telnet = client->telnet != NULL;
+    }
+#endif
+    ESP_LOGI(TAG, "Client %d protocol: %s", (int) (client - clients),
+             protocol == WIRE_HANDSHAKE_BINARY ? "binary" : protocol == WIRE_HANDSHAKE_UDP ? "UDP session" :
+             telnet ? "Ascii85 (telnet)" : "Ascii85");
+}
+
+/*
+  Reads whatever the client has sent. Returns false if the client has gone.
+ */
+static bool receive_client(stream_client_t *client)
+{
+    char rxData[64];
+    
+    int received = recv(client->sock, rxData, sizeof(rxData), MSG_DONTWAIT);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return true;
+    }
+    if (received <= 0)
+    {
+        drop_client(client);
+        return false;
+    }
+    int i = 0;
+    if (client->protocol == 0)
+    {
+        set_protocol(client, rxData[0]);
+        // Only a selection byte is taken. Anything else, such as a telnet
+        // command or the 'R' of a resume, is the start of what the client
+        // has to say in the default protocol.
+        if (rxData[0] == WIRE_HANDSHAKE_BINARY || rxData[0] == WIRE_HANDSHAKE_ASCII85 ||
+            rxData[0] == WIRE_HANDSHAKE_UDP)
+        {
+            i = 1;
+        }
+    }
+#if CONFIG_STREAM_TELNET_MCCP2
+    if (client->telnet != NULL)
+    {
+        telnet_recv(client->telnet, rxData + i, received - i);
+        return true;
+    }
+#endif
+    receive_commands(client, rxData + i, received - i);
+    return true;
+}
+
+// Blocks or records queued, or telnet output not yet sent.
+static bool has_output(const stream_client_t *client)
+{
+#if CONFIG_STREAM_TELNET_MCCP2
+    if (client->telnetLength > 0 || client->telnetOverflow)
+    {
+        return true;
+    }
+#endif
+    return client->length > 0 || client->recordCount > 0;
+}
+
+void stream_server_poll(void)
+{
+    fd_set readSet;
+    fd_set writeSet;
+    int maxSocket = wakeSocket;
+    int64_t now = esp_timer_get_time();
+    int64_t wait = 1000000;     // Check in at least once a second.
+    
+    FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
+    FD_SET(wakeSocket, &readSet);
+#if CONFIG_STREAM_UDP_ENABLE
+    if (udp_stream_socket() >= 0)
+    {
+        FD_SET(udp_stream_socket(), &readSet);
+        if (udp_stream_socket() > maxSocket)
+        {
+            maxSocket = udp_stream_socket();
+        }
+    }
+#endif
+    if (listenSocket >= 0)
+    {
+        FD_SET(listenSocket, &readSet);
+        if (listenSocket > maxSocket)
+        {
+            maxSocket = listenSocket;
+        }
+    }
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        stream_client_t *client = &clients[i];
+        if (client->sock < 0)
+        {
+            continue;
+        }
+        FD_SET(client->sock, &readSet);
+        if (has_output(client))
+        {
+            FD_SET(client->sock, &writeSet);
+        }
+        if (client->sock > maxSocket)
+        {
+            maxSocket = client->sock;
+        }
+        if (client->protocol == 0)
+        {
+            int64_t deadline = client->connectTime + CONFIG_STREAM_HANDSHAKE_TIMEOUT_MS * 1000;
+            if (deadline - now < wait)
+            {
+                wait = (deadline > now) ? deadline - now : 0;
+            }
+        }
+    }
+    
+    struct timeval timeout = {
+        .tv_sec = wait / 1000000,
+        .tv_usec = wait % 1000000,
+    };
+    int ready = select(maxSocket + 1, &readSet, &writeSet, NULL, &timeout);
+    if (ready < 0)
+    {
+        ESP_LOGE(TAG, "select() failed: %s", strerror(errno));
+        return;
+    }
+    TRACE(TRACE_POLL, ready);
+    TRACE_SYNC();
+    now = esp_timer_get_time();
+    
+    if (FD_ISSET(wakeSocket, &readSet))
+    {
+        char wake[16];
+        while (recv(wakeSocket, wake, sizeof(wake), MSG_DONTWAIT) > 0)
+        {
+        }
+    }
+    // Blocks are collected on every pass, so a lost wake-up only delays them.
+    stats_sample(STATS_READY_BLOCKS, sample_pool_waiting());
+    sample_block_t *block;
+    while ((block = sample_pool_receive(0)) != NULL)
+    {
+        publish(block);
+    }
+    
+    if (listenSocket >= 0 && FD_ISSET(listenSocket, &readSet))
+    {
+        accept_client();
+    }
+#if CONFIG_STREAM_UDP_ENABLE
+    if (udp_stream_socket() >= 0 && FD_ISSET(udp_stream_socket(), &readSet))
+    {
+        udp_stream_receive();
+    }
+#endif
+    
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++)
+    {
+        stream_client_t *client = &clients[i];
+        if (client->sock < 0)
+        {
+            continue;
+        }
+        if (FD_ISSET(client->sock, &readSet) && !receive_client(client))
+        {
+            continue;
+        }
+        if (client->protocol == 0 &&
+            now - client->connectTime >= CONFIG_STREAM_HANDSHAKE_TIMEOUT_MS * 1000)
+        {
+            set_protocol(client, 0);
+        }
+        if (has_output(client))
+        {
+            send_client(client);
+        }
+    }
+    update_backpressure();
+    
+#if CONFIG_STREAM_STATS_INTERVAL_S > 0
+    if (now - statsTime >= CONFIG_STREAM_STATS_INTERVAL_S * 1000000LL)
+    {
+        statsTime = now;
+        queue_stats(NULL);
+    }
+#endif
+    
+#if CONFIG_STREAM_THROUGHPUT_LOG
+    if (xTaskGetTickCount() - logTime >= pdMS_TO_TICKS(1000))
+    {
+        if (samplesSent > 0)
+        {
+            ESP_LOGI(TAG, "Transmit: %u samples/s to %d clients, %u.%02u bytes copied/sample",
+                     samplesSent, clientCount, copied / samplesSent,
+                     (copied % samplesSent) * 100 / samplesSent);
+        }
+        samplesSent = 0;
+        copied = 0;
+        logTime = xTaskGetTickCount();
+    }
+#endif
+}
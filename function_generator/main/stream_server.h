@@ -0,0 +1,112 @@
+/* Stream Server
+
+   Fans sample blocks out to every connected client.
+
+   Blocks from every capture channel are sent to binary clients in the order
+   they were filled, each tagged with its channel in the frame header.
+   Ascii85 clients are sent channel 0 only.
+
+   Each client has its own short queue of blocks and its own send position,
+   and is written with non-blocking sends, so one slow client cannot hold up
+   the others. A block that arrives while a client's queue is full is
+   skipped for that client only and counted; binary clients see the gap in
+   the block sequence numbers.
+
+   A send() the socket only partly takes is carried on from where it
+   stopped once select() reports room, so frames are never cut short. Each
+   client keeps count of the bytes queued for it that its socket has yet to
+   take, and whether its socket is full. When every client's socket is full
+   and its queue too, the sample pool is told to shed blocks at submit (see
+   sample_pool.h) until one of them has room again.
+
+   Blocks are reference counted by the clients queueing them and go back to
+   the sample pool once the last client has sent them. A binary client
+   encodes the frame of each block (header and payload) into a frame buffer
+   of its own when it starts to send it, so pool and replay blocks hold only
+   their samples. Until then a queued block counts towards the client's
+   unsent bytes at its raw size. Ascii85 is a fixed 5:4 mapping of the
+   samples, so it is generated a TCP segment at a time as each client sends
+   rather than held in memory.
+
+   The server is driven by one task calling stream_server_poll() in a loop.
+   Each call blocks in select() on the listening socket, every client socket
+   and a loopback wake-up socket, so the task sleeps until a connection
+   arrives, a client sends or can take more data, or a block is ready.
+   Newly accepted clients have CONFIG_STREAM_HANDSHAKE_TIMEOUT_MS to choose a
+   protocol before they are given the default. A first byte that is not a
+   choice gets the default at once, and is read as the client's first
+   input rather than lost.
+
+   The last STREAM_REPLAY_BLOCKS blocks are held back from the pool in a
+   replay ring. A client that reconnects can send "R<sequence>\n" to have
+   the held blocks from that sequence number on sent at full speed before it
+   rejoins the live stream.
+
+   Every CONFIG_STREAM_STATS_INTERVAL_S, and when a client sends "stats\n",
+   binary clients are sent a stats record (WIRE_FLAG_STATS) between two
+   blocks. See stats.h. A binary client that sends "trace\n" is sent a dump
+   of the trace rings (WIRE_FLAG_TRACE) the same way. See trace.h.
+
+   With CONFIG_STREAM_TELNET_MCCP2 an Ascii85 client that sends nothing, or
+   opens with a telnet command, is sent the stream through libtelnet and
+   offered COMPRESS2. Each chunk is handed to libtelnet, which deflates it
+   into the client's telnet buffer, and that is sent before the next chunk
+   is made. A client that accepts while every zlib arena is taken (see
+   zlib_arena.h) is sent the stream uncompressed.
+
+   With CONFIG_STREAM_UDP_ENABLE every block is also sent as UDP datagrams
+   to the UDP stream's subscribers, from the same task. See udp_stream.h.
+   Only an address with a client connected from it may subscribe; a client
+   that sends WIRE_HANDSHAKE_UDP holds that session and is sent nothing
+   else, and the subscriber is counted by it.
+
+   Every function except stream_server_wake() must be called from the task
+   that owns the server.
+*/
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include <stdbool.h>
+
+#include "sample_pool.h"
+#include "wire_format.h"
+
+#define STREAM_MAX_CLIENTS CONFIG_STREAM_MAX_CLIENTS
+#define STREAM_CLIENT_QUEUE CONFIG_STREAM_CLIENT_QUEUE
+#define STREAM_REPLAY_BLOCKS CONFIG_STREAM_REPLAY_BLOCKS
+
+// Header flags and clock of every sample block sent.
+#if CONFIG_STREAM_CONTENT_SUMMARIES
+#define STREAM_BLOCK_FLAGS WIRE_FLAG_SUMMARY
+#define STREAM_BLOCK_CLOCK_MHZ CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ
+#elif CONFIG_CAPTURE_FORMAT_EDGE_TIME
+#define STREAM_BLOCK_FLAGS WIRE_FLAG_EDGE_TIME
+#define STREAM_BLOCK_CLOCK_MHZ CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ
+#else
+#define STREAM_BLOCK_FLAGS 0
+#define STREAM_BLOCK_CLOCK_MHZ 0
+#endif
+
+void stream_server_init(void);
+
+// Opens the listening socket. Returns false if it could not be created.
+bool stream_server_listen(int port);
+
+// Drops every client and closes the listening socket.
+void stream_server_close(void);
+
+// Wakes stream_server_poll() to collect newly submitted blocks. Safe to call
+// from any task.
+void stream_server_wake(void);
+
+// Waits for socket or block activity, for at most a second, then accepts,
+// reads, publishes and sends whatever is ready.
+void stream_server_poll(void);
+
+// True if a client is connected from 'addr', an IPv4 address in network
+// byte order.
+bool stream_server_has_peer(uint32_t addr);
+
+int stream_server_client_count(void);
+
+#endif // STREAM_SERVER_H
@@ -0,0 +1,80 @@
+/* Hot-Path Trace
+
+   See trace.h.
+*/
+#include "sdkconfig.h"
+
+#if CONFIG_TRACE_ENABLE
+
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+#include "trace.h"
+
+static const char* TAG = "trace";
+
+__NOINIT_ATTR trace_buffer_t trace_buffer;
+volatile bool trace_recording = false;
+
+static void trace_clear(void)
+{
+    memset(&trace_buffer, 0, sizeof(trace_buffer));
+    trace_buffer.header.magic = TRACE_MAGIC;
+    trace_buffer.header.version = TRACE_VERSION;
+    trace_buffer.header.cores = portNUM_PROCESSORS;
+    trace_buffer.header.clock_mhz = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+    trace_buffer.header.events = TRACE_RING_EVENTS;
+}
+
+void trace_init(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    
+    // The rings survive a software reset, so a crash leaves its last events
+    // behind. Keep them until they have been dumped.
+    if (trace_buffer.header.magic == TRACE_MAGIC &&
+        trace_buffer.header.version == TRACE_VERSION &&
+        trace_buffer.header.events == TRACE_RING_EVENTS &&
+        (reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT ||
+         reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT))
+    {
+        trace_buffer.header.flags |= TRACE_DUMP_BEFORE_RESET;
+        ESP_LOGW(TAG, "Kept the trace from before the reset; recording resumes once it is dumped");
+        return;
+    }
+    trace_clear();
+    trace_recording = true;
+    ESP_LOGI(TAG, "Recording %d events per core", TRACE_RING_EVENTS);
+}
+
+void trace_sync(void)
+{
+    if (trace_recording)
+    {
+        trace_core_header_t *header = &trace_buffer.rings[xPortGetCoreID()].header;
+        header->syncTime = esp_timer_get_time();
+        header->syncCcount = XTHAL_GET_CCOUNT();
+    }
+}
+
+const void *trace_freeze(size_t *size)
+{
+    trace_recording = false;
+    *size = sizeof(trace_buffer);
+    return &trace_buffer;
+}
+
+void trace_resume(void)
+{
+    // Events from before a reset cannot be placed in time against new ones.
+    if (trace_buffer.header.flags & TRACE_DUMP_BEFORE_RESET)
+    {
+        trace_clear();
+    }
+    trace_recording = true;
+}
+
+#endif // CONFIG_TRACE_ENABLE
@@ -0,0 +1,91 @@
+/* Hot-Path Trace
+
+   A flight recorder for the capture and streaming hot paths, built in with
+   CONFIG_TRACE_ENABLE. TRACE() records an event (see trace_format.h) with
+   the core's cycle counter and a 24 bit argument into that core's ring,
+   overwriting the oldest once the ring is full. Recording is a slot
+   reservation with one atomic add and two stores, so it is safe from ISRs
+   and from tasks on both cores and costs a few tens of cycles. Without
+   CONFIG_TRACE_ENABLE, TRACE() and TRACE_SYNC() compile to nothing.
+
+   The rings are in memory that is not cleared on a software reset. If the
+   board restarts after a panic or watchdog, the trace from before the
+   reset is kept, with recording stopped, until it has been dumped once.
+
+   A binary client dumps the rings by sending "trace\n"; they are sent as
+   one WIRE_FLAG_TRACE frame and recording pauses until every client has
+   been sent it. tools/trace2json converts a dump to Chrome trace JSON for
+   chrome://tracing or Perfetto.
+
+   Each core must call TRACE_SYNC() regularly, at least every few seconds,
+   to record how its cycle counter relates to esp_timer time.
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "trace_format.h"
+
+#if CONFIG_TRACE_ENABLE
+
+#include "freertos/FreeRTOS.h"
+#include "xtensa/core-macros.h"
+
+#define TRACE_RING_EVENTS CONFIG_TRACE_EVENTS
+
+_Static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) == 0,
+               "CONFIG_TRACE_EVENTS must be a power of two");
+
+typedef struct
+{
+    trace_core_header_t header;
+    trace_record_t records[TRACE_RING_EVENTS];
+} trace_ring_t;
+
+// The dump, laid out as trace_format.h describes.
+typedef struct
+{
+    trace_dump_header_t header;
+    trace_ring_t rings[portNUM_PROCESSORS];
+} trace_buffer_t;
+
+extern trace_buffer_t trace_buffer;
+extern volatile bool trace_recording;
+
+static inline void trace_event(trace_event_t event, uint32_t arg)
+{
+    if (trace_recording)
+    {
+        trace_ring_t *ring = &trace_buffer.rings[xPortGetCoreID()];
+        uint32_t slot = __atomic_fetch_add(&ring->header.head, 1, __ATOMIC_RELAXED)
+                        & (TRACE_RING_EVENTS - 1);
+        ring->records[slot].ccount = XTHAL_GET_CCOUNT();
+        ring->records[slot].word = ((uint32_t) event << 24) | (arg & TRACE_ARG_MAX);
+    }
+}
+
+#define TRACE(event, arg) trace_event(event, arg)
+#define TRACE_SYNC() trace_sync()
+
+// Starts recording, or keeps the trace from before a panic reset.
+void trace_init(void);
+
+// Records the calling core's cycle counter against esp_timer time.
+void trace_sync(void);
+
+// Stops recording and returns the rings to dump.
+const void *trace_freeze(size_t *size);
+
+// Starts recording again after trace_freeze().
+void trace_resume(void);
+
+#else
+
+#define TRACE(event, arg) ((void) 0)
+#define TRACE_SYNC() ((void) 0)
+
+#endif // CONFIG_TRACE_ENABLE
+
+#endif // TRACE_H
@@ -0,0 +1,90 @@
+/* Trace Format
+
+   Layout of a trace dump, as sent in a WIRE_FLAG_TRACE frame and read by
+   tools/trace2json.
+
+   A dump is a trace_dump_header_t followed, for each core, by a
+   trace_core_header_t and 'events' trace_record_t slots. Each core's slots
+   are a ring: slot (n % events) holds the n-th record the core wrote, so
+   the newest record is in slot (head - 1) % events, and only the last
+   'events' records written (or 'head', if fewer) are present.
+
+   Records are stamped with the core's 32 bit cycle counter (CCOUNT). The
+   cycle counters of the two cores are not aligned and wrap every 2^32
+   cycles, so each core's header also gives one CCOUNT value with the
+   esp_timer time (microseconds since boot) it was read at. Times are
+   recovered by working back from the newest record through the
+   differences between neighbours, which assumes no core goes 2^31 cycles
+   (13 s at 160 MHz) without a record.
+
+   No ESP-IDF dependencies; shared with the host-side tools.
+*/
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC 0x45435254u     // "TRCE"
+#define TRACE_VERSION 1
+
+#define TRACE_ARG_MAX 0x00FFFFFFu
+
+/*
+  Events, with their name and Chrome trace phase: 'B' and 'E' begin and end
+  a span of the same name, 'i' is an instant.
+ */
+#define TRACE_EVENTS(X) \
+    X(TRACE_ISR_ENTER,      "isr",          'B')    /* arg: GPIO */                 \
+    X(TRACE_ISR_EXIT,       "isr",          'E')                                    \
+    X(TRACE_EDGE_OVERRUN,   "edge overrun", 'i')    /* arg: GPIO */                 \
+    X(TRACE_NOTIFY,         "notify",       'i')    /* arg: GPIO of the full ring */\
+    X(TRACE_WAIT_BEGIN,     "wait",         'B')                                    \
+    X(TRACE_WAIT_END,       "wait",         'E')                                    \
+    X(TRACE_DRAIN,          "drain",        'i')    /* arg: samples read */         \
+    X(TRACE_BLOCK_SUBMIT,   "block submit", 'i')    /* arg: sequence */             \
+    X(TRACE_BLOCK_DROP,     "block drop",   'i')    /* arg: sequence */             \
+    X(TRACE_WAKE,           "wake",         'i')                                    \
+    X(TRACE_POLL,           "poll",         'i')    /* arg: sockets ready */        \
+    X(TRACE_PUBLISH,        "publish",      'i')    /* arg: sequence */             \
+    X(TRACE_SEND_BEGIN,     "send",         'B')    /* arg: client */               \
+    X(TRACE_SEND_END,       "send",         'E')    /* arg: bytes sent */
+
+#define TRACE_EVENT_ID(id, name, phase) id,
+typedef enum
+{
+    TRACE_NONE,
+    TRACE_EVENTS(TRACE_EVENT_ID)
+    TRACE_EVENT_COUNT
+} trace_event_t;
+#undef TRACE_EVENT_ID
+
+typedef struct
+{
+    uint32_t ccount;        // CCOUNT when the event was recorded.
+    uint32_t word;          // Event in the top 8 bits, argument in the low 24.
+} trace_record_t;
+
+typedef struct
+{
+    uint32_t magic;         // TRACE_MAGIC
+    uint16_t version;       // TRACE_VERSION
+    uint8_t cores;
+    uint8_t clock_mhz;      // CCOUNT ticks per microsecond.
+    uint32_t events;        // Slots per core, a power of two.
+    uint32_t flags;         // TRACE_DUMP_*
+} trace_dump_header_t;
+
+#define TRACE_DUMP_BEFORE_RESET 0x01    // Recorded before the last reset.
+
+typedef struct
+{
+    uint32_t head;          // Records written by this core.
+    uint32_t syncCcount;    // A CCOUNT value...
+    int64_t syncTime;       // ...and the esp_timer time it was read at.
+} trace_core_header_t;
+
+_Static_assert(sizeof(trace_record_t) == 8, "trace_record_t must be 8 bytes");
+_Static_assert(sizeof(trace_dump_header_t) == 16, "trace_dump_header_t must be 16 bytes");
+_Static_assert(sizeof(trace_core_header_t) == 16, "trace_core_header_t must be 16 bytes");
+
+#endif // TRACE_FORMAT_H
@@ -0,0 +1,283 @@
+/* UDP Stream
+
+   See udp_stream.h.
+*/
+#include "sdkconfig.h"
+
+#if CONFIG_STREAM_UDP_ENABLE
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "lwip/sockets.h"
+#include <fcntl.h>
+
+#include "udp_stream.h"
+#include "stream_server.h"
+#include "edge_stats.h"
+#include "stats.h"
+
+// Summaries are whole records or nothing.
+#if CONFIG_STREAM_CONTENT_SUMMARIES
+#define DATAGRAM_UNIT EDGE_SUMMARY_WORDS
+#else
+#define DATAGRAM_UNIT 1
+#endif
+#define DATAGRAM_SAMPLES (UDP_STREAM_DATAGRAM_SAMPLES / DATAGRAM_UNIT * DATAGRAM_UNIT)
+
+_Static_assert(DATAGRAM_SAMPLES > 0, "CONFIG_STREAM_UDP_DATAGRAM_SIZE too small for one summary");
+
+#define UNSUBSCRIBE 'X'
+
+typedef struct
+{
+    struct sockaddr_in addr;
+    int64_t expires;            // esp_timer time; 0 when the slot is free.
+} subscriber_t;
+
+static const char* TAG = "udp stream";
+
+static int udpSocket = -1;
+static subscriber_t subscribers[UDP_STREAM_MAX_SUBSCRIBERS];
+static int subscriberCount = 0;
+static struct sockaddr_in groupAddr;
+static bool haveGroup = false;
+static uint32_t sequence = 0;
+
+static struct
+{
+    wire_header_t header;
+    int32_t samples[DATAGRAM_SAMPLES];
+} datagram;
+
+bool udp_stream_open(int port)
+{
+    struct sockaddr_in addr;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    
+    udpSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (udpSocket < 0)
+    {
+        ESP_LOGE(TAG, "Unable to create socket: %s", strerror(errno));
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(udpSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    fcntl(udpSocket, F_SETFL, fcntl(udpSocket, F_GETFL, 0) | O_NONBLOCK);
+    if (bind(udpSocket, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        ESP_LOGE(TAG, "Socket unable to bind: %s", strerror(errno));
+        close(udpSocket);
+        udpSocket = -1;
+        return false;
+    }
+    
+    haveGroup = false;
+    if (strlen(CONFIG_STREAM_UDP_MULTICAST_GROUP) > 0)
+    {
+        memset(&groupAddr, 0, sizeof(groupAddr));
+        groupAddr.sin_family = AF_INET;
+        groupAddr.sin_port = htons(port);
+        if (inet_aton(CONFIG_STREAM_UDP_MULTICAST_GROUP, &groupAddr.sin_addr) == 0)
+        {
+            ESP_LOGE(TAG, "Bad multicast group %s", CONFIG_STREAM_UDP_MULTICAST_GROUP);
+        }
+        else
+        {
+            // Keep to the local network.
+            uint8_t ttl = 1;
+            setsockopt(udpSocket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+            haveGroup = true;
+        }
+    }
+    ESP_LOGI(TAG, "Listening for subscriptions on UDP port %d%s%s", port,
+             haveGroup ? ", sending to " : "", haveGroup ? CONFIG_STREAM_UDP_MULTICAST_GROUP : "");
+    return true;
+}
+
+void udp_stream_close(void)
+{
+    memset(subscribers, 0, sizeof(subscribers));
+    subscriberCount = 0;
+    haveGroup = false;
+    if (udpSocket >= 0)
+    {
+        close(udpSocket);
+        udpSocket = -1;
+    }
+}
+
+int udp_stream_socket(void)
+{
+    return udpSocket;
+}
+
+int udp_stream_subscriber_count(void)
+{
+    return subscriberCount;
+}
+
+bool udp_stream_active(void)
+{
+    return subscriberCount > 0 || haveGroup;
+}
+
+static subscriber_t *find_subscriber(const struct sockaddr_in *addr)
+{
+    for (int i = 0; i < UDP_STREAM_MAX_SUBSCRIBERS; i++)
+    {
+        subscriber_t *subscriber = &subscribers[i];
+        if (subscriber->expires != 0 && subscriber->addr.sin_port == addr->sin_port &&
+            subscriber->addr.sin_addr.s_addr == addr->sin_addr.s_addr)
+        {
+            return subscriber;
+        }
+    }
+    return NULL;
+}
+
+static void subscribe(const struct sockaddr_in *addr, int64_t now)
+{
+    subscriber_t *subscriber = find_subscriber(addr);
+    
+    // The source address of a datagram is easily forged, so it alone would
+    // let anyone turn the stream on a third party. A TCP connection cannot
+    // be opened from a forged address.
+    if (!stream_server_has_peer(addr->sin_addr.s_addr))
+    {
+        stats_count(STATS_SUBSCRIPTIONS_REFUSED, 1);
+        return;
+    }
+    if (subscriber == NULL)
+    {
+        for (int i = 0; i < UDP_STREAM_MAX_SUBSCRIBERS && subscriber == NULL; i++)
+        {
+            if (subscribers[i].expires == 0)
+            {
+                subscriber = &subscribers[i];
+            }
+        }
+        if (subscriber == NULL)
+        {
+            ESP_LOGW(TAG, "Too many subscribers - ignoring %s:%d",
+                     inet_ntoa(addr->sin_addr), ntohs(addr->sin_port));
+            return;
+        }
+        subscriber->addr = *addr;
+        subscriberCount++;
+        ESP_LOGI(TAG, "Subscriber %s:%d, %d subscribed",
+                 inet_ntoa(addr->sin_addr), ntohs(addr->sin_port), subscriberCount);
+    }
+    subscriber->expires = now + CONFIG_STREAM_UDP_SUBSCRIPTION_S * 1000000LL;
+}
+
+static void unsubscribe(subscriber_t *subscriber, const char *reason)
+{
+    subscriber->expires = 0;
+    subscriberCount--;
+    ESP_LOGI(TAG, "Subscriber %s:%d %s, %d subscribed", inet_ntoa(subscriber->addr.sin_addr),
+             ntohs(subscriber->addr.sin_port), reason, subscriberCount);
+}
+
+void udp_stream_receive(void)
+{
+    char command[16];
+    struct sockaddr_in source;
+    socklen_t sourceLength = sizeof(source);
+    int64_t now = esp_timer_get_time();
+    int received;
+    
+    while ((received = recvfrom(udpSocket, command, sizeof(command), MSG_DONTWAIT,
+                                (struct sockaddr *)&source, &sourceLength)) > 0)
+    {
+        if (command[0] == WIRE_HANDSHAKE_BINARY)
+        {
+            subscribe(&source, now);
+        }
+        else if (command[0] == UNSUBSCRIBE)
+        {
+            subscriber_t *subscriber = find_subscriber(&source);
+            if (subscriber != NULL)
+            {
+                unsubscribe(subscriber, "unsubscribed");
+            }
+        }
+        sourceLength = sizeof(source);
+    }
+}
+
+static void send_datagram(size_t length, const struct sockaddr_in *addr)
+{
+    // Never waits: a datagram the stack cannot take now would be late anyway.
+    if (sendto(udpSocket, &datagram, length, MSG_DONTWAIT, (const struct sockaddr *)addr, sizeof(*addr)) < 0)
+    {
+        stats_count(STATS_DATAGRAMS_DROPPED, 1);
+        return;
+    }
+    stats_count(STATS_DATAGRAMS_SENT, 1);
+    stats_count(STATS_BYTES_SENT, length);
+}
+
+void udp_stream_publish(const sample_block_t *block)
+{
+    int64_t now = esp_timer_get_time();
+    
+    for (int i = 0; i < UDP_STREAM_MAX_SUBSCRIBERS; i++)
+    {
+        if (subscribers[i].expires != 0 && subscribers[i].expires < now)
+        {
+            unsubscribe(&subscribers[i], "expired");
+        }
+        else if (subscribers[i].expires != 0 && !stream_server_has_peer(subscribers[i].addr.sin_addr.s_addr))
+        {
+            unsubscribe(&subscribers[i], "disconnected");
+        }
+    }
+    if (udpSocket < 0 || !udp_stream_active())
+    {
+        return;
+    }
+    
+    uint64_t timestamp = block->timestamp;
+    for (uint32_t first = 0; first < block->count; )
+    {
+        uint32_t count = block->count - first;
+        if (count > DATAGRAM_SAMPLES)
+        {
+            count = DATAGRAM_SAMPLES;
+        }
+        memcpy(datagram.samples, &block->samples[first], count * sizeof(int32_t));
+        wire_header_init(&datagram.header, WIRE_ENCODING_RAW, STREAM_BLOCK_FLAGS | WIRE_FLAG_DATAGRAM,
+                         STREAM_BLOCK_CLOCK_MHZ, sequence++, count, block->channel, timestamp,
+                         datagram.samples, count * sizeof(int32_t));
+        size_t length = sizeof(datagram.header) + count * sizeof(int32_t);
+        for (int i = 0; i < UDP_STREAM_MAX_SUBSCRIBERS; i++)
+        {
+            if (subscribers[i].expires != 0)
+            {
+                send_datagram(length, &subscribers[i].addr);
+            }
+        }
+        if (haveGroup)
+        {
+            send_datagram(length, &groupAddr);
+        }
+    
+#if CONFIG_CAPTURE_FORMAT_EDGE_TIME && !CONFIG_STREAM_CONTENT_SUMMARIES
+        // The next datagram's records are measured from the end of these.
+        for (uint32_t i = 0; i < count; i++)
+        {
+            timestamp += (uint32_t) block->samples[first + i] >> 1;
+        }
+#endif
+        first += count;
+    }
+}
+
+#endif // CONFIG_STREAM_UDP_ENABLE
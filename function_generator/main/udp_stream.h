@@ -0,0 +1,70 @@
+/* UDP Stream
+
+   Sample blocks as UDP datagrams, beside the TCP stream, for clients that
+   would rather lose data than wait for it. A lost datagram costs its own
+   samples and nothing else, where a lost TCP segment holds up everything
+   behind it until it has been resent.
+
+   Each block is cut into datagrams of at most UDP_STREAM_DATAGRAM_SIZE
+   bytes, each one a binary frame of its own (see wire_format.h): the
+   32 byte header with WIRE_FLAG_DATAGRAM set, then up to
+   UDP_STREAM_DATAGRAM_SAMPLES raw samples. Summaries are never split. The
+   header's sequence number counts datagrams, across every channel, so a
+   client can count exactly what it lost; the timestamp is the block's, or
+   for edge-time data the anchor of the datagram's own records, so every
+   datagram decodes alone.
+
+   Datagrams go to every subscriber and, if CONFIG_STREAM_UDP_MULTICAST_GROUP
+   is set, to that group. A client subscribes by sending a datagram starting
+   with WIRE_HANDSHAKE_BINARY to the UDP port, and must send it again within
+   CONFIG_STREAM_UDP_SUBSCRIPTION_S to stay subscribed; "X" unsubscribes.
+   The datagrams are sent to the address the subscription came from.
+
+   A datagram's source address can be forged, so a subscription is only
+   taken from an address the stream server has a TCP client connected from
+   (stream_server_has_peer()), and lapses as soon as it has none. Otherwise
+   anyone could have the stream sent to a third party. A client that wants
+   only datagrams holds the session by connecting with WIRE_HANDSHAKE_UDP.
+   Refused subscriptions are counted (STATS_SUBSCRIPTIONS_REFUSED).
+
+   A datagram the stack has no buffer for is dropped and counted
+   (STATS_DATAGRAMS_DROPPED); the UDP stream never holds up the sample pool
+   or the TCP clients.
+
+   Driven by the stream server's task: stream_server_listen() opens it,
+   stream_server_poll() passes it subscriptions and blocks. Every function
+   must be called from that task.
+*/
+#ifndef UDP_STREAM_H
+#define UDP_STREAM_H
+
+#include <stdbool.h>
+
+#include "sample_pool.h"
+#include "wire_format.h"
+
+#define UDP_STREAM_DATAGRAM_SIZE CONFIG_STREAM_UDP_DATAGRAM_SIZE
+#define UDP_STREAM_DATAGRAM_SAMPLES ((UDP_STREAM_DATAGRAM_SIZE - sizeof(wire_header_t)) / sizeof(int32_t))
+#define UDP_STREAM_MAX_SUBSCRIBERS CONFIG_STREAM_UDP_MAX_SUBSCRIBERS
+
+// Opens the UDP socket on 'port'. Returns false if it could not be created.
+bool udp_stream_open(int port);
+
+// Forgets every subscriber and closes the socket.
+void udp_stream_close(void);
+
+// The socket to wait on for subscriptions, or -1 when closed.
+int udp_stream_socket(void);
+
+// Reads the subscription datagrams waiting on the socket.
+void udp_stream_receive(void);
+
+// Sends the block to every subscriber and the multicast group.
+void udp_stream_publish(const sample_block_t *block);
+
+int udp_stream_subscriber_count(void);
+
+// True if datagrams are being sent anywhere.
+bool udp_stream_active(void);
+
+#endif // UDP_STREAM_H
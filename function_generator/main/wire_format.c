@@ -0,0 +1,67 @@
+/* Wire Format
+
+   See wire_format.h.
+*/
+#include <string.h>
+
+#include "wire_format.h"
+
+#if defined(ESP_PLATFORM)
+#include "esp32/rom/crc.h"
+
+uint32_t wire_crc32(uint32_t crc, const void *data, size_t len)
+{
+    // The ROM implementation matches zlib's crc32().
+    return crc32_le(crc, (const uint8_t *) data, len);
+}
+#else
+uint32_t wire_crc32(uint32_t crc, const void *data, size_t len)
+{
+    static uint32_t table[256];
+    const uint8_t *bytes = (const uint8_t *) data;
+    
+    if (table[1] == 0)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+    }
+    
+    crc = ~crc;
+    while (len--)
+    {
+        crc = table[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+#endif
+
+void wire_header_init(wire_header_t *header, uint8_t encoding, uint8_t flags, uint8_t clock_mhz,
+                      uint32_t sequence, uint16_t count, uint16_t channel, uint64_t timestamp,
+                      const void *payload, uint32_t payload_size)
+{
+    memset(header, 0, sizeof(*header));
+    header->magic = WIRE_MAGIC;
+    header->version = WIRE_VERSION;
+    header->encoding = encoding;
+    header->flags = flags;
+    header->clock_mhz = clock_mhz;
+    header->sequence = sequence;
+    header->count = count;
+    header->channel = channel;
+    header->timestamp = timestamp;
+    header->payload_size = payload_size;
+    header->crc32 = wire_crc32(0, payload, payload_size);
+}
+
+int wire_header_valid(const wire_header_t *header)
+{
+    return header->magic == WIRE_MAGIC && header->version >= 1 &&
+           header->version <= WIRE_VERSION;
+}
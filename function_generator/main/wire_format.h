@@ -0,0 +1,90 @@
+/* Wire Format
+
+   Framed binary stream protocol. Each sample block is sent as a fixed
+   32 byte header followed by 'payload_size' bytes of payload. All fields
+   are little-endian.
+
+   A client selects the protocol for its connection by sending one byte
+   immediately after connecting: WIRE_HANDSHAKE_BINARY for framed binary or
+   WIRE_HANDSHAKE_ASCII85 for the original Ascii85 text stream. Clients
+   that send nothing, or start with any other byte, get the protocol
+   chosen in Kconfig; that byte is not consumed. WIRE_HANDSHAKE_UDP opens
+   a session that is sent nothing, held only so that its address may
+   subscribe to the UDP stream.
+
+   Count samples are the low 32 bits of their channel's edge count and wrap
+   every 2^32 edges; take the difference of two modulo 2^32.
+
+   The UDP stream (see udp_stream.h) sends the same frames, one per
+   datagram, with WIRE_FLAG_DATAGRAM set.
+
+   This header has no ESP-IDF dependencies so host-side tools can share it.
+*/
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define WIRE_MAGIC 0x4E454746u     // "FGEN"
+#define WIRE_VERSION 7             // 2 added WIRE_FLAG_EDGE_TIME and clock_mhz,
+                                   // 3 added 'channel' and dropped the pin from edge records,
+                                   // 4 added WIRE_FLAG_STATS, 5 WIRE_FLAG_TRACE,
+                                   // 6 WIRE_FLAG_DATAGRAM, 7 WIRE_FLAG_LZ4.
+
+#define WIRE_HANDSHAKE_BINARY 'B'
+#define WIRE_HANDSHAKE_ASCII85 'A'
+#define WIRE_HANDSHAKE_UDP 'U'
+
+// Payload encodings.
+#define WIRE_ENCODING_RAW 0            // int32 samples, 4 bytes each.
+#define WIRE_ENCODING_DELTA_VARINT 1   // Zigzag-delta varints, see delta_codec.h.
+
+// Header flags.
+#define WIRE_FLAG_EDGE_TIME 0x01    // Samples are edge records (see edge_record.h) and
+                                    // 'timestamp' is their anchor in CPU cycles.
+#define WIRE_FLAG_SUMMARY 0x02      // Samples are edge_summary_t records (see edge_stats.h);
+                                    // 'count' is in 32 bit words.
+#define WIRE_FLAG_STATS 0x04        // Not a block: the payload is a text stats report (see
+                                    // stats.h) and 'sequence' and 'count' are zero.
+#define WIRE_FLAG_TRACE 0x08        // Not a block: the payload is a trace dump (see
+                                    // trace_format.h) and 'sequence' and 'count' are zero.
+#define WIRE_FLAG_DATAGRAM 0x10     // Part of a block, sent as one UDP datagram: 'sequence'
+                                    // numbers datagrams, and 'timestamp' is that of the block
+                                    // (edge-time: the anchor of this datagram's records).
+#define WIRE_FLAG_LZ4 0x20          // The payload is LZ4 compressed (see lz4_block.h); it
+                                    // decompresses to the payload 'encoding' describes, and
+                                    // the CRC is of the compressed bytes.
+
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;             // WIRE_MAGIC
+    uint8_t version;            // WIRE_VERSION
+    uint8_t encoding;           // WIRE_ENCODING_*
+    uint8_t flags;              // WIRE_FLAG_*
+    uint8_t clock_mhz;          // With WIRE_FLAG_EDGE_TIME or _SUMMARY, CPU cycles per microsecond; else zero.
+    uint32_t sequence;          // Block number. Increments by one per block captured, including dropped blocks.
+    uint16_t count;             // Samples in this block.
+    uint16_t channel;           // Capture channel the samples came from. Zero before version 3.
+    uint64_t timestamp;         // Microseconds since boot when the first sample was captured,
+                                // or the edge record anchor in cycles (WIRE_FLAG_EDGE_TIME).
+    uint32_t payload_size;      // Bytes following this header.
+    uint32_t crc32;             // CRC-32 (as zlib) of the payload.
+} wire_header_t;
+
+_Static_assert(sizeof(wire_header_t) == 32, "wire_header_t must be 32 bytes");
+
+// Standard CRC-32, chainable: pass 0 to start, or the previous result to continue.
+uint32_t wire_crc32(uint32_t crc, const void *data, size_t len);
+
+// Fills in a header, including the payload CRC.
+void wire_header_init(wire_header_t *header, uint8_t encoding, uint8_t flags, uint8_t clock_mhz,
+                      uint32_t sequence, uint16_t count, uint16_t channel, uint64_t timestamp,
+                      const void *payload, uint32_t payload_size);
+
+// Returns non-zero if the header's magic and version are recognised.
+// Version 1 headers are accepted; they always have zero flags. Earlier
+// versions had a 32 bit 'count', whose top half was always zero.
+int wire_header_valid(const wire_header_t *header);
+
+#endif // WIRE_FORMAT_H
@@ -0,0 +1,69 @@
+/* Zlib Arena
+
+   See zlib_arena.h.
+*/
+#include "sdkconfig.h"
+
+#if CONFIG_STREAM_TELNET_MCCP2
+
+#include <string.h>
+
+#include "zlib_arena.h"
+
+#define ALIGNMENT 8
+
+static zlib_arena_t arenas[CONFIG_STREAM_MCCP2_CLIENTS];
+
+zlib_arena_t *zlib_arena_take(void)
+{
+    for (int i = 0; i < CONFIG_STREAM_MCCP2_CLIENTS; i++)
+    {
+        if (!arenas[i].taken)
+        {
+            arenas[i].taken = true;
+            arenas[i].used = 0;
+            return &arenas[i];
+        }
+    }
+    return NULL;
+}
+
+void zlib_arena_give(zlib_arena_t *arena)
+{
+    arena->taken = false;
+}
+
+bool zlib_arena_available(void)
+{
+    for (int i = 0; i < CONFIG_STREAM_MCCP2_CLIENTS; i++)
+    {
+        if (!arenas[i].taken)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void *zlib_arena_alloc(void *opaque, unsigned int items, unsigned int size)
+{
+    zlib_arena_t *arena = opaque;
+    size_t bytes = ((size_t) items * size + ALIGNMENT - 1) & ~(size_t) (ALIGNMENT - 1);
+    
+    if (bytes > sizeof(arena->memory) - arena->used)
+    {
+        return NULL;
+    }
+    void *memory = &arena->memory[arena->used];
+    arena->used += bytes;
+    return memory;
+}
+
+void zlib_arena_free(void *opaque, void *address)
+{
+    // Reclaimed all at once by zlib_arena_give().
+    (void) opaque;
+    (void) address;
+}
+
+#endif // CONFIG_STREAM_TELNET_MCCP2
@@ -0,0 +1,54 @@
+/* Zlib Arena
+
+   Fixed memory for the zlib deflate streams of telnet COMPRESS2 clients
+   (see stream_server.h), allocated once at boot so that compression never
+   touches the heap: a client either gets a whole arena or is sent the
+   stream uncompressed.
+
+   There are CONFIG_STREAM_MCCP2_CLIENTS arenas of ZLIB_ARENA_SIZE bytes. A
+   client takes one when it agrees to COMPRESS2 and gives it back when it
+   goes. zlib allocates everything it needs up front, in deflateInit2(), so
+   an arena is a bump allocator: zlib_arena_alloc() carves off the next
+   piece, zlib_arena_free() does nothing, and the whole arena is reclaimed
+   when it is given back.
+
+   ZLIB_ARENA_SIZE is zlib's own figure for the configured window and
+   memory level, (1 << (windowBits + 2)) + (1 << (memLevel + 9)), plus
+   room for its state and the z_stream.
+
+   Every function must be called from one task.
+*/
+#ifndef ZLIB_ARENA_H
+#define ZLIB_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+
+#define ZLIB_ARENA_STATE 8192   // deflate_state and z_stream, with room to spare.
+#define ZLIB_ARENA_SIZE ((1 << (CONFIG_STREAM_MCCP2_WINDOW_BITS + 2)) + \
+                         (1 << (CONFIG_STREAM_MCCP2_MEM_LEVEL + 9)) + ZLIB_ARENA_STATE)
+
+typedef struct
+{
+    bool taken;
+    size_t used;                // Bytes handed to zlib since the arena was taken.
+    uint8_t memory[ZLIB_ARENA_SIZE] __attribute__((aligned(8)));
+} zlib_arena_t;
+
+// A free arena, or NULL if every one is taken.
+zlib_arena_t *zlib_arena_take(void);
+
+// Returns an arena once zlib has finished with it.
+void zlib_arena_give(zlib_arena_t *arena);
+
+// True if zlib_arena_take() would succeed.
+bool zlib_arena_available(void);
+
+// zlib's alloc_func and free_func, with the arena as 'opaque'. The
+// allocator returns NULL once the arena is used up.
+void *zlib_arena_alloc(void *opaque, unsigned int items, unsigned int size);
+void zlib_arena_free(void *opaque, void *address);
+
+#endif // ZLIB_ARENA_H
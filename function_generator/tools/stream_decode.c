@@ -0,0 +1,932 @@
+/* Stream Decoder
+
+   Reference client for the function generator's sample stream. Connects to
+   the board, selects a protocol with the one byte handshake and prints the
+   decoded samples to stdout, one per line with its capture channel first.
+   Edge-time blocks are printed as one edge per line: absolute time in
+   nanoseconds since boot, channel and level. Summary blocks are printed as
+   one window per line: start (ns since boot), channel, periods, missing
+   edges, frequency (Hz), then min, max, mean and standard deviation of the
+   period (ns). The Ascii85 stream carries channel 0 only. Edge counts are
+   printed as the board sends them, the low 32 bits of the count as a
+   signed number, so they wrap to negative after 2^31 edges and to zero
+   after 2^32.
+   Block sequence gaps and CRC failures are reported on stderr, as are the
+   board's stats records.
+
+   With -u the samples come from the UDP stream instead (see udp_stream.h):
+   the decoder subscribes to the board at host:port, renewing the
+   subscription every second and holding the TCP session on the same port
+   the board requires of subscribers, or if host is a multicast group
+   joins it on that port. Datagrams are numbered, so their gaps are counted as lost
+   datagrams, late ones (overtaken by a later datagram) are counted apart,
+   and the benchmark summary adds the distribution of gap lengths.
+
+   With -z the Ascii85 stream is read through telnet, as a MUD client would
+   read it: the decoder asks for COMPRESS2 (MCCP2) and inflates everything
+   after the board's start marker (see CONFIG_STREAM_TELNET_MCCP2). The
+   benchmark summary adds how far it was compressed.
+
+   Blocks the board LZ4 compressed (WIRE_FLAG_LZ4) are decompressed before
+   decoding, and the benchmark summary adds how far they were compressed.
+
+   With -d the decoder is a throughput benchmark: it runs for the given
+   time, prints nothing per sample, and then reports MB/s received,
+   samples/s, blocks lost and the spread of block delays. A block's delay
+   is its arrival time less the board time in its header, less the same
+   for the soonest arriving block of its channel. With a steady input that
+   measures queueing on the way (in the board's pool, stream server, lwIP,
+   WiFi and the host) rather than the time taken to fill the block, and
+   needs no synchronised clocks.
+   See sdkconfig.throughput in the project for the settings it was used to
+   compare.
+
+   Build on Linux/macOS from this directory:
+
+     cc -O2 -I../main -o stream_decode stream_decode.c ../main/wire_format.c \
+        ../main/delta_codec.c ../main/edge_record.c ../main/lz4_block.c -lz -lm
+
+   Usage:
+
+     stream_decode [-a | -b | -u | -z] [-q] [-s] [-d seconds] [-t file] [-r sequence] [-R] host [port]
+
+     -a   Ascii85 text stream
+     -b   framed binary stream (default)
+     -u   UDP stream of binary datagrams
+     -z   Ascii85 through telnet with COMPRESS2
+     -q   quiet: print a once-a-second summary instead of every sample
+     -s   ask for a stats record straight away (binary only)
+     -d   benchmark for this many seconds and print a summary (delays
+          binary only)
+     -t   ask for a trace dump, write it to 'file' for trace2json and exit
+          (binary only; needs CONFIG_TRACE_ENABLE)
+     -r   resume from this block sequence number (binary only)
+     -R   reconnect when the connection drops and resume from the next
+          block expected (binary only)
+*/
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <zlib.h>
+
+#include "wire_format.h"
+#include "libtelnet.h"
+#include "delta_codec.h"
+#include "lz4_block.h"
+#include "edge_record.h"
+#include "edge_stats.h"
+
+static int quiet = 0;
+static uint64_t totalSamples = 0;
+static uint64_t totalBlocks = 0;
+static uint64_t lostBlocks = 0;
+static uint64_t crcErrors = 0;
+static uint64_t duplicateBlocks = 0;
+static uint64_t compressedBytes = 0;    // LZ4 payloads as received,
+static uint64_t decompressedBytes = 0;  // and as decompressed.
+static const char *units = "blocks";   // What the stream numbers.
+
+#define UDP_RENEW_US 1000000
+#define GAP_BUCKETS 8                   // Gap lengths 1, 2-3, 4-7, ... 128+.
+
+static uint64_t lateDatagrams = 0;
+static uint64_t gapCounts[GAP_BUCKETS];
+
+static const char *traceFile = NULL;
+
+static int benchSeconds = 0;
+static int benchDone = 0;
+static double benchStart = 0;
+static uint64_t totalBytes = 0;
+static double *delays = NULL;      // Arrival less board time, us, per block;
+static uint16_t *delayChannels = NULL; // and the block's channel.
+static size_t delayCount = 0;
+static size_t delayCapacity = 0;
+
+// The telnet stream as received, and as inflated once COMPRESS2 starts.
+static unsigned char wire[4096];
+static size_t wireLength = 0;
+static size_t wirePos = 0;
+static unsigned char text[16384];
+static size_t textLength = 0;
+static size_t textPos = 0;
+static z_stream inflater;
+static int inflating = 0;
+static uint64_t deflatedBytes = 0;      // COMPRESS2 bytes received,
+static uint64_t inflatedBytes = 0;      // and as inflated.
+
+static int haveSequence = 0;
+static uint32_t nextSequence = 0;
+
+static double now_us(void)
+{
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int connect_to(const char *host, const char *port)
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    int sock = -1;
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0)
+    {
+        fprintf(stderr, "Unable to resolve %s\n", host);
+        return -1;
+    }
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next)
+    {
+        sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (sock >= 0 && connect(sock, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            break;
+        }
+        if (sock >= 0)
+        {
+            close(sock);
+            sock = -1;
+        }
+    }
+    freeaddrinfo(res);
+    return sock;
+}
+
+// Reads exactly 'len' bytes. Returns 0 at end of stream.
+static int read_full(int sock, void *buf, size_t len)
+{
+    size_t got = 0;
+    
+    while (got < len)
+    {
+        ssize_t n = recv(sock, (char *) buf + got, len - got, 0);
+        if (n <= 0)
+        {
+            return 0;
+        }
+        got += n;
+        totalBytes += n;
+    }
+    return 1;
+}
+
+static void emit_sample(unsigned channel, int32_t sample)
+{
+    totalSamples++;
+    if (!quiet)
+    {
+        printf("%u %d\n", channel, sample);
+    }
+}
+
+static void report(void)
+{
+    static time_t last = 0;
+    static uint64_t lastSamples = 0;
+    time_t now = time(NULL);
+    
+    if (benchSeconds > 0)
+    {
+        benchDone = now_us() - benchStart >= benchSeconds * 1e6;
+        return;
+    }
+    if (!quiet || now == last)
+    {
+        return;
+    }
+    if (last != 0)
+    {
+        fprintf(stderr, "%llu samples/s, %llu %s, %llu lost, %llu CRC errors\n",
+                (unsigned long long) (totalSamples - lastSamples),
+                (unsigned long long) totalBlocks, units,
+                (unsigned long long) lostBlocks,
+                (unsigned long long) crcErrors);
+    }
+    last = now;
+    lastSamples = totalSamples;
+}
+
+static void record_delay(const wire_header_t *header)
+{
+    double boardTime = header->timestamp;
+    
+    if ((header->flags & WIRE_FLAG_EDGE_TIME) && header->clock_mhz > 0)
+    {
+        boardTime /= header->clock_mhz;
+    }
+    if (delayCount == delayCapacity)
+    {
+        delayCapacity = delayCapacity ? delayCapacity * 2 : 1024;
+        delays = realloc(delays, delayCapacity * sizeof(delays[0]));
+        delayChannels = realloc(delayChannels, delayCapacity * sizeof(delayChannels[0]));
+    }
+    delayChannels[delayCount] = header->channel;
+    delays[delayCount++] = now_us() - boardTime;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    
+    return (x > y) - (x < y);
+}
+
+static void bench_report(void)
+{
+    double seconds = (now_us() - benchStart) / 1e6;
+    
+    fprintf(stderr, "%.1f s: %.3f MB/s, %.0f samples/s, %llu %s, %llu lost, %llu CRC errors\n",
+            seconds, totalBytes / seconds / 1e6, totalSamples / seconds,
+            (unsigned long long) totalBlocks, units, (unsigned long long) lostBlocks,
+            (unsigned long long) crcErrors);
+    if (lostBlocks + lateDatagrams > 0 && strcmp(units, "datagrams") == 0)
+    {
+        fprintf(stderr, "Lost %.2f%% of datagrams, %llu late; gap lengths:",
+                100.0 * lostBlocks / (totalBlocks + lostBlocks), (unsigned long long) lateDatagrams);
+        for (int i = 0; i < GAP_BUCKETS; i++)
+        {
+            if (i == 0)
+            {
+                fprintf(stderr, " 1: %llu", (unsigned long long) gapCounts[i]);
+            }
+            else if (i == GAP_BUCKETS - 1)
+            {
+                fprintf(stderr, " %u+: %llu", 1u << i, (unsigned long long) gapCounts[i]);
+            }
+            else
+            {
+                fprintf(stderr, " %u-%u: %llu", 1u << i, (2u << i) - 1, (unsigned long long) gapCounts[i]);
+            }
+        }
+        fprintf(stderr, "\n");
+    }
+    if (compressedBytes > 0)
+    {
+        fprintf(stderr, "LZ4: %llu payload bytes received for %llu (%.1f%%)\n",
+                (unsigned long long) compressedBytes, (unsigned long long) decompressedBytes,
+                100.0 * compressedBytes / decompressedBytes);
+    }
+    if (deflatedBytes > 0)
+    {
+        fprintf(stderr, "COMPRESS2: %llu bytes received for %llu of text (%.1f%%)\n",
+                (unsigned long long) deflatedBytes, (unsigned long long) inflatedBytes,
+                100.0 * deflatedBytes / inflatedBytes);
+    }
+    if (delayCount == 0)
+    {
+        return;
+    }
+    // Relative to the fastest block of the same channel, as channels fill
+    // their blocks at different rates.
+    static double fastest[65536];
+    for (size_t i = 0; i < delayCount; i++)
+    {
+        fastest[delayChannels[i]] = INFINITY;
+    }
+    for (size_t i = 0; i < delayCount; i++)
+    {
+        fastest[delayChannels[i]] = fmin(fastest[delayChannels[i]], delays[i]);
+    }
+    for (size_t i = 0; i < delayCount; i++)
+    {
+        delays[i] -= fastest[delayChannels[i]];
+    }
+    qsort(delays, delayCount, sizeof(delays[0]), compare_double);
+    fprintf(stderr, "Block delay above the fastest, ms: p50 %.2f, p90 %.2f, p99 %.2f, max %.2f\n",
+            delays[delayCount / 2] / 1e3, delays[delayCount * 9 / 10] / 1e3,
+            delays[delayCount * 99 / 100] / 1e3, delays[delayCount - 1] / 1e3);
+}
+
+static int32_t ascii85_sample(const unsigned char *digits)
+{
+    // Least significant digit first.
+    uint32_t val = 0;
+    for (int j = 4; j >= 0; j--)
+    {
+        val = val * 85 + (uint32_t) (digits[j] - 33);
+    }
+    return (int32_t) val;
+}
+
+static int decode_ascii85(int sock)
+{
+    unsigned char digits[5];
+    
+    while (!benchDone && read_full(sock, digits, sizeof(digits)))
+    {
+        emit_sample(0, ascii85_sample(digits));
+        report();
+    }
+    return 0;
+}
+
+// The next byte of the telnet stream, inflated if COMPRESS2 has started.
+// Returns -1 at the end of the stream.
+static int telnet_byte(int sock)
+{
+    for (;;)
+    {
+        if (textPos < textLength)
+        {
+            return text[textPos++];
+        }
+        if (wirePos == wireLength)
+        {
+            ssize_t n = recv(sock, wire, sizeof(wire), 0);
+            if (n <= 0)
+            {
+                return -1;
+            }
+            totalBytes += n;
+            wireLength = n;
+            wirePos = 0;
+        }
+        if (!inflating)
+        {
+            return wire[wirePos++];
+        }
+    
+        inflater.next_in = wire + wirePos;
+        inflater.avail_in = wireLength - wirePos;
+        inflater.next_out = text;
+        inflater.avail_out = sizeof(text);
+        int result = inflate(&inflater, Z_SYNC_FLUSH);
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+        {
+            fprintf(stderr, "COMPRESS2 stream corrupt: %s\n", inflater.msg ? inflater.msg : "?");
+            return -1;
+        }
+        deflatedBytes += (wireLength - wirePos) - inflater.avail_in;
+        wirePos = wireLength - inflater.avail_in;
+        textPos = 0;
+        textLength = sizeof(text) - inflater.avail_out;
+        inflatedBytes += textLength;
+        if (result == Z_STREAM_END)
+        {
+            // The board stopped compressing; the rest is plain.
+            inflateEnd(&inflater);
+            inflating = 0;
+        }
+    }
+}
+
+/*
+  Ascii85 with telnet commands among it. Negotiation is ignored (the request
+  for COMPRESS2 went with the handshake); the COMPRESS2 start marker,
+  IAC SB COMPRESS2 IAC SE, switches to inflating.
+ */
+static int decode_telnet(int sock)
+{
+    unsigned char digits[5];
+    int have = 0;
+    int c;
+    
+    while (!benchDone && (c = telnet_byte(sock)) >= 0)
+    {
+        if (c == TELNET_IAC)
+        {
+            int command = telnet_byte(sock);
+            if (command == TELNET_WILL || command == TELNET_WONT ||
+                command == TELNET_DO || command == TELNET_DONT)
+            {
+                telnet_byte(sock);
+                continue;
+            }
+            if (command == TELNET_SB)
+            {
+                int option = telnet_byte(sock);
+                int previous = 0;
+                while ((c = telnet_byte(sock)) >= 0 && !(previous == TELNET_IAC && c == TELNET_SE))
+                {
+                    previous = c;
+                }
+                if (option == TELNET_TELOPT_COMPRESS2 && !inflating)
+                {
+                    memset(&inflater, 0, sizeof(inflater));
+                    inflateInit(&inflater);
+                    inflating = 1;
+                }
+                continue;
+            }
+            if (command != TELNET_IAC)
+            {
+                continue;
+            }
+        }
+        digits[have++] = (unsigned char) c;
+        if (have == sizeof(digits))
+        {
+            emit_sample(0, ascii85_sample(digits));
+            report();
+            have = 0;
+        }
+    }
+    return 0;
+}
+
+static void emit_edge(unsigned channel, const edge_time_t *edge, unsigned clockMhz)
+{
+    totalSamples++;
+    if (!quiet)
+    {
+        // Nanoseconds since boot.
+        printf("%llu %u %u\n", (unsigned long long) (edge->cycles * 1000 / clockMhz),
+               channel, edge->level);
+    }
+}
+
+static void emit_summary(const edge_summary_t *summary, unsigned clockMhz)
+{
+    double nsPerCycle = 1000.0 / clockMhz;
+    
+    totalSamples++;
+    if (!quiet)
+    {
+        printf("%llu %u %u %u %.3f %.1f %.1f %.1f %.1f\n",
+               (unsigned long long) (summary->start * 1000 / clockMhz),
+               summary->channel, summary->periods, summary->missing,
+               summary->mean > 0 ? 1e9 / (summary->mean * nsPerCycle) : 0.0,
+               summary->min * nsPerCycle, summary->max * nsPerCycle,
+               summary->mean * nsPerCycle, sqrt(summary->variance) * nsPerCycle);
+    }
+}
+
+static int decode_payload(const wire_header_t *header, const uint8_t *payload)
+{
+    static int32_t *samples = NULL;
+    static edge_time_t *edges = NULL;
+    static uint8_t *decompressed = NULL;
+    static size_t capacity = 0;
+    size_t payloadSize = header->payload_size;
+    
+    if (header->count > capacity)
+    {
+        capacity = header->count;
+        samples = realloc(samples, capacity * sizeof(int32_t));
+        edges = realloc(edges, capacity * sizeof(edge_time_t));
+        decompressed = realloc(decompressed, DELTA_VARINT_MAX_SIZE(capacity));
+    }
+    if (header->flags & WIRE_FLAG_LZ4)
+    {
+        payloadSize = lz4_block_decompress(payload, header->payload_size, decompressed,
+                                           DELTA_VARINT_MAX_SIZE(header->count));
+        if (payloadSize == 0)
+        {
+            return -1;
+        }
+        payload = decompressed;
+        compressedBytes += header->payload_size;
+        decompressedBytes += payloadSize;
+    }
+    switch (header->encoding)
+    {
+        case WIRE_ENCODING_RAW:
+            if (payloadSize != header->count * 4)
+            {
+                return -1;
+            }
+            memcpy(samples, payload, payloadSize);
+            break;
+        case WIRE_ENCODING_DELTA_VARINT:
+            if (delta_varint_decode(payload, payloadSize, samples, header->count) != payloadSize)
+            {
+                return -1;
+            }
+            break;
+        default:
+            return -1;
+    }
+    
+    if (header->flags & WIRE_FLAG_SUMMARY)
+    {
+        if (header->clock_mhz == 0 || header->count % EDGE_SUMMARY_WORDS != 0)
+        {
+            return -1;
+        }
+        for (uint32_t i = 0; i < header->count; i += EDGE_SUMMARY_WORDS)
+        {
+            edge_summary_t summary;
+            memcpy(&summary, &samples[i], sizeof(summary));
+            emit_summary(&summary, header->clock_mhz);
+        }
+    }
+    else if (header->flags & WIRE_FLAG_EDGE_TIME)
+    {
+        // Version 2 edge records had a pin bit and a 30 bit delta.
+        if (header->clock_mhz == 0 || header->version < 3)
+        {
+            return -1;
+        }
+        size_t edgeCount = edge_record_decode(samples, header->count, header->timestamp, edges);
+        for (size_t i = 0; i < edgeCount; i++)
+        {
+            emit_edge(header->channel, &edges[i], header->clock_mhz);
+        }
+    }
+    else
+    {
+        for (uint32_t i = 0; i < header->count; i++)
+        {
+            emit_sample(header->channel, samples[i]);
+        }
+    }
+    return 0;
+}
+
+/*
+  Opens the UDP stream: joins 'host' on 'port' if it is a multicast group,
+  otherwise connects to the board there so that its datagrams, and only
+  its, are received. Sets 'subscribe' if subscriptions must be sent.
+ */
+static int open_udp(const char *host, const char *port, int *subscribe)
+{
+    struct in_addr group;
+    
+    if (inet_aton(host, &group) && IN_MULTICAST(ntohl(group.s_addr)))
+    {
+        struct sockaddr_in addr;
+        struct ip_mreq membership;
+        int reuse = 1;
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t) atoi(port));
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        membership.imr_multiaddr = group;
+        membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (sock < 0 || bind(sock, (struct sockaddr *) &addr, sizeof(addr)) != 0 ||
+            setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) != 0)
+        {
+            perror("Unable to join multicast group");
+            return -1;
+        }
+        *subscribe = 0;
+        return sock;
+    }
+    
+    struct addrinfo hints;
+    struct addrinfo *res;
+    int sock = -1;
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0)
+    {
+        fprintf(stderr, "Unable to resolve %s\n", host);
+        return -1;
+    }
+    sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0)
+    {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    *subscribe = 1;
+    return sock;
+}
+
+// Counts a datagram's sequence number into the loss and gap figures.
+static void count_datagram(uint32_t sequence)
+{
+    int32_t ahead = (int32_t) (sequence - nextSequence);
+    
+    totalBlocks++;
+    if (haveSequence && ahead < 0)
+    {
+        // Overtaken by a later datagram, so already counted as lost.
+        lateDatagrams++;
+        lostBlocks--;
+        return;
+    }
+    if (haveSequence && ahead > 0)
+    {
+        int bucket = 0;
+        while (bucket < GAP_BUCKETS - 1 && (2u << bucket) <= (uint32_t) ahead)
+        {
+            bucket++;
+        }
+        gapCounts[bucket]++;
+        lostBlocks += ahead;
+        if (!quiet)
+        {
+            fprintf(stderr, "Datagram gap: expected %u, got %u\n", nextSequence, sequence);
+        }
+    }
+    haveSequence = 1;
+    nextSequence = sequence + 1;
+}
+
+static int decode_udp(int sock, int subscribe)
+{
+    static uint8_t datagram[65536];
+    struct timeval timeout = { .tv_sec = 0, .tv_usec = 200000 };
+    double renewed = 0;
+    
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    while (!benchDone)
+    {
+        if (subscribe && now_us() - renewed >= UDP_RENEW_US)
+        {
+            send(sock, &(char) { WIRE_HANDSHAKE_BINARY }, 1, 0);
+            renewed = now_us();
+        }
+        ssize_t received = recv(sock, datagram, sizeof(datagram), 0);
+        if (received < 0)
+        {
+            // Timeouts, and refusals while the board is not listening yet.
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ECONNREFUSED)
+            {
+                perror("recv");
+                return 1;
+            }
+            report();
+            continue;
+        }
+        totalBytes += received;
+    
+        wire_header_t header;
+        if ((size_t) received < sizeof(header))
+        {
+            continue;
+        }
+        memcpy(&header, datagram, sizeof(header));
+        if (!wire_header_valid(&header) || !(header.flags & WIRE_FLAG_DATAGRAM) ||
+            sizeof(header) + header.payload_size != (size_t) received)
+        {
+            fprintf(stderr, "Bad datagram of %zd bytes\n", received);
+            continue;
+        }
+        count_datagram(header.sequence);
+        if (wire_crc32(0, datagram + sizeof(header), header.payload_size) != header.crc32)
+        {
+            fprintf(stderr, "CRC error in datagram %u\n", header.sequence);
+            crcErrors++;
+        }
+        else if (decode_payload(&header, datagram + sizeof(header)) != 0)
+        {
+            fprintf(stderr, "Undecodable datagram %u (encoding %u)\n", header.sequence, header.encoding);
+        }
+        if (benchSeconds > 0)
+        {
+            record_delay(&header);
+        }
+        report();
+    }
+    if (subscribe)
+    {
+        send(sock, "X", 1, 0);
+    }
+    return 0;
+}
+
+static int decode_binary(int sock)
+{
+    wire_header_t header;
+    uint8_t *payload = NULL;
+    size_t capacity = 0;
+    
+    while (!benchDone && read_full(sock, &header, sizeof(header)))
+    {
+        if (!wire_header_valid(&header))
+        {
+            fprintf(stderr, "Bad block header - stream out of sync\n");
+            return 1;
+        }
+        if (header.payload_size > capacity)
+        {
+            capacity = header.payload_size;
+            payload = realloc(payload, capacity);
+        }
+        if (!read_full(sock, payload, header.payload_size))
+        {
+            break;
+        }
+    
+        if (header.flags & WIRE_FLAG_STATS)
+        {
+            // Not part of the block sequence.
+            if (wire_crc32(0, payload, header.payload_size) == header.crc32)
+            {
+                fwrite(payload, 1, header.payload_size, stderr);
+            }
+            continue;
+        }
+        if (header.flags & WIRE_FLAG_TRACE)
+        {
+            // Only sent when asked for, and the last thing wanted.
+            FILE *out;
+            if (wire_crc32(0, payload, header.payload_size) != header.crc32)
+            {
+                fprintf(stderr, "CRC error in trace dump\n");
+                return 1;
+            }
+            if (traceFile == NULL || (out = fopen(traceFile, "wb")) == NULL ||
+                fwrite(payload, 1, header.payload_size, out) != header.payload_size)
+            {
+                perror("trace dump");
+                return 1;
+            }
+            fclose(out);
+            fprintf(stderr, "Trace dump of %u bytes written to %s\n", header.payload_size, traceFile);
+            break;
+        }
+    
+        if (haveSequence && (int32_t) (header.sequence - nextSequence) < 0)
+        {
+            // Resent after a resume.
+            duplicateBlocks++;
+            continue;
+        }
+        totalBlocks++;
+        if (haveSequence && header.sequence != nextSequence)
+        {
+            fprintf(stderr, "Sequence gap: expected %u, got %u\n", nextSequence, header.sequence);
+            lostBlocks += (uint32_t) (header.sequence - nextSequence);
+        }
+        haveSequence = 1;
+        nextSequence = header.sequence + 1;
+        if (benchSeconds > 0)
+        {
+            record_delay(&header);
+        }
+    
+        if (wire_crc32(0, payload, header.payload_size) != header.crc32)
+        {
+            fprintf(stderr, "CRC error in block %u\n", header.sequence);
+            crcErrors++;
+        }
+        else if (decode_payload(&header, payload) != 0)
+        {
+            fprintf(stderr, "Undecodable block %u (encoding %u)\n", header.sequence, header.encoding);
+        }
+        report();
+    }
+    free(payload);
+    return 0;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-a | -b | -u | -z] [-q] [-s] [-d seconds] [-t file] [-r sequence] [-R] host [port]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+    char protocol = WIRE_HANDSHAKE_BINARY;
+    int udp = 0;
+    int telnet = 0;
+    int reconnect = 0;
+    int requestStats = 0;
+    int opt;
+    
+    while ((opt = getopt(argc, argv, "abuzqsd:t:r:R")) != -1)
+    {
+        switch (opt)
+        {
+            case 'a': protocol = WIRE_HANDSHAKE_ASCII85; break;
+            case 'b': protocol = WIRE_HANDSHAKE_BINARY; break;
+            case 'u': udp = 1; break;
+            case 'z': protocol = WIRE_HANDSHAKE_ASCII85; telnet = 1; break;
+            case 'q': quiet = 1; break;
+            case 's': requestStats = 1; break;
+            case 'd': benchSeconds = atoi(optarg); quiet = 1; break;
+            case 't': traceFile = optarg; break;
+            case 'r':
+                nextSequence = (uint32_t) strtoul(optarg, NULL, 10);
+                haveSequence = 1;
+                break;
+            case 'R': reconnect = 1; break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+    if (optind >= argc || ((protocol != WIRE_HANDSHAKE_BINARY || udp) && (haveSequence || reconnect || requestStats || traceFile != NULL)))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    
+    int result = 0;
+    benchStart = now_us();
+    if (udp)
+    {
+        const char *port = optind + 1 < argc ? argv[optind + 1] : "23";
+        int subscribe;
+        int session = -1;
+        int sock = open_udp(argv[optind], port, &subscribe);
+        if (sock < 0)
+        {
+            fprintf(stderr, "Unable to open the UDP stream from %s\n", argv[optind]);
+            return 1;
+        }
+        // The board only takes subscriptions from an address with a TCP
+        // connection to it; this one is sent nothing.
+        if (subscribe && ((session = connect_to(argv[optind], port)) < 0 ||
+                          send(session, &(char) { WIRE_HANDSHAKE_UDP }, 1, 0) != 1))
+        {
+            fprintf(stderr, "Unable to open a UDP session with %s\n", argv[optind]);
+            return 1;
+        }
+        units = "datagrams";
+        result = decode_udp(sock, subscribe);
+        close(sock);
+        if (session >= 0)
+        {
+            close(session);
+        }
+        if (benchSeconds > 0)
+        {
+            bench_report();
+        }
+        return result;
+    }
+    do
+    {
+        int sock = connect_to(argv[optind], optind + 1 < argc ? argv[optind + 1] : "23");
+        if (sock < 0)
+        {
+            fprintf(stderr, "Unable to connect to %s\n", argv[optind]);
+            if (reconnect)
+            {
+                sleep(1);
+                continue;
+            }
+            return 1;
+        }
+    
+        // Handshake byte, or for telnet the COMPRESS2 request, then optionally
+        // where to resume from, a stats request and a trace request.
+        char request[32];
+        int length = 0;
+        if (telnet)
+        {
+            request[length++] = (char) TELNET_IAC;
+            request[length++] = (char) TELNET_DO;
+            request[length++] = (char) TELNET_TELOPT_COMPRESS2;
+        }
+        else
+        {
+            request[length++] = protocol;
+        }
+        if (haveSequence)
+        {
+            length += snprintf(request + length, sizeof(request) - length, "R%u\n", nextSequence);
+            fprintf(stderr, "Resuming from block %u\n", nextSequence);
+        }
+        if (requestStats)
+        {
+            length += snprintf(request + length, sizeof(request) - length, "stats\n");
+        }
+        if (traceFile != NULL)
+        {
+            length += snprintf(request + length, sizeof(request) - length, "trace\n");
+        }
+        if (send(sock, request, length, 0) != length)
+        {
+            perror("send");
+            close(sock);
+            return 1;
+        }
+    
+        if (protocol == WIRE_HANDSHAKE_BINARY)
+        {
+            result = decode_binary(sock);
+        }
+        else
+        {
+            result = telnet ? decode_telnet(sock) : decode_ascii85(sock);
+        }
+        close(sock);
+        if (reconnect)
+        {
+            fprintf(stderr, "Connection lost after %llu blocks (%llu lost, %llu repeated)\n",
+                    (unsigned long long) totalBlocks, (unsigned long long) lostBlocks,
+                    (unsigned long long) duplicateBlocks);
+        }
+    } while (reconnect && result == 0 && traceFile == NULL && !benchDone);
+    if (benchSeconds > 0)
+    {
+        bench_report();
+    }
+    return result;
+}
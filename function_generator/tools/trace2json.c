@@ -0,0 +1,202 @@
+/* Trace to JSON
+
+   Converts a trace dump from the function generator (see
+   ../main/trace_format.h) to Chrome trace event JSON, which loads in
+   chrome://tracing and ui.perfetto.dev. Each core is a thread; ISRs,
+   receiver waits and socket sends are spans, everything else instants
+   with the event's argument attached. Times are microseconds since boot.
+
+   Get a dump with stream_decode -t, then:
+
+     cc -O2 -I../main -o trace2json trace2json.c
+     trace2json trace.bin > trace.json
+
+   Usage:
+
+     trace2json [dump]      (reads stdin without a file)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "trace_format.h"
+
+#define MAX_CORES 8
+
+typedef struct
+{
+    double time;            // Microseconds since boot.
+    unsigned core;
+    trace_event_t event;
+    uint32_t arg;
+} event_t;
+
+#define TRACE_EVENT_NAME(id, name, phase) [id] = name,
+static const char *names[TRACE_EVENT_COUNT] = { TRACE_EVENTS(TRACE_EVENT_NAME) };
+#undef TRACE_EVENT_NAME
+
+#define TRACE_EVENT_PHASE(id, name, phase) [id] = phase,
+static const char phases[TRACE_EVENT_COUNT] = { TRACE_EVENTS(TRACE_EVENT_PHASE) };
+#undef TRACE_EVENT_PHASE
+
+static int compare_events(const void *a, const void *b)
+{
+    const event_t *x = a;
+    const event_t *y = b;
+    
+    return (x->time > y->time) - (x->time < y->time);
+}
+
+static uint8_t *read_all(FILE *in, size_t *size)
+{
+    size_t capacity = 1 << 16;
+    uint8_t *data = malloc(capacity);
+    size_t n;
+    
+    *size = 0;
+    while ((n = fread(data + *size, 1, capacity - *size, in)) > 0)
+    {
+        *size += n;
+        if (*size == capacity)
+        {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    return data;
+}
+
+/*
+  Appends the core's records to 'events', oldest first. Cycle times are
+  rebuilt backwards from the newest record, one neighbour difference at a
+  time, then placed against the core's sync point.
+ */
+static size_t read_core(const trace_dump_header_t *header, unsigned core,
+                        const trace_core_header_t *ring, const trace_record_t *records,
+                        event_t *events)
+{
+    uint32_t count = ring->head < header->events ? ring->head : header->events;
+    uint32_t mask = header->events - 1;
+    int64_t cycles = 0;     // Relative to the newest record.
+    
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (ring->syncTime == 0)
+    {
+        fprintf(stderr, "Core %u never synced; its times start from 0\n", core);
+    }
+    
+    uint32_t newest = (ring->head - 1) & mask;
+    int64_t syncCycles = (int32_t) (ring->syncCcount - records[newest].ccount);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t slot = (ring->head - 1 - i) & mask;
+        const trace_record_t *record = &records[slot];
+        event_t *event = &events[count - 1 - i];
+    
+        if (i > 0)
+        {
+            cycles -= (int32_t) (records[(slot + 1) & mask].ccount - record->ccount);
+        }
+        event->time = ring->syncTime + (double) (cycles - syncCycles) / header->clock_mhz;
+        event->core = core;
+        event->event = record->word >> 24;
+        event->arg = record->word & TRACE_ARG_MAX;
+    }
+    return count;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    size_t size;
+    
+    if (argc > 2)
+    {
+        fprintf(stderr, "Usage: %s [dump]\n", argv[0]);
+        return 2;
+    }
+    if (argc == 2 && (in = fopen(argv[1], "rb")) == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    uint8_t *data = read_all(in, &size);
+    
+    trace_dump_header_t header;
+    if (size < sizeof(header))
+    {
+        fprintf(stderr, "Not a trace dump\n");
+        return 1;
+    }
+    memcpy(&header, data, sizeof(header));
+    size_t ringSize = sizeof(trace_core_header_t) + header.events * sizeof(trace_record_t);
+    if (header.magic != TRACE_MAGIC || header.version != TRACE_VERSION || header.clock_mhz == 0 ||
+        header.cores == 0 || header.cores > MAX_CORES || header.events == 0 || (header.events & (header.events - 1)) != 0 ||
+        size != sizeof(header) + header.cores * ringSize)
+    {
+        fprintf(stderr, "Not a trace dump, or from a different version\n");
+        return 1;
+    }
+    if (header.flags & TRACE_DUMP_BEFORE_RESET)
+    {
+        fprintf(stderr, "Trace recorded before the board reset\n");
+    }
+    
+    event_t *events = malloc(header.cores * header.events * sizeof(event_t));
+    size_t count = 0;
+    for (unsigned core = 0; core < header.cores; core++)
+    {
+        trace_core_header_t ring;
+        const uint8_t *base = data + sizeof(header) + core * ringSize;
+        trace_record_t *records = malloc(header.events * sizeof(trace_record_t));
+    
+        memcpy(&ring, base, sizeof(ring));
+        memcpy(records, base + sizeof(ring), header.events * sizeof(trace_record_t));
+        count += read_core(&header, core, &ring, records, events + count);
+        free(records);
+    }
+    qsort(events, count, sizeof(event_t), compare_events);
+    
+    printf("{\"traceEvents\":[\n");
+    for (unsigned core = 0; core < header.cores; core++)
+    {
+        printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+               "\"args\":{\"name\":\"core %u\"}}", core > 0 ? ",\n" : "", core, core);
+    }
+    // Spans cut off at the start of a ring have an end but no begin. Each
+    // end event directly follows its begin event in trace_event_t.
+    int open[MAX_CORES][TRACE_EVENT_COUNT] = { { 0 } };
+    for (size_t i = 0; i < count; i++)
+    {
+        const event_t *event = &events[i];
+        if (event->event <= TRACE_NONE || event->event >= TRACE_EVENT_COUNT)
+        {
+            continue;
+        }
+        char phase = phases[event->event];
+        int span = event->event - (phase == 'E');
+        if (phase == 'B')
+        {
+            open[event->core][span]++;
+        }
+        else if (phase == 'E')
+        {
+            if (open[event->core][span] == 0)
+            {
+                continue;
+            }
+            open[event->core][span]--;
+        }
+        printf(",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u%s,"
+               "\"args\":{\"arg\":%u}}", names[event->event], phase,
+               event->time, event->core, phase == 'i' ? ",\"s\":\"t\"" : "", event->arg);
+    }
+    printf("\n]}\n");
+    free(events);
+    free(data);
+    return 0;
+}